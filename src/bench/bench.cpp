@@ -0,0 +1,223 @@
+#include "bench/bench.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace
+{
+struct Case
+{
+    std::string name;
+    std::function<void(BenchState&)> function;
+};
+
+std::vector<Case>& cases()
+{
+    static std::vector<Case> all;
+    return all;
+}
+
+struct Result
+{
+    std::string name;
+    uint64_t iterations;
+    double realTime; // ns per iteration, fastest repetition
+    double cpuTime;
+    double medianTime;
+    double allocations;
+    double bytesPerSecond;
+    double itemsPerSecond;
+    std::vector<std::pair<std::string, double>> counters;
+    std::string error;
+};
+
+double median(std::vector<double> values)
+{
+    if (values.empty())
+        return 0;
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// names are ASCII identifiers and slashes, only quotes and backslashes need escaping
+std::string jsonString(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+void writeJson(FILE* out, const std::vector<Result>& results, const char* executable, double minTime,
+               int repetitions)
+{
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    char date[64] = "";
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&now));
+
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"date\": %s,\n", jsonString(date).c_str());
+    fprintf(out, "    \"host_name\": %s,\n", jsonString(host).c_str());
+    fprintf(out, "    \"executable\": %s,\n", jsonString(executable).c_str());
+    fprintf(out, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(out, "    \"min_time\": %g,\n", minTime);
+    fprintf(out, "    \"repetitions\": %d,\n", repetitions);
+#ifdef NDEBUG
+    fprintf(out, "    \"library_build_type\": \"release\"\n");
+#else
+    fprintf(out, "    \"library_build_type\": \"debug\"\n");
+#endif
+    fprintf(out, "  },\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        fprintf(out, "    {\n      \"name\": %s,\n      \"run_name\": %s,\n      \"run_type\": \"iteration\",\n",
+                jsonString(r.name).c_str(), jsonString(r.name).c_str());
+        if (!r.error.empty())
+        {
+            fprintf(out, "      \"error_occurred\": true,\n      \"error_message\": %s\n    }%s\n",
+                    jsonString(r.error).c_str(), i + 1 < results.size() ? "," : "");
+            continue;
+        }
+        fprintf(out, "      \"repetitions\": %d,\n      \"iterations\": %llu,\n", repetitions,
+                (unsigned long long)r.iterations);
+        fprintf(out, "      \"real_time\": %.4f,\n      \"cpu_time\": %.4f,\n      \"median_time\": %.4f,\n",
+                r.realTime, r.cpuTime, r.medianTime);
+        fprintf(out, "      \"time_unit\": \"ns\",\n      \"allocations_per_iteration\": %.3f", r.allocations);
+        if (r.bytesPerSecond > 0)
+            fprintf(out, ",\n      \"bytes_per_second\": %.6e", r.bytesPerSecond);
+        if (r.itemsPerSecond > 0)
+            fprintf(out, ",\n      \"items_per_second\": %.6e", r.itemsPerSecond);
+        for (const auto& counter : r.counters)
+            fprintf(out, ",\n      %s: %.6e", jsonString(counter.first).c_str(), counter.second);
+        fprintf(out, "\n    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+void printRow(const Result& r)
+{
+    if (!r.error.empty())
+    {
+        printf("%-44s ERROR: %s\n", r.name.c_str(), r.error.c_str());
+        return;
+    }
+    printf("%-44s %12.1f ns %12.1f ns %10llu %7.2f", r.name.c_str(), r.realTime, r.medianTime,
+           (unsigned long long)r.iterations, r.allocations);
+    if (r.bytesPerSecond > 0)
+        printf("  %9.1f MB/s", r.bytesPerSecond / 1e6);
+    else if (r.itemsPerSecond > 0)
+        printf("  %9.3f M/s", r.itemsPerSecond / 1e6);
+    for (const auto& counter : r.counters)
+        printf("  %s=%g", counter.first.c_str(), counter.second);
+    printf("\n");
+}
+} // namespace
+
+void BenchRegistry::add(const std::string& name, std::function<void(BenchState&)> function)
+{
+    cases().push_back(Case{name, function});
+}
+
+int BenchRegistry::main(int argc, char** argv)
+{
+    std::string filter;
+    std::string jsonPath;
+    bool json = false;
+    bool list = false;
+    double minTime = 0.1;
+    int repetitions = 5;
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--filter=", 9) == 0)
+            filter = arg + 9;
+        else if (strncmp(arg, "--min-time=", 11) == 0)
+            minTime = atof(arg + 11);
+        else if (strncmp(arg, "--repetitions=", 14) == 0)
+            repetitions = std::max(1, atoi(arg + 14));
+        else if (strcmp(arg, "--json") == 0)
+            json = true;
+        else if (strncmp(arg, "--json=", 7) == 0)
+        {
+            json = true;
+            jsonPath = arg + 7;
+        }
+        else if (strcmp(arg, "--list") == 0)
+            list = true;
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter=<substring>] [--min-time=<seconds>] [--repetitions=<n>] "
+                            "[--json[=<file>]] [--list]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    // with --json and no file the JSON goes to stdout, so the table is left out
+    bool table = !json || !jsonPath.empty();
+    if (table && !list)
+        printf("%-44s %15s %15s %10s %7s\n", "case", "best", "median", "iterations", "allocs");
+
+    std::vector<Result> results;
+    bool failed = false;
+    for (const Case& c : cases())
+    {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos)
+            continue;
+        if (list)
+        {
+            printf("%s\n", c.name.c_str());
+            continue;
+        }
+
+        BenchState state(minTime, repetitions);
+        c.function(state);
+
+        Result r = {c.name, state.m_iterations, 0, 0, 0, state.m_allocations, 0, 0, state.m_counters,
+                    state.m_error};
+        if (r.error.empty() && state.m_realTimes.empty())
+            r.error = "run() was not called";
+        if (r.error.empty())
+        {
+            const std::vector<double>& times = state.m_realTimes;
+            size_t best = std::min_element(times.begin(), times.end()) - times.begin();
+            r.realTime = state.m_realTimes[best] * 1e9;
+            r.cpuTime = state.m_cpuTimes[best] * 1e9;
+            r.medianTime = median(state.m_realTimes) * 1e9;
+            if (state.m_bytesPerIteration > 0)
+                r.bytesPerSecond = state.m_bytesPerIteration / state.m_realTimes[best];
+            if (state.m_itemsPerIteration > 0)
+                r.itemsPerSecond = state.m_itemsPerIteration / state.m_realTimes[best];
+        }
+        failed = failed || !r.error.empty();
+        if (table)
+        {
+            printRow(r);
+            fflush(stdout);
+        }
+        results.push_back(r);
+    }
+
+    if (json && !list)
+    {
+        FILE* out = jsonPath.empty() ? stdout : fopen(jsonPath.c_str(), "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "can not write %s\n", jsonPath.c_str());
+            return 1;
+        }
+        writeJson(out, results, argv[0], minTime, repetitions);
+        if (out != stdout)
+            fclose(out);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "shared/alloc_counter.h"
+
+/**
+Self-contained benchmark harness for raw_tcp_client_bench, no dependency beyond the standard library.
+
+A case calls BenchState::run() with its body once. The harness grows the number of iterations until a batch takes
+about minTime, then times `repetitions` batches and reports the fastest one, the median and the heap allocations
+per iteration. Results are printed as a table, and with --json written in the layout Google Benchmark uses, so
+tools/compare.py from Google Benchmark can diff two runs.
+
+demo code:
+```
+BenchRegistry::add("crc16/4096", [](BenchState& state) {
+    std::vector<uint8_t> data(4096);
+    state.setBytesPerIteration(data.size());
+    state.run([&]() { benchDoNotOptimize(calculateCRC16(&data[0], data.size())); });
+});
+return BenchRegistry::main(argc, argv);
+```
+*/
+
+/// keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+inline void benchDoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/// forces pending stores to memory, so a loop can not be folded into one write
+inline void benchClobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+class BenchState
+{
+public:
+    BenchState(double minTime, int repetitions) : m_minTime(minTime), m_repetitions(repetitions) {}
+
+    /// times body(), call once per case
+    template <typename F>
+    void run(F body)
+    {
+        uint64_t iterations = 1;
+        while (true)
+        {
+            double seconds = timeBatch(body, iterations);
+            if (seconds >= m_minTime || iterations >= (1ull << 32))
+                break;
+            // aim a little past minTime so the next batch is usually the last one
+            double scale = seconds > 0 ? m_minTime * 1.2 / seconds : 100;
+            iterations = (uint64_t)(iterations * std::min(std::max(scale, 2.0), 100.0));
+        }
+
+        m_iterations = iterations;
+        size_t allocations = allocationCount();
+        for (int i = 0; i < m_repetitions; i++)
+        {
+            double cpu = cpuSeconds();
+            m_realTimes.push_back(timeBatch(body, iterations) / iterations);
+            m_cpuTimes.push_back((cpuSeconds() - cpu) / iterations);
+        }
+        m_allocations = (double)(allocationCount() - allocations) / ((double)iterations * m_repetitions);
+    }
+
+    void setBytesPerIteration(size_t bytes) { m_bytesPerIteration = bytes; }
+    void setItemsPerIteration(size_t items) { m_itemsPerIteration = items; }
+    /// an extra value reported with the case, like a latency percentile. Written to the JSON as a field of the case
+    /// the way Google Benchmark writes user counters, setting a name again replaces the value
+    void setCounter(const std::string& name, double value)
+    {
+        for (auto& counter : m_counters)
+        {
+            if (counter.first == name)
+            {
+                counter.second = value;
+                return;
+            }
+        }
+        m_counters.emplace_back(name, value);
+    }
+    /// marks the case as failed, it is reported with the message instead of times
+    void setError(const std::string& message) { m_error = message; }
+
+private:
+    friend class BenchRegistry;
+
+    template <typename F>
+    static double timeBatch(F& body, uint64_t iterations)
+    {
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (uint64_t i = 0; i < iterations; i++)
+            body();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+    }
+
+    static double cpuSeconds()
+    {
+        struct timespec ts;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+        return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+    }
+
+    double m_minTime;
+    int m_repetitions;
+    uint64_t m_iterations = 0;
+    std::vector<double> m_realTimes;
+    std::vector<double> m_cpuTimes;
+    double m_allocations = 0;
+    size_t m_bytesPerIteration = 0;
+    size_t m_itemsPerIteration = 0;
+    std::vector<std::pair<std::string, double>> m_counters;
+    std::string m_error;
+};
+
+class BenchRegistry
+{
+public:
+    static void add(const std::string& name, std::function<void(BenchState&)> function);
+
+    /**
+    Runs the registered cases. Options:
+        --filter=<substring>   only cases whose name contains it
+        --min-time=<seconds>   per timed batch, default 0.1
+        --repetitions=<n>      timed batches per case, default 5
+        --json[=<file>]        Google Benchmark style JSON to the file, or to stdout instead of the table
+        --list                 print the case names
+    */
+    static int main(int argc, char** argv);
+};
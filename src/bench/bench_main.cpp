@@ -0,0 +1,570 @@
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "ros/message_wrapper.h"
+#include "port_msgs/CustomMsgArray.h"
+#include "port_msgs/DeviceState.h"
+#include "port_msgs/Odom.h"
+#include "port_msgs/TcpRobotControl.h"
+#include "port_msgs/TcpRobotState.h"
+#include "port_msgs/WheelState.h"
+#include "packet/packet_parser.h"
+#include "packet/pipeline_metrics.h"
+#include "packet/tcp_pack.h"
+#include "packet/tcp_stream.h"
+#include "shared/clock.h"
+#include "shared/byte_swap.h"
+#include "shared/crc.h"
+#include "sim/robot_simulator.h"
+
+using namespace ax;
+
+/// arrays of fixed-size records: poses whose layout is their wire form, and states that have a layout of their own
+struct RecordArrays
+{
+    constexpr static char magic_header[2] = {'R', 'A'};
+
+    std::vector<Odom> poses;
+    std::vector<TcpRobotState> states;
+};
+
+namespace ros
+{
+namespace serialization
+{
+template <>
+struct Serializer<RecordArrays>
+{
+    template <typename Stream, typename T>
+    constexpr static void allInOne(Stream& stream, T&& m)
+    {
+        stream.next(m.poses);
+        stream.next(m.states);
+    }
+
+    ROS_DECLARE_ALLINONE_SERIALIZER
+};
+} // namespace serialization
+} // namespace ros
+
+namespace
+{
+Odom makeOdom()
+{
+    Odom msg;
+    msg.stamp = ros::Time(1701769169, 123400000);
+    msg.twist_linear_x = 1.123f;
+    msg.twist_linear_y = -2.345f;
+    msg.twist_angular = 3.14f;
+    return msg;
+}
+
+DeviceState makeDeviceState()
+{
+    DeviceState msg{};
+    msg.left_voltage = 4800;
+    msg.right_voltage = 4810;
+    msg.left_current = 120;
+    msg.right_current = 118;
+    return msg;
+}
+
+TcpRobotState makeRobotState()
+{
+    TcpRobotState msg;
+    msg.wheels_enabled = true;
+    msg.battery_percent = 80;
+    msg.is_charge = false;
+    return msg;
+}
+
+TcpRobotControl makeRobotControl()
+{
+    TcpRobotControl msg;
+    msg.enable_wheels = true;
+    return msg;
+}
+
+WheelState makeWheelState()
+{
+    WheelState msg;
+    msg.enable_state = WheelControlEnableState::ENABLED;
+    msg.wheel_error_msg = "left wheel over current";
+    return msg;
+}
+
+CustomMsgArray makeCustomMsgArray()
+{
+    CustomMsgArray msg;
+    msg.msgs[0] = CustomMsg("front", 0.1f, 0.2f, 0.3f);
+    msg.msgs[1] = CustomMsg("back", 0.1f, 0.2f, 0.3f);
+    msg.msgs_vector.resize(100, CustomMsg("laser", 0.1f, 0.2f, 0.3f));
+    return msg;
+}
+
+// to_buffer into a reused vector, the way a sender that keeps its buffer does it
+template <typename MessageType>
+void addSerialize(const std::string& type, MessageType msg)
+{
+    BenchRegistry::add("serialize/" + type, [msg](BenchState& state) {
+        std::vector<char> buffer;
+        to_buffer(msg, buffer);
+        state.setBytesPerIteration(buffer.size());
+        state.run([&]() {
+            buffer.clear();
+            to_buffer(msg, buffer);
+            benchClobberMemory();
+        });
+    });
+}
+
+// from_buffer into a reused message, crc check included
+template <typename MessageType>
+void addDeserialize(const std::string& type, MessageType msg)
+{
+    BenchRegistry::add("deserialize/" + type, [msg](BenchState& state) {
+        std::vector<char> buffer;
+        to_buffer(msg, buffer);
+        state.setBytesPerIteration(buffer.size());
+        MessageType out;
+        if (!from_buffer(out, &buffer[0], buffer.size()))
+            return state.setError("from_buffer failed");
+        state.run([&]() {
+            benchDoNotOptimize(from_buffer(out, &buffer[0], buffer.size()));
+            benchClobberMemory();
+        });
+    });
+}
+
+template <typename MessageType>
+void addMessage(const std::string& type, const MessageType& msg)
+{
+    addSerialize(type, msg);
+    addDeserialize(type, msg);
+}
+
+RecordArrays makeRecordArrays()
+{
+    RecordArrays msg;
+    msg.poses.resize(1000, makeOdom());
+    msg.states.resize(1000, makeRobotState());
+    return msg;
+}
+
+void addByteSwap(ByteSwapEngine engine, size_t wordSize, size_t bytes)
+{
+    std::string name = std::string("byteswap/") + byteSwapEngineName(engine) + "/" + std::to_string(wordSize * 8) +
+                       "/" + std::to_string(bytes);
+    BenchRegistry::add(name, [engine, wordSize, bytes](BenchState& state) {
+        if (!byteSwapEngineSupported(engine))
+            return state.setError("not supported");
+        std::vector<uint8_t> src(bytes), dst(bytes);
+        for (auto& b : src)
+            b = (uint8_t)random();
+        ByteSwapFunc swap = wordSize == 2   ? byteSwapEngineFuncs(engine)->swap16
+                            : wordSize == 4 ? byteSwapEngineFuncs(engine)->swap32
+                                            : byteSwapEngineFuncs(engine)->swap64;
+        state.setBytesPerIteration(bytes);
+        state.run([&]() {
+            swap(&dst[0], &src[0], bytes / wordSize);
+            benchClobberMemory();
+        });
+    });
+}
+
+void addCrc(size_t bytes)
+{
+    BenchRegistry::add("crc16/" + std::to_string(bytes), [bytes](BenchState& state) {
+        std::vector<uint8_t> data(bytes);
+        std::mt19937 random(bytes);
+        for (auto& b : data)
+            b = (uint8_t)random();
+        state.setBytesPerIteration(bytes);
+        state.run([&]() { benchDoNotOptimize(calculateCRC16(&data[0], (int)data.size())); });
+    });
+}
+
+class CountingDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t*, size_t) override
+    {
+        packets++;
+    }
+
+    size_t packets = 0;
+};
+
+/**
+Mixed Odom / DeviceState / CustomMsgArray frames with random garbage between them, garbagePercent of the stream in
+total. Garbage bytes stay below 0x40 so they never start a header: every frame is found, and the scanner still has
+to skip non-zero bytes.
+*/
+std::vector<char> makeFrameStream(size_t bytes, int garbagePercent, size_t* frames)
+{
+    Odom odom = makeOdom();
+    DeviceState deviceState = makeDeviceState();
+    CustomMsgArray array;
+    array.msgs_vector.resize(20, CustomMsg("laser", 0.1f, 0.2f, 0.3f));
+
+    std::mt19937 random(garbagePercent);
+    std::vector<char> stream;
+    size_t frameBytes = 0;
+    *frames = 0;
+    for (int i = 0; stream.size() < bytes; i++)
+    {
+        size_t before = stream.size();
+        if (i % 10 == 9)
+            to_buffer(array, stream);
+        else if (i % 3 == 0)
+            to_buffer(deviceState, stream);
+        else
+            to_buffer(odom, stream);
+        frameBytes += stream.size() - before;
+        (*frames)++;
+
+        // garbage so far catches up with its share of the stream
+        while ((stream.size() - frameBytes) * 100 < stream.size() * garbagePercent)
+            stream.push_back((char)(random() & 0x3f));
+    }
+    return stream;
+}
+
+void addParserFeed(size_t chunk, int garbagePercent)
+{
+    std::string name = "parser_feed/chunk:" + std::to_string(chunk) + "/garbage:" + std::to_string(garbagePercent);
+    BenchRegistry::add(name, [chunk, garbagePercent](BenchState& state) {
+        size_t frames = 0;
+        std::vector<char> stream = makeFrameStream(256 * 1024, garbagePercent, &frames);
+
+        MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+        MsgPackParser deviceParser({DeviceState::magic_header[0], DeviceState::magic_header[1]});
+        MsgPackParser arrayParser({CustomMsgArray::magic_header[0], CustomMsgArray::magic_header[1]});
+        CountingDelegate delegate;
+        ParserManager manager(&delegate);
+        manager.addParser(&odomParser);
+        manager.addParser(&deviceParser);
+        manager.addParser(&arrayParser);
+
+        auto feedAll = [&]() {
+            for (size_t offset = 0; offset < stream.size(); offset += chunk)
+                manager.feed((const uint8_t*)&stream[offset], std::min(chunk, stream.size() - offset));
+        };
+        feedAll();
+        if (delegate.packets != frames)
+            return state.setError("found " + std::to_string(delegate.packets) + " of " + std::to_string(frames)
+                                  + " frames");
+
+        state.setBytesPerIteration(stream.size());
+        state.run(feedAll);
+    });
+}
+
+void addClock(ClockSource source)
+{
+    BenchRegistry::add(std::string("clock/") + clockSourceName(source), [source](BenchState& state) {
+        if (!clockSelectSource(source))
+            return state.setError("not supported");
+        state.run([]() { benchDoNotOptimize(clockToRosTime(clockNowNs())); });
+        clockSelectSource(ClockSource_monotonic);
+    });
+}
+
+// Odom frames fed 1500 bytes at a time, per frame cost with the clock source ParserManager stamps from
+void addStampedFeed(ClockSource source)
+{
+    BenchRegistry::add(std::string("parser_feed/clock:") + clockSourceName(source), [source](BenchState& state) {
+        if (!clockSelectSource(source))
+            return state.setError("not supported");
+
+        std::vector<char> stream;
+        Odom odom = makeOdom();
+        while (stream.size() < 64 * 1024)
+            to_buffer(odom, stream);
+        MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+        CountingDelegate delegate;
+        ParserManager manager(&delegate);
+        manager.addParser(&odomParser);
+
+        state.setItemsPerIteration(stream.size() / (sizeof(MsgPack) + 16));
+        state.run([&]() {
+            for (size_t offset = 0; offset < stream.size(); offset += 1500)
+                manager.feed((const uint8_t*)&stream[offset], std::min((size_t)1500, stream.size() - offset));
+        });
+        clockSelectSource(ClockSource_monotonic);
+    });
+}
+
+int listenLoopback(int* port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0
+        || getsockname(fd, (struct sockaddr*)&addr, &len) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+/**
+One Odom frame to a blocking echo thread and back through a TcpStream, parsed on return. Measures the round trip
+over loopback: two sends, two wakeups and the parser, the floor for a request / reply exchange.
+*/
+void benchPingPong(BenchState& state)
+{
+    int port = 0;
+    int listener = listenLoopback(&port);
+    if (listener == -1)
+        return state.setError("can not listen on loopback");
+
+    std::thread echo([listener]() {
+        int peer = accept(listener, NULL, NULL);
+        if (peer == -1)
+            return;
+        int one = 1;
+        setsockopt(peer, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        char buffer[4096];
+        ssize_t n;
+        while ((n = recv(peer, buffer, sizeof(buffer), 0)) > 0)
+            send(peer, buffer, n, MSG_NOSIGNAL);
+        close(peer);
+    });
+
+    TcpStream stream;
+    bool opened = stream.open("127.0.0.1", port);
+    if (opened)
+    {
+        int one = 1;
+        setsockopt(stream.fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::vector<char> frame;
+        to_buffer(makeOdom(), frame);
+        MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+        CountingDelegate delegate;
+        ParserManager manager(&delegate, 64 * 1024);
+        manager.addParser(&odomParser);
+
+        bool broken = false;
+        uint8_t buffer[4096];
+        state.setItemsPerIteration(1);
+        state.run([&]() {
+            if (broken)
+                return;
+            size_t expected = delegate.packets + 1;
+            stream.write((const uint8_t*)&frame[0], frame.size());
+            while (delegate.packets < expected)
+            {
+                struct pollfd pfd = {stream.fd(), POLLIN, 0};
+                poll(&pfd, 1, 1000);
+                int n = stream.read(buffer, sizeof(buffer));
+                if (n == 0 || (n < 0 && !(pfd.revents & POLLIN) && !stream.isConnected()))
+                {
+                    broken = true;
+                    return;
+                }
+                if (n > 0)
+                    manager.feed(buffer, n);
+            }
+        });
+        if (broken)
+            state.setError("echo connection lost");
+    }
+    else
+    {
+        state.setError("can not connect to loopback");
+    }
+
+    stream.close();
+    shutdown(listener, SHUT_RDWR);
+    echo.join();
+    close(listener);
+}
+/// a RobotSimulator on a free loopback port, running on its own thread while in scope
+class SimulatorThread
+{
+public:
+    explicit SimulatorThread(const RobotSimulatorConfig& config) : m_simulator(config)
+    {
+        if (m_simulator.start())
+            m_thread = std::thread([this]() { m_simulator.run(); });
+    }
+    ~SimulatorThread()
+    {
+        m_simulator.stop();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    bool isRunning() const { return m_thread.joinable(); }
+    int port() const { return m_simulator.port(); }
+
+private:
+    RobotSimulator m_simulator;
+    std::thread m_thread;
+};
+
+RobotSimulatorConfig quietSimulatorConfig()
+{
+    RobotSimulatorConfig config;
+    config.port = 0;
+    config.odomHz = 0;
+    config.deviceStateHz = 0;
+    config.robotStateHz = 0;
+    config.statsInterval = 0;
+    return config;
+}
+
+// reads from stream into manager until delegate counted expected packets, false if the connection was lost
+bool receiveUntil(TcpStream& stream, ParserManager& manager, const CountingDelegate& delegate, size_t expected)
+{
+    uint8_t buffer[64 * 1024];
+    while (delegate.packets < expected)
+    {
+        int n = stream.read(buffer, sizeof(buffer));
+        if (n > 0)
+        {
+            manager.feed(buffer, n);
+            continue;
+        }
+        if (n == 0)
+            return false;
+        struct pollfd pfd = {stream.fd(), POLLIN, 0};
+        poll(&pfd, 1, 1000);
+    }
+    return true;
+}
+
+/**
+TcpRobotControl round trips through the simulator's echo with the client socket tuned by profile. Reports the
+fastest batch like every case, plus p50 / p99 of single round trips over all of them.
+*/
+void benchProfileLatency(BenchState& state, SocketProfile profile)
+{
+    SimulatorThread simulator(quietSimulatorConfig());
+    TcpStream stream;
+    stream.setTuning(SocketTuning::forProfile(profile));
+    if (!simulator.isRunning() || !stream.open("127.0.0.1", simulator.port()))
+        return state.setError("can not connect to the simulator");
+
+    std::vector<char> frame;
+    to_buffer(makeRobotControl(), frame);
+    MsgPackParser controlParser({(uint8_t)TcpRobotControl::magic_header[0], (uint8_t)TcpRobotControl::magic_header[1]});
+    CountingDelegate delegate;
+    ParserManager manager(&delegate, 64 * 1024);
+    manager.addParser(&controlParser);
+
+    HdrHistogram roundTrips;
+    bool broken = false;
+    state.setItemsPerIteration(1);
+    state.run([&]() {
+        if (broken)
+            return;
+        auto start = std::chrono::steady_clock::now();
+        stream.write((const uint8_t*)&frame[0], frame.size());
+        broken = !receiveUntil(stream, manager, delegate, delegate.packets + 1);
+        roundTrips.record((uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - start)
+                              .count());
+    });
+    if (broken)
+        return state.setError("simulator connection lost");
+    state.setCounter("p50_us", roundTrips.valueAtPercentile(50) / 1e3);
+    state.setCounter("p99_us", roundTrips.valueAtPercentile(99) / 1e3);
+    state.setCounter("rejected_options", stream.tuningRejected());
+}
+
+/**
+Odom published by the simulator as fast as it can, received and parsed by a client socket tuned by profile. The
+simulator only sends while less than its maxPendingBytes is queued, so a client that falls behind is throttled
+instead of measured against an ever growing backlog.
+*/
+void benchProfileThroughput(BenchState& state, SocketProfile profile)
+{
+    RobotSimulatorConfig config = quietSimulatorConfig();
+    config.odomHz = 10000000;
+    SimulatorThread simulator(config);
+    TcpStream stream;
+    stream.setTuning(SocketTuning::forProfile(profile));
+    if (!simulator.isRunning() || !stream.open("127.0.0.1", simulator.port()))
+        return state.setError("can not connect to the simulator");
+
+    std::vector<char> frame;
+    to_buffer(makeOdom(), frame);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    CountingDelegate delegate;
+    ParserManager manager(&delegate, 64 * 1024);
+    manager.addParser(&odomParser);
+
+    const size_t batch = 1000;
+    bool broken = false;
+    state.setItemsPerIteration(batch);
+    state.setBytesPerIteration(batch * frame.size());
+    state.run([&]() { broken = broken || !receiveUntil(stream, manager, delegate, delegate.packets + batch); });
+    if (broken)
+        return state.setError("simulator connection lost");
+    state.setCounter("rejected_options", stream.tuningRejected());
+}
+
+void addSocketProfile(SocketProfile profile)
+{
+    std::string name = socketProfileName(profile);
+    BenchRegistry::add("profile/" + name + "/latency",
+                       [profile](BenchState& state) { benchProfileLatency(state, profile); });
+    BenchRegistry::add("profile/" + name + "/throughput",
+                       [profile](BenchState& state) { benchProfileThroughput(state, profile); });
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    addMessage("Odom", makeOdom());
+    addMessage("DeviceState", makeDeviceState());
+    addMessage("TcpRobotState", makeRobotState());
+    addMessage("TcpRobotControl", makeRobotControl());
+    addMessage("WheelState", makeWheelState());
+    addMessage("CustomMsgArray", makeCustomMsgArray());
+    addMessage("RecordArrays", makeRecordArrays());
+
+    for (int engine = 0; engine < ByteSwapEngine_count; engine++)
+        for (size_t wordSize : {2, 4, 8})
+            addByteSwap((ByteSwapEngine)engine, wordSize, 64 * 1024);
+
+    for (size_t bytes = 16; bytes <= 64 * 1024; bytes *= 4)
+        addCrc(bytes);
+
+    for (size_t chunk : {64, 1500, 16384})
+        for (int garbage : {0, 10, 50})
+            addParserFeed(chunk, garbage);
+
+    BenchRegistry::add("clock/ros::Time::now", [](BenchState& state) {
+        state.run([]() { benchDoNotOptimize(ros::Time::now()); });
+    });
+    for (int source = 0; source < ClockSource_count; source++)
+        addClock((ClockSource)source);
+    for (int source = 0; source < ClockSource_count; source++)
+        addStampedFeed((ClockSource)source);
+
+    BenchRegistry::add("pingpong/loopback", benchPingPong);
+    for (int profile = 0; profile < SocketProfile_count; profile++)
+        addSocketProfile((SocketProfile)profile);
+
+    return BenchRegistry::main(argc, argv);
+}
@@ -2,8 +2,19 @@
 #include <cmath>
 #include <unistd.h>
 #include <memory>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
 
 #include "ros/message_wrapper.h"
+#include "ros/message_view.h"
 
 #include "port_msgs/CustomMsgArray.h"
 #include "port_msgs/WheelState.h"
@@ -11,7 +22,23 @@
 #include "port_msgs/TcpRobotControl.h"
 #include "port_msgs/TcpRobotState.h"
 #include "port_msgs/DeviceState.h"
+#include "port_msgs/Header.h"
+#include "port_msgs/Vector3.h"
+#include "packet/batching_writer.h"
+#include "packet/buffer_pool.h"
 #include "packet/tcp_stream.h"
+#include "packet/tcp_pack.h"
+#include "packet/event_loop.h"
+#include "packet/frame_capture.h"
+#include "packet/message_router.h"
+#include "packet/pipeline_metrics.h"
+#include "packet/reader_thread.h"
+#include "packet/reconnecting_stream.h"
+#include "packet/uring_tcp_stream.h"
+#include "shared/clock.h"
+#include "shared/crc.h"
+#include "shared/alloc_counter.h"
+#include "shared/byte_swap.h"
 
 using namespace ax;
 
@@ -123,24 +150,35 @@ void test_device_state()
     print_buffer(&buffer[0], buffer.size());
 }
 
-void test_send()
+class PrintOdomDelegate : public ParserManagerDelegate
 {
-    std::string m_hostIP = "127.0.0.1";
-    int m_hostPort = 8091;
-    std::shared_ptr<TcpStream> m_comStream = std::make_shared<TcpStream>();
-    while (true)
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t* pack, size_t bytes) override
     {
-        if (!m_comStream->open(m_hostIP, m_hostPort))
+        Odom msg;
+        if (from_buffer(msg, (const char*)pack, bytes))
         {
-            sleep(1);
+            printf("recv twist_linear_x: %lf, twist_linear_y: %lf, twist_angular: %lf\n", msg.twist_linear_x,
+                   msg.twist_linear_y, msg.twist_angular);
         }
         else
         {
-            break;
+            printf("from_buffer failed...");
         }
     }
+};
+
+void test_send()
+{
+    ReconnectConfig config;
+    config.ip = "127.0.0.1";
+    config.port = 8091;
+    PrintOdomDelegate delegate; // no parser added, whatever the server sends is dropped
+    ParserManager manager(&delegate);
+    ReconnectingStream connection(config, &manager);
+    connection.start();
 
-    // send odom to server for test
+    // send odom to server for test, queued while the server is away
     Odom msg;
     std::vector<char> buffer;
     for (int i = 0; i < INT32_MAX; i++)
@@ -152,66 +190,2466 @@ void test_send()
 
         to_buffer(msg, buffer);
         // send
-        int sizeOut = m_comStream->write((uint8_t*)(&buffer[0]), buffer.size());
-        if (sizeOut <= 0)
+        if (!connection.send((uint8_t*)(&buffer[0]), buffer.size()))
         {
-            printf("write length is %d\n", sizeOut);
+            printf("odom %d dropped\n", i);
         }
 
         buffer.clear();
-        sleep(1);
+        // poll for a second, it reconnects in the meantime
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (std::chrono::steady_clock::now() < until)
+            connection.poll(100);
     }
 }
 
+class PrintConnectionDelegate : public ReconnectingStreamDelegate
+{
+public:
+    void ReconnectingStream_connected() override { printf("connected\n"); }
+    void ReconnectingStream_disconnected() override { printf("connection closed\n"); }
+    void ReconnectingStream_attemptFailed(int attempts, int backoffMs) override
+    {
+        printf("connect failed %d times, next attempt in %d ms\n", attempts, backoffMs);
+    }
+};
+
 void test_recv()
 {
-    std::string m_hostIP = "127.0.0.1";
-    int m_hostPort = 8091;
-    std::shared_ptr<TcpStream> m_comStream = std::make_shared<TcpStream>();
+    // recv odom from server for test, reconnecting whenever the server goes away
+    PrintOdomDelegate delegate;
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    ParserManager manager(&delegate);
+    manager.addParser(&odomParser);
+
+    ReconnectConfig config;
+    config.ip = "127.0.0.1";
+    config.port = 8091;
+    PrintConnectionDelegate connectionDelegate;
+    ReconnectingStream connection(config, &manager, &connectionDelegate);
+    connection.start();
     while (true)
     {
-        if (!m_comStream->open(m_hostIP, m_hostPort))
+        connection.poll(-1);
+    }
+}
+
+void test_crc16()
+{
+    // every engine must agree with the bitwise reference, including odd lengths and unaligned starts
+    std::vector<uint8_t> data(64 * 1024 + 64);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (uint8_t)rand();
+
+    for (int e = 0; e < Crc16Engine_count; e++)
+    {
+        Crc16Engine engine = (Crc16Engine)e;
+        if (!crc16EngineSupported(engine))
+        {
+            printf("%-10s not supported\n", crc16EngineName(engine));
+            continue;
+        }
+
+        Crc16Func func = crc16EngineFunc(engine);
+        for (size_t len = 0; len < 1100; len++)
+        {
+            size_t offset = len % 7;
+            uint16_t expect = crc16Bitwise(CRC16_INIT, &data[offset], len);
+            if (func(CRC16_INIT, &data[offset], len) != expect)
+            {
+                printf("%-10s mismatch at len %zu\n", crc16EngineName(engine), len);
+                return;
+            }
+        }
+
+        // GB/s over a 64 KB payload
+        const size_t len = 64 * 1024;
+        const int rounds = engine == Crc16Engine_bitwise ? 200 : 5000;
+        uint16_t sink = 0;
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < rounds; i++)
+            sink += func(CRC16_INIT, &data[0], len);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        printf("%-10s %8.3f GB/s (%04x)\n", crc16EngineName(engine), len * rounds / seconds / 1e9, sink);
+    }
+    printf("calculateCRC16 uses %s, negative length %s\n", crc16EngineName(crc16CurrentEngine()),
+           calculateCRC16(&data[0], -1) == CRC16_INIT ? "OK" : "FAILED");
+}
+
+class CountingDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t*, size_t bytes) override
+    {
+        packets++;
+        total += bytes;
+    }
+
+    size_t packets = 0;
+    size_t total = 0;
+};
+
+// ParserManager as it was before the ring buffer, kept to compare against
+class VectorParserManager
+{
+public:
+    VectorParserManager(ParserManagerDelegate* d) : m_delegate(d) {}
+    void addParser(Parser* parser) { m_parsers.push_back(parser); }
+
+    void feed(const uint8_t* bytes, size_t n)
+    {
+        m_buffer.insert(m_buffer.end(), bytes, bytes + n);
+        while (true)
         {
-            sleep(1);
+            if (m_currentParser == NULL)
+            {
+                int minPos = INT_MAX;
+                for (auto parser : m_parsers)
+                {
+                    const std::vector<uint8_t>& h = parser->header();
+                    auto pos = std::search(m_buffer.begin(), m_buffer.end(), h.begin(), h.end());
+                    if (pos != m_buffer.end() && pos - m_buffer.begin() < minPos)
+                    {
+                        m_time = ros::Time::now();
+                        minPos = (int)(pos - m_buffer.begin());
+                        m_currentParser = parser;
+                    }
+                }
+                if (minPos == INT_MAX)
+                    return;
+                m_buffer.erase(m_buffer.begin(), m_buffer.begin() + minPos);
+            }
+
+            size_t bytesUsed = 0;
+            ParserResult result = m_currentParser->feed(&m_buffer[0], m_buffer.size(), &bytesUsed);
+            if (result == ParserResult_incomplete)
+                return;
+            else if (result == ParserResult_succ)
+                m_delegate->ParserManager_packetFound(m_currentParser->header(), m_time, &m_buffer[0], bytesUsed);
+            m_buffer.erase(m_buffer.begin(), m_buffer.begin() + bytesUsed);
+            m_currentParser = NULL;
         }
+    }
+
+private:
+    ParserManagerDelegate* m_delegate;
+    Parser* m_currentParser = NULL;
+    std::vector<Parser*> m_parsers;
+    std::vector<uint8_t> m_buffer;
+    ros::Time m_time;
+};
+
+// mixed Odom / DeviceState / CustomMsgArray frames, each followed by `garbage` zero bytes
+std::vector<char> make_frame_stream(size_t bytes, size_t garbage = 0)
+{
+    Odom odom;
+    DeviceState device_state{};
+    CustomMsgArray array;
+    array.msgs_vector.resize(20, CustomMsg("laser", 0.1, 0.2, 0.3));
+
+    std::vector<char> stream;
+    for (int i = 0; stream.size() < bytes; i++)
+    {
+        odom.twist_linear_x = i;
+        if (i % 10 == 9)
+            to_buffer(array, stream);
+        else if (i % 3 == 0)
+            to_buffer(device_state, stream);
         else
+            to_buffer(odom, stream);
+        stream.insert(stream.end(), garbage, 0);
+    }
+    return stream;
+}
+
+template <typename Manager>
+double feed_in_chunks(Manager& manager, const std::vector<char>& stream, const std::vector<size_t>& chunks)
+{
+    auto begin = std::chrono::steady_clock::now();
+    size_t offset = 0;
+    for (size_t i = 0; offset < stream.size(); i++)
+    {
+        size_t n = std::min(chunks[i % chunks.size()], stream.size() - offset);
+        manager.feed((const uint8_t*)&stream[offset], n);
+        offset += n;
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+void test_parser_manager()
+{
+    std::vector<char> stream = make_frame_stream(1024 * 1024);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    MsgPackParser deviceStateParser({DeviceState::magic_header[0], DeviceState::magic_header[1]});
+    MsgPackParser arrayParser({CustomMsgArray::magic_header[0], CustomMsgArray::magic_header[1]});
+
+    for (size_t maxChunk : {64, 1500, 16384, 262144})
+    {
+        std::vector<size_t> chunks(1024);
+        for (auto& c : chunks)
+            c = 1 + rand() % maxChunk;
+
+        CountingDelegate ringDelegate;
+        ParserManager ringManager(&ringDelegate);
+        ringManager.addParser(&odomParser);
+        ringManager.addParser(&deviceStateParser);
+        ringManager.addParser(&arrayParser);
+
+        CountingDelegate vectorDelegate;
+        VectorParserManager vectorManager(&vectorDelegate);
+        vectorManager.addParser(&odomParser);
+        vectorManager.addParser(&deviceStateParser);
+        vectorManager.addParser(&arrayParser);
+
+        double ring = feed_in_chunks(ringManager, stream, chunks);
+        double vector = feed_in_chunks(vectorManager, stream, chunks);
+        printf("chunk <= %6zu: ring %8.2f MB/s, vector %8.2f MB/s, packets %zu/%zu\n", maxChunk,
+               stream.size() / ring / 1e6, stream.size() / vector / 1e6, ringDelegate.packets, vectorDelegate.packets);
+    }
+}
+
+void test_header_scanner()
+{
+    // agree with one std::search per header on a small alphabet, so matches and near misses are frequent
+    for (int round = 0; round < 2000; round++)
+    {
+        HeaderScanner scanner;
+        std::vector<std::vector<uint8_t>> headers(1 + rand() % 10);
+        for (auto& h : headers)
         {
-            break;
+            h.resize(1 + rand() % 3);
+            for (auto& b : h)
+                b = (uint8_t)(rand() % 6);
+            scanner.add(h);
+        }
+
+        std::vector<uint8_t> data(rand() % 200);
+        for (auto& b : data)
+            b = (uint8_t)(6 + rand() % 4);
+        for (int k = rand() % 3; k > 0 && !data.empty(); k--)
+            data[rand() % data.size()] = (uint8_t)(rand() % 6);
+
+        size_t expectPos = data.size(), expectIndex = 0;
+        for (size_t k = 0; k < headers.size(); k++)
+        {
+            size_t p = std::search(data.begin(), data.end(), headers[k].begin(), headers[k].end()) - data.begin();
+            if (p + headers[k].size() <= data.size() && p < expectPos)
+            {
+                expectPos = p;
+                expectIndex = k;
+            }
+        }
+
+        size_t pos = 0, index = 0;
+        bool found = scanner.find(data.data(), data.size(), &pos, &index);
+        if (found != (expectPos != data.size()) || (found && (pos != expectPos || index != expectIndex)))
+        {
+            printf("scanner mismatch in round %d\n", round);
+            return;
+        }
+    }
+
+    // frames separated by garbage that never contains a header
+    std::vector<char> stream = make_frame_stream(1024 * 1024, 256);
+    std::vector<size_t> chunks(1024);
+    for (auto& c : chunks)
+        c = 1 + rand() % 4096;
+
+    std::vector<std::unique_ptr<MsgPackParser>> parsers;
+    parsers.emplace_back(new MsgPackParser({Odom::magic_header[0], Odom::magic_header[1]}));
+    for (int i = 1; i < 64; i++)
+        parsers.emplace_back(new MsgPackParser({(uint8_t)(0x80 + i), (uint8_t)(0x80 - i)}));
+
+    for (size_t count : {1, 8, 64})
+    {
+        CountingDelegate ringDelegate;
+        ParserManager ringManager(&ringDelegate);
+        CountingDelegate vectorDelegate;
+        VectorParserManager vectorManager(&vectorDelegate);
+        for (size_t i = 0; i < count; i++)
+        {
+            ringManager.addParser(parsers[i].get());
+            vectorManager.addParser(parsers[i].get());
+        }
+
+        double scanner = feed_in_chunks(ringManager, stream, chunks);
+        double search = feed_in_chunks(vectorManager, stream, chunks);
+        printf("%2zu parsers: scanner %8.2f MB/s, std::search %8.2f MB/s, packets %zu/%zu\n", count,
+               stream.size() / scanner / 1e6, stream.size() / search / 1e6, ringDelegate.packets,
+               vectorDelegate.packets);
+    }
+}
+
+// listening socket on 127.0.0.1 with a kernel assigned port
+int listen_loopback(int* port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 1024) != 0
+        || getsockname(fd, (struct sockaddr*)&addr, &len) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+double time_diff_us(const ros::Time& from, const ros::Time& to)
+{
+    return ((double)to.sec - from.sec) * 1e6 + ((double)to.nsec - from.nsec) / 1e3;
+}
+
+void print_percentiles(const char* name, std::vector<double>& samples)
+{
+    if (samples.empty())
+    {
+        printf("%s: no samples\n", name);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto at = [&samples](double q) { return samples[std::min(samples.size() - 1, (size_t)(q * samples.size()))]; };
+    printf("%s: n=%zu p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n", name, samples.size(), at(0.5),
+           at(0.9), at(0.99), at(0.999), samples.back());
+}
+
+class LatencyDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t* pack, size_t bytes) override
+    {
+        Odom msg;
+        if (from_buffer(msg, (const char*)pack, bytes))
+            latencies.push_back(time_diff_us(msg.stamp, ros::Time::now()));
+    }
+
+    std::vector<double> latencies;
+};
+
+void test_event_loop()
+{
+    const int peerCount = 500;
+    const int rounds = 200;
+
+    int port = 0;
+    int listenfd = listen_loopback(&port);
+    if (listenfd == -1)
+    {
+        printf("listen failed\n");
+        return;
+    }
+
+    // 500 client connections in one loop, the accepted ends play the robots
+    LatencyDelegate delegate;
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    EventLoop loop;
+    std::vector<int> peers;
+    for (int i = 0; i < peerCount; i++)
+    {
+        std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+        if (!stream->open("127.0.0.1", port))
+        {
+            printf("connect %d failed\n", i);
+            return;
+        }
+        Connection* connection = loop.add(stream, &delegate, 64 * 1024);
+        connection->parser().addParser(&odomParser);
+        peers.push_back(accept(listenfd, NULL, NULL));
+    }
+    close(listenfd);
+
+    // every peer sends one odom per millisecond
+    std::thread sender([&peers]() {
+        Odom msg;
+        std::vector<char> buffer;
+        for (int round = 0; round < rounds; round++)
+        {
+            for (int fd : peers)
+            {
+                buffer.clear();
+                msg.stamp = ros::Time::now();
+                to_buffer(msg, buffer);
+                send(fd, &buffer[0], buffer.size(), MSG_NOSIGNAL);
+            }
+            usleep(1000);
+        }
+    });
+
+    size_t expected = (size_t)peerCount * rounds;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (delegate.latencies.size() < expected && std::chrono::steady_clock::now() < deadline)
+        loop.runOnce(100);
+    sender.join();
+
+    for (int fd : peers)
+        close(fd);
+    print_percentiles("epoll 500 peers", delegate.latencies);
+}
+
+double thread_cpu_seconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// wait until the stream has something to read, without spinning
+void wait_readable(TcpStream& stream)
+{
+    UringTcpStream* uring = dynamic_cast<UringTcpStream*>(&stream);
+    if (uring != NULL && uring->isUringActive())
+    {
+        uring->wait(100);
+        return;
+    }
+    struct pollfd pfd = {stream.fd(), POLLIN, 0};
+    poll(&pfd, 1, 100);
+}
+
+void bench_stream_send(const char* name, TcpStream& stream, int peer, int count)
+{
+    Odom msg;
+    std::vector<char> frame;
+    to_buffer(msg, frame);
+    size_t total = frame.size() * count;
+
+    std::thread drain([peer, total]() {
+        std::vector<char> buffer(256 * 1024);
+        size_t received = 0;
+        while (received < total)
+        {
+            ssize_t n = recv(peer, &buffer[0], buffer.size(), 0);
+            if (n <= 0)
+                break;
+            received += n;
         }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    double cpu = thread_cpu_seconds();
+    for (int i = 0; i < count && stream.isConnected(); i++)
+    {
+        size_t sent = 0;
+        while (sent < frame.size() && stream.isConnected())
+            sent += stream.write((const uint8_t*)&frame[sent], frame.size() - sent);
     }
+    UringTcpStream* uring = dynamic_cast<UringTcpStream*>(&stream);
+    if (uring != NULL)
+        uring->flush();
+    cpu = thread_cpu_seconds() - cpu;
+    drain.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("%-16s send: %10.0f msgs/s, %7.1f ns cpu/msg\n", name, count / seconds, cpu * 1e9 / count);
+}
 
-    // recv odom from server for test
+void bench_stream_recv(const char* name, TcpStream& stream, int peer, int count)
+{
+    std::vector<char> frames;
     Odom msg;
+    for (int i = 0; i < count; i++)
+        to_buffer(msg, frames);
+
+    std::thread sender([peer, &frames]() {
+        // odom sized writes, like a robot publishing
+        for (size_t offset = 0; offset < frames.size(); offset += 32)
+            send(peer, &frames[offset], std::min((size_t)32, frames.size() - offset), MSG_NOSIGNAL);
+    });
+
+    CountingDelegate delegate;
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    ParserManager manager(&delegate);
+    manager.addParser(&odomParser);
+
+    std::vector<uint8_t> buffer(64 * 1024);
+    auto begin = std::chrono::steady_clock::now();
+    double cpu = thread_cpu_seconds();
+    while (delegate.packets < (size_t)count && stream.isConnected())
+    {
+        int n = stream.read(&buffer[0], buffer.size());
+        if (n > 0)
+            manager.feed(&buffer[0], n);
+        else if (n < 0)
+            wait_readable(stream);
+    }
+    cpu = thread_cpu_seconds() - cpu;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    sender.join();
+    printf("%-16s recv: %10.0f msgs/s, %7.1f ns cpu/msg\n", name, delegate.packets / seconds,
+           cpu * 1e9 / delegate.packets);
+}
+
+// bytes the peer can read right now
+size_t recv_available(int peer, int waitMs)
+{
+    struct pollfd pfd = {peer, POLLIN, 0};
+    poll(&pfd, 1, waitMs);
     char buffer[4096];
-    for (int i = 0; i < INT32_MAX; i++)
+    ssize_t n = recv(peer, buffer, sizeof(buffer), MSG_DONTWAIT);
+    return n > 0 ? (size_t)n : 0;
+}
+
+void test_uring()
+{
+    printf("io_uring supported: %d\n", UringTcpStream::isSupported());
+
     {
-        buffer[0] = 0;
-        int sizeOut = m_comStream->read((uint8_t*)buffer, 4096);
-        if (sizeOut <= 0)
+        // small writes a while apart go out on their own, not only once the fill buffer ran full
+        int port = 0;
+        int listenfd = listen_loopback(&port);
+        UringTcpStream stream;
+        if (listenfd == -1 || !stream.open("127.0.0.1", port))
         {
-            printf("write length is %d\n", sizeOut);
+            printf("io_uring: connect failed\n");
+            return;
         }
+        int peer = accept(listenfd, NULL, NULL);
+        close(listenfd);
 
-        if (from_buffer(msg, buffer, 4096))
+        uint8_t frame[32] = {0};
+        bool ok = true;
+        for (int i = 0; i < 5; i++)
         {
-            printf("recv twist_linear_x: %lf, twist_linear_y: %lf, twist_angular: %lf\n", msg.twist_linear_x,
-                   msg.twist_linear_y, msg.twist_angular);
+            stream.write(frame, sizeof(frame));
+            size_t n = recv_available(peer, 100);
+            printf("write %d: peer got %zu bytes\n", i, n);
+            ok = ok && n == sizeof(frame);
+        }
+
+        // a burst coalesces while a send is in flight, flush waits until the kernel took all of it
+        for (int i = 0; i < 1000; i++)
+            stream.write(frame, sizeof(frame));
+        bool flushed = stream.flush(1000);
+        size_t received = 0;
+        for (size_t n; (n = recv_available(peer, 100)) > 0;)
+            received += n;
+        printf("small writes arrive without flush, burst of %zu bytes after flush %s\n", received,
+               ok && flushed && received == 1000 * sizeof(frame) ? "OK" : "FAILED");
+        close(peer);
+    }
+
+    const int count = 200000;
+    for (int variant = 0; variant < 3; variant++)
+    {
+        std::unique_ptr<TcpStream> stream;
+        const char* name;
+        if (variant == 0)
+        {
+            stream.reset(new TcpStream());
+            name = "send/recv";
+        }
+        else if (variant == 1)
+        {
+            stream.reset(new UringTcpStream());
+            name = "io_uring";
         }
         else
         {
-            printf("from_buffer failed...");
+            stream.reset(new UringTcpStream(64, 16 * 1024, 256 * 1024, 4096));
+            name = "io_uring batch";
+        }
+
+        int port = 0;
+        int listenfd = listen_loopback(&port);
+        if (listenfd == -1 || !stream->open("127.0.0.1", port))
+        {
+            printf("%s: connect failed\n", name);
+            return;
         }
+        int peer = accept(listenfd, NULL, NULL);
+        close(listenfd);
 
-        sleep(1);
+        bench_stream_send(name, *stream, peer, count);
+        bench_stream_recv(name, *stream, peer, count);
+        close(peer);
     }
 }
 
-void test_endian()
+// keeps writing until the stream took every piece, waiting while the socket is full
+void writev_all(TcpStream& stream, std::vector<struct iovec> iov)
 {
-    // Big    Endian: 01 23 45 67
-    // Little Endian: 67 45 23 01
-    int value = 0x01234567;
-    print_buffer(&value, sizeof(int));
+    size_t first = 0;
+    while (first < iov.size() && stream.isConnected())
+    {
+        size_t n = stream.writev(&iov[first], (int)(iov.size() - first));
+        if (n == 0)
+        {
+            struct pollfd pfd = {stream.fd(), POLLOUT, 0};
+            poll(&pfd, 1, 100);
+            continue;
+        }
+        while (first < iov.size() && n >= iov[first].iov_len)
+            n -= iov[first++].iov_len;
+        if (n > 0)
+        {
+            iov[first].iov_base = (char*)iov[first].iov_base + n;
+            iov[first].iov_len -= n;
+        }
+    }
+}
+
+void test_gather_send()
+{
+    // a multi KB message: most of the bytes are in strings that to_iovec references in place
+    CustomMsgArray msg;
+    msg.msgs[0] = CustomMsg("aaaa", 0.1, 0.2, 0.3);
+    msg.msgs[1] = CustomMsg("bbbb", 0.1, 0.2, 0.3);
+    for (int i = 0; i < 16; i++)
+        msg.msgs_vector.push_back(CustomMsg(std::string(4096, 'a' + i), i, i, i));
+
+    std::vector<char> expected;
+    to_buffer(msg, expected);
+    ros::serialization::GatherStream gather;
+    to_iovec(msg, gather);
+    std::vector<char> gathered;
+    gather.visit(0, [&gathered](const uint8_t* data, size_t len) { gathered.insert(gathered.end(), data, data + len); });
+    printf("%zu bytes in %zu iovecs, same as to_buffer: %d\n", gathered.size(), gather.iov().size(),
+           gathered == expected);
+
+    const int count = 20000;
+    for (int variant = 0; variant < 3; variant++)
+    {
+        const char* names[] = {"to_buffer+write", "to_iovec+writev", "MSG_ZEROCOPY"};
+        int port = 0;
+        int listenfd = listen_loopback(&port);
+        TcpStream stream;
+        if (listenfd == -1 || !stream.open("127.0.0.1", port))
+        {
+            printf("%s: connect failed\n", names[variant]);
+            return;
+        }
+        int peer = accept(listenfd, NULL, NULL);
+        close(listenfd);
+        if (variant == 2 && !stream.setZeroCopy(16 * 1024))
+            printf("MSG_ZEROCOPY not supported\n");
+
+        size_t total = expected.size() * count;
+        std::thread drain([peer, total]() {
+            std::vector<char> buffer(256 * 1024);
+            size_t received = 0;
+            while (received < total)
+            {
+                ssize_t n = recv(peer, &buffer[0], buffer.size(), 0);
+                if (n <= 0)
+                    break;
+                received += n;
+            }
+        });
+
+        std::vector<char> buffer;
+        auto begin = std::chrono::steady_clock::now();
+        double cpu = thread_cpu_seconds();
+        for (int i = 0; i < count && stream.isConnected(); i++)
+        {
+            if (variant == 0)
+            {
+                buffer.clear();
+                to_buffer(msg, buffer);
+                struct iovec iov = {&buffer[0], buffer.size()};
+                writev_all(stream, std::vector<struct iovec>(1, iov));
+            }
+            else
+            {
+                gather.clear();
+                to_iovec(msg, gather);
+                writev_all(stream, gather.iov());
+            }
+        }
+        // msg must not change while the kernel still references it
+        while (stream.zeroCopyPending() > 0)
+            usleep(100);
+        cpu = thread_cpu_seconds() - cpu;
+        drain.join();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        printf("%-16s %8.0f msgs/s, %6.2f GB/s, %7.1f ns cpu/msg\n", names[variant], count / seconds,
+               total / seconds / 1e9, cpu * 1e9 / count);
+        close(peer);
+    }
+}
+
+void test_message_view()
+{
+    CustomMsgArray msg;
+    msg.msgs[0] = CustomMsg("aaaa", 0.1, 0.2, 0.3);
+    msg.msgs[1] = CustomMsg("bbbbbbbb", 0.4, 0.5, 0.6);
+    for (int i = 0; i < 1000; i++)
+        msg.msgs_vector.push_back(CustomMsg("wheel_" + std::to_string(i), i, -i, 0.5f * i));
+
+    std::vector<char> buffer;
+    to_buffer(msg, buffer);
+
+    // the view reads the same values as an owning copy
+    MessageView<CustomMsgArray> view;
+    bool ok = view.parse(&buffer[0], buffer.size());
+    ListView<CustomMsg> items = view.get<std::vector<CustomMsg>>(1);
+    size_t index = 0;
+    for (const MessageView<CustomMsg>& item : items)
+    {
+        const CustomMsg& expected = msg.msgs_vector[index++];
+        ok = ok && item.get<std::string>(0) == expected.name && item.get<float>(1) == expected.linear_velocity_x &&
+             item.get<float>(3) == expected.angular_velocity;
+    }
+    ok = ok && index == msg.msgs_vector.size() && view.get<std::array<CustomMsg, 2>>(0).size() == 2;
+    std::vector<char> corrupt(buffer.begin(), buffer.begin() + buffer.size() / 2);
+    ok = ok && !view.parse(&corrupt[0], corrupt.size());
+    printf("view matches: %d\n", ok);
+
+    const int rounds = 2000;
+    double sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        CustomMsgArray owned;
+        from_buffer(owned, &buffer[0], buffer.size());
+        for (const CustomMsg& item : owned.msgs_vector)
+            sink += item.linear_velocity_x + item.name.size();
+    }
+    double owning = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        MessageView<CustomMsgArray> v;
+        v.parse(&buffer[0], buffer.size());
+        for (const MessageView<CustomMsg>& item : v.get<std::vector<CustomMsg>>(1))
+            sink += item.get<float>(1) + item.get<std::string>(0).size();
+    }
+    double viewing = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("CustomMsgArray with 1000 entries, %zu bytes (%.0f)\n", buffer.size(), sink);
+    printf("from_buffer: %8.1f us/msg\n", owning / rounds);
+    printf("MessageView: %8.1f us/msg\n", viewing / rounds);
+}
+
+void test_serializer_refs()
+{
+    CustomMsgArray msg;
+    msg.msgs[0] = CustomMsg("a name longer than the small string buffer", 0.1, 0.2, 0.3);
+    msg.msgs[1] = CustomMsg("bbbb", 0.4, 0.5, 0.6);
+    for (int i = 0; i < 100; i++)
+        msg.msgs_vector.push_back(CustomMsg("a name longer than the small string buffer", i, i, i));
+
+    std::vector<char> buffer;
+    buffer.reserve(64 * 1024);
+    to_buffer(msg, buffer);
+
+    // from_buffer must fill the caller's object, not a copy of it
+    CustomMsgArray msg2;
+    bool ok = from_buffer(msg2, &buffer[0], buffer.size());
+    ok = ok && msg2.msgs[0].name == msg.msgs[0].name && msg2.msgs_vector.size() == msg.msgs_vector.size() &&
+         msg2.msgs_vector.back().linear_velocity_x == msg.msgs_vector.back().linear_velocity_x;
+    printf("from_buffer populates the caller's object: %d\n", ok);
+
+    const int rounds = 1000;
+    size_t before = allocationCount();
+    for (int i = 0; i < rounds; i++)
+    {
+        buffer.clear();
+        to_buffer(msg, buffer);
+    }
+    printf("to_buffer:                  %6.1f allocations/msg\n", (double)(allocationCount() - before) / rounds);
+
+    before = allocationCount();
+    for (int i = 0; i < rounds; i++)
+        from_buffer(msg2, &buffer[0], buffer.size());
+    printf("from_buffer, reused object: %6.1f allocations/msg\n", (double)(allocationCount() - before) / rounds);
+
+    // allInOne called with a deduced type, the way a hand written serializer would call it
+    before = allocationCount();
+    uint32_t length = 0;
+    for (int i = 0; i < rounds; i++)
+    {
+        ros::serialization::LStream stream;
+        ros::serialization::Serializer<CustomMsgArray>::allInOne(stream, msg);
+        length += stream.getLength();
+    }
+    printf("allInOne(stream, msg):      %6.1f allocations/msg (%u)\n", (double)(allocationCount() - before) / rounds,
+           length / rounds);
+}
+
+template <typename MessageType>
+void bench_single_pass(const char* name, const MessageType& msg, int rounds)
+{
+    std::vector<char> buffer;
+    to_buffer(msg, buffer);
+    ros::serialization::GrowBuffer grow;
+    to_stream(msg, grow);
+    bool same = buffer.size() == grow.size() && memcmp(&buffer[0], grow.getData(), grow.size()) == 0;
+
+    size_t sink = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        buffer.clear();
+        to_buffer(msg, buffer);
+        sink += buffer[6];
+    }
+    double two_pass = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+    {
+        grow.clear();
+        to_stream(msg, grow);
+        sink += grow.getData()[6];
+    }
+    double one_pass = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("%-24s same bytes: %d, to_buffer %9.1f ns/msg, to_stream %9.1f ns/msg (%zu)\n", name, same,
+           two_pass / rounds, one_pass / rounds, sink % 2);
+}
+
+void test_single_pass()
+{
+    Odom odom;
+    odom.stamp = ros::Time(1701769169.12340);
+    bench_single_pass("Odom", odom, 1000000);
+
+    CustomMsgArray msg;
+    for (int i = 0; i < 1000; i++)
+        msg.msgs_vector.push_back(CustomMsg("wheel_" + std::to_string(i), i, -i, 0.5f * i));
+    bench_single_pass("CustomMsgArray x1000", msg, 2000);
+}
+
+// keeps the compiler from hoisting work on unchanged inputs out of a benchmark loop
+inline void clobber_memory()
+{
+    asm volatile("" : : : "memory");
+}
+
+// best of several runs, this box is shared and single runs are noisy
+template <typename F>
+double best_ns_per_call(F f, int calls)
+{
+    double best = 1e18;
+    for (int run = 0; run < 10; run++)
+    {
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++)
+            f();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+        best = std::min(best, ns / calls);
+    }
+    return best;
+}
+
+template <typename MessageType>
+void bench_fixed_size(const char* name, const MessageType& msg)
+{
+    uint8_t payload[256];
+    uint32_t length = ros::serialization::serializationLength(msg);
+    MessageType out;
+    volatile uint8_t sink = 0;
+
+    double write = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::OStream stream(payload, sizeof(payload));
+            ros::serialization::serialize(stream, msg);
+            sink = payload[0];
+        },
+        1000000);
+    double read = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::IStream stream(payload, length);
+            ros::serialization::deserialize(stream, out);
+            clobber_memory();
+        },
+        1000000);
+    std::vector<char> buffer;
+    double wrapped = best_ns_per_call(
+        [&]() {
+            buffer.clear();
+            to_buffer(msg, buffer);
+            sink = buffer[6];
+        },
+        1000000);
+    printf("%-12s %2u bytes: serialize %5.2f ns, deserialize %5.2f ns, to_buffer %5.2f ns\n", name, length, write,
+           read, wrapped);
+}
+
+void test_fixed_size()
+{
+    Odom odom;
+    odom.stamp = ros::Time(1701769169.12340);
+    odom.twist_linear_x = 1.123;
+    odom.twist_linear_y = -2.345;
+    odom.twist_angular = 0.5;
+    bench_fixed_size("Odom", odom);
+
+    DeviceState state;
+    state.left_voltage = 24000;
+    state.left_current = 1200;
+    state.left_temperature = 45;
+    state.left_code = 0;
+    state.right_voltage = 24100;
+    state.right_current = 1300;
+    state.right_temperature = 46;
+    state.right_code = 0;
+    bench_fixed_size("DeviceState", state);
+}
+
+// hands pooled buffers from the publisher to the writer thread, a fixed ring so the queue itself never allocates
+struct PooledBufferQueue
+{
+    PooledBuffer slots[64];
+    size_t head = 0;
+    size_t tail = 0;
+    bool done = false;
+    std::mutex mutex;
+    std::condition_variable cond;
+
+    bool push(PooledBuffer&& buffer)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (tail - head == 64)
+            return false;
+        slots[tail++ % 64] = std::move(buffer);
+        cond.notify_one();
+        return true;
+    }
+
+    bool pop(PooledBuffer& buffer)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [this]() { return head != tail || done; });
+        if (head == tail)
+            return false;
+        buffer = std::move(slots[head++ % 64]);
+        return true;
+    }
+
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond.notify_one();
+    }
+};
+
+void test_buffer_pool()
+{
+    int port;
+    int listenfd = listen_loopback(&port);
+    TcpStream stream;
+    if (listenfd == -1 || !stream.open("127.0.0.1", port))
+    {
+        printf("connect failed\n");
+        return;
+    }
+    int peer = accept(listenfd, NULL, NULL);
+    close(listenfd);
+
+    size_t received = 0;
+    std::thread drain([&]() {
+        uint8_t bytes[4096];
+        ssize_t n;
+        while ((n = recv(peer, bytes, sizeof(bytes), 0)) > 0)
+            received += n;
+    });
+
+    // the writer thread releases what the publisher acquired, the blocks travel back through the global freelist
+    PooledBufferQueue queue;
+    size_t written = 0;
+    std::thread writer([&]() {
+        PooledBuffer buffer;
+        while (queue.pop(buffer))
+        {
+            written += buffer.size();
+            stream.write(buffer);
+            buffer.release();
+        }
+    });
+
+    // publish Odom and DeviceState at 1 kHz, count allocations after a warm up second. Blocks are reserved up front
+    // since how many the writer's cache holds at the peak depends on thread timing
+    BufferPool::reserve(128, 64);
+    const int warmup = 1000;
+    const int ticks = 2000;
+    Odom odom;
+    DeviceState state;
+    size_t before = 0;
+    size_t blocksBefore = 0;
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < warmup + ticks; i++)
+    {
+        if (i == warmup)
+        {
+            before = allocationCount();
+            blocksBefore = BufferPool::allocatedBlocks();
+        }
+        odom.stamp = ros::Time::now();
+        odom.twist_linear_x = i % 8 * 0.1;
+        state.left_voltage = 24000 + i % 100;
+
+        // both wrapped messages fit into one 128 byte block
+        PooledBuffer buffer = BufferPool::acquire(128);
+        to_buffer(odom, buffer);
+        to_buffer(state, buffer);
+        while (!queue.push(std::move(buffer)))
+            std::this_thread::yield();
+
+        next += std::chrono::milliseconds(1);
+        std::this_thread::sleep_until(next);
+    }
+    size_t allocations = allocationCount() - before;
+    size_t blocks = BufferPool::allocatedBlocks() - blocksBefore;
+
+    queue.finish();
+    writer.join();
+    stream.close();
+    drain.join();
+    close(peer);
+
+    printf("%d ticks at 1 kHz: %zu heap allocations, %zu new pool blocks (%zu in total), %zu/%zu bytes %s\n", ticks,
+           allocations, blocks, BufferPool::allocatedBlocks(), received, written,
+           allocations == 0 && received == written ? "OK" : "FAILED");
+
+    // single thread cost of a pooled buffer against a reused vector
+    std::vector<char> vector;
+    volatile char sink = 0;
+    double pooled = best_ns_per_call(
+        [&]() {
+            PooledBuffer buffer = BufferPool::acquire(64);
+            to_buffer(odom, buffer);
+            sink = buffer[6];
+        },
+        1000000);
+    double reused = best_ns_per_call(
+        [&]() {
+            vector.clear();
+            to_buffer(odom, vector);
+            sink = vector[6];
+        },
+        1000000);
+    printf("Odom to_buffer: pooled %5.2f ns, reused vector %5.2f ns\n", pooled, reused);
+}
+
+// deserializes every CustomMsgArray packet inside the callback, the way a delegate would use it
+class ArrayDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t* pack, size_t bytes) override
+    {
+        if (arena != NULL)
+        {
+            ax::pmr::CustomMsgArray msg(arena->allocator());
+            ok = from_buffer(msg, (const char*)pack, bytes) && ok;
+            check(msg);
+        }
+        else
+        {
+            CustomMsgArray msg;
+            ok = from_buffer(msg, (const char*)pack, bytes) && ok;
+            check(msg);
+        }
+        packets++;
+    }
+
+    template <typename MessageType>
+    void check(const MessageType& msg)
+    {
+        ok = ok && msg.msgs_vector.size() == expected->msgs_vector.size() 
+             && std::string_view(msg.msgs[1].name) == expected->msgs[1].name;
+        for (size_t i = 0; ok && i < msg.msgs_vector.size(); i++)
+            ok = std::string_view(msg.msgs_vector[i].name) == expected->msgs_vector[i].name
+                 && msg.msgs_vector[i].angular_velocity == expected->msgs_vector[i].angular_velocity;
+    }
+
+    const CustomMsgArray* expected = NULL;
+    ros::MessageArena* arena = NULL;
+    size_t packets = 0;
+    bool ok = true;
+};
+
+void bench_message_arena(const char* name, ros::MessageArena* arena, const CustomMsgArray& msg,
+                         const std::vector<char>& stream, int packetsPerFeed)
+{
+    ArrayDelegate delegate;
+    delegate.expected = &msg;
+    delegate.arena = arena;
+    MsgPackParser parser({CustomMsgArray::magic_header[0], CustomMsgArray::magic_header[1]});
+    ParserManager manager(&delegate);
+    manager.addParser(&parser);
+    manager.setArena(arena);
+
+    // one round to warm up the arena and the parser buffer
+    manager.feed((const uint8_t*)&stream[0], stream.size());
+
+    const int rounds = 200;
+    size_t before = allocationCount();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        manager.feed((const uint8_t*)&stream[0], stream.size());
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    size_t allocations = allocationCount() - before;
+
+    int packets = rounds * packetsPerFeed;
+    printf("%-16s %8.0f packets/s, %6.1f allocations per packet %s\n", name, packets / seconds,
+           (double)allocations / packets,
+           delegate.ok && delegate.packets == (size_t)(packets + packetsPerFeed) ? "OK" : "FAILED");
+}
+
+void test_message_arena()
+{
+    for (int entries : {10, 100, 1000})
+    {
+        CustomMsgArray msg;
+        msg.msgs[0] = CustomMsg("aaaa", 0.1, 0.2, 0.3);
+        msg.msgs[1] = CustomMsg("a name longer than the small string buffer", 0.4, 0.5, 0.6);
+        for (int i = 0; i < entries; i++)
+            msg.msgs_vector.push_back(CustomMsg("laser_scan_segment_" + std::to_string(i), i, -i, 0.5f * i));
+
+        const int packetsPerFeed = 20;
+        std::vector<char> stream;
+        for (int i = 0; i < packetsPerFeed; i++)
+            to_buffer(msg, stream);
+
+        printf("CustomMsgArray with %d entries, %zu bytes\n", entries, stream.size() / packetsPerFeed);
+        bench_message_arena("std::allocator", NULL, msg, stream, packetsPerFeed);
+        ros::MessageArena arena(4096);
+        bench_message_arena("MessageArena", &arena, msg, stream, packetsPerFeed);
+    }
+}
+
+// what an application does without the router: compare headers, then from_buffer checks magic, length and crc again
+class HeaderCompareDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time, const uint8_t* pack,
+                                   size_t bytes) override
+    {
+        if (header[0] == Odom::magic_header[0] && header[1] == Odom::magic_header[1])
+            odoms += from_buffer(odom, (const char*)pack, bytes);
+        else if (header[0] == DeviceState::magic_header[0] && header[1] == DeviceState::magic_header[1])
+            states += from_buffer(state, (const char*)pack, bytes);
+        else if (header[0] == CustomMsgArray::magic_header[0] && header[1] == CustomMsgArray::magic_header[1])
+            arrays += from_buffer(array, (const char*)pack, bytes);
+    }
+
+    Odom odom;
+    DeviceState state;
+    CustomMsgArray array;
+    size_t odoms = 0, states = 0, arrays = 0;
+};
+
+void test_message_router()
+{
+    std::vector<char> stream = make_frame_stream(1024 * 1024);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    MsgPackParser deviceStateParser({DeviceState::magic_header[0], DeviceState::magic_header[1]});
+    MsgPackParser arrayParser({CustomMsgArray::magic_header[0], CustomMsgArray::magic_header[1]});
+
+    HeaderCompareDelegate delegate;
+    ParserManager manager(&delegate);
+    manager.addParser(&odomParser);
+    manager.addParser(&deviceStateParser);
+    manager.addParser(&arrayParser);
+
+    size_t odoms = 0, states = 0, arrays = 0;
+    double sink = 0;
+    MessageRouter router;
+    router.add<Odom>([&](const Odom& msg, ros::Time) {
+        odoms++;
+        sink += msg.twist_linear_x;
+    });
+    router.add<DeviceState>([&](const DeviceState& msg, ros::Time) {
+        states++;
+        sink += msg.left_voltage;
+    });
+    router.add<CustomMsgArray>([&](const CustomMsgArray& msg, ros::Time) {
+        arrays++;
+        sink += msg.msgs_vector.size();
+    });
+    ParserManager routedManager(&router);
+    router.attach(routedManager);
+
+    // the frames one by one, to time dispatch without the scan
+    std::vector<std::pair<const uint8_t*, size_t>> frames;
+    for (size_t offset = 0; offset + sizeof(MsgPack) <= stream.size();)
+    {
+        const MsgPack* pack = (const MsgPack*)&stream[offset];
+        frames.push_back({(const uint8_t*)pack, sizeof(MsgPack) + pack->length});
+        offset += sizeof(MsgPack) + pack->length;
+    }
+    ros::Time now = ros::Time::now();
+    std::vector<uint8_t> header(2);
+
+    // both see the same packets
+    feed_in_chunks(manager, stream, {16384});
+    feed_in_chunks(routedManager, stream, {16384});
+    printf("%zu frames, %zu/%zu/%zu and %zu/%zu/%zu (odom/state/array) dispatched, %zu dropped %s\n", frames.size(),
+           delegate.odoms, delegate.states, delegate.arrays, odoms, states, arrays, router.droppedCount(),
+           odoms == delegate.odoms && states == delegate.states && arrays == delegate.arrays
+                   && odoms + states + arrays == frames.size() && router.droppedCount() == 0
+               ? "OK"
+               : "FAILED");
+    size_t odomFrames = odoms;
+
+    double compare = 1e30, routed = 1e30, compareDispatch = 1e30, routedDispatch = 1e30, validated = 1e30;
+    for (int round = 0; round < 10; round++)
+    {
+        compare = std::min(compare, feed_in_chunks(manager, stream, {16384}));
+        routed = std::min(routed, feed_in_chunks(routedManager, stream, {16384}));
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto& frame : frames)
+        {
+            header[0] = frame.first[0];
+            header[1] = frame.first[1];
+            delegate.ParserManager_packetFound(header, now, frame.first, frame.second);
+        }
+        auto middle = std::chrono::steady_clock::now();
+        for (auto& frame : frames)
+            router.ParserManager_packetFound(header, now, frame.first, frame.second);
+        auto end = std::chrono::steady_clock::now();
+        for (auto& frame : frames)
+            router.route(frame.first, frame.second, now);
+        auto last = std::chrono::steady_clock::now();
+        compareDispatch = std::min(compareDispatch, std::chrono::duration<double>(middle - start).count());
+        routedDispatch = std::min(routedDispatch, std::chrono::duration<double>(end - middle).count());
+        validated = std::min(validated, std::chrono::duration<double>(last - end).count());
+    }
+
+    double n = (double)frames.size();
+
+    // route() does the checks MsgPackParser did for the manager
+    std::vector<uint8_t> bad(frames[0].first, frames[0].first + frames[0].second);
+    bad.back() ^= 1;
+    bool rejected = !router.route(&bad[0], bad.size(), now) && !router.route(&bad[0], bad.size() - 1, now);
+    printf("corrupted frames rejected: %d\n", rejected);
+
+    // replacing a handler after attach keeps the parser the manager holds
+    size_t replaced = 0, before = odoms;
+    router.add<Odom>([&](const Odom&, ros::Time) { replaced++; });
+    feed_in_chunks(routedManager, stream, {16384});
+    printf("handler replaced after attach: %s\n", replaced == odomFrames && odoms == before ? "OK" : "FAILED");
+
+    // a big endian peer, through route() and through the parsers the router attaches
+    Odom odom;
+    odom.twist_linear_x = 1.5;
+    std::vector<char> bigFrame;
+    to_buffer(odom, bigFrame, ros::serialization::BigEndian());
+    size_t bigOdoms = 0;
+    MessageRouter bigRouter{ros::serialization::BigEndian()};
+    bigRouter.add<Odom>([&](const Odom& msg, ros::Time) { bigOdoms += msg.twist_linear_x == 1.5; });
+    ParserManager bigManager(&bigRouter);
+    bigRouter.attach(bigManager);
+    bool bigRouted = bigRouter.route((const uint8_t*)&bigFrame[0], bigFrame.size(), now);
+    feed_in_chunks(bigManager, bigFrame, {bigFrame.size()});
+    bool littleRejected = !router.route((const uint8_t*)&bigFrame[0], bigFrame.size(), now);
+    printf("big endian router: %s\n", bigRouted && bigOdoms == 2 && littleRejected ? "OK" : "FAILED");
+
+    // a handler that replaces itself keeps running until it returns, the next frames go to its replacement
+    size_t firstCalls = 0, secondCalls = 0;
+    MessageRouter selfRouter;
+    selfRouter.add<Odom>([&](const Odom& msg, ros::Time) {
+        std::vector<char> captured(64, (char)msg.twist_linear_x);
+        selfRouter.add<Odom>([&](const Odom&, ros::Time) { secondCalls++; });
+        firstCalls += captured.size() == 64;
+    });
+    ParserManager selfManager(&selfRouter);
+    selfRouter.attach(selfManager);
+    feed_in_chunks(selfManager, stream, {16384});
+    printf("handler replaced from within itself: %s\n",
+           firstCalls == 1 && secondCalls == odomFrames - 1 && selfRouter.droppedCount() == 0 ? "OK" : "FAILED");
+
+    printf("scan + dispatch:  header compare + from_buffer %6.1f ns/packet, MessageRouter %6.1f ns/packet\n",
+           compare / n * 1e9, routed / n * 1e9);
+    printf("dispatch only:    header compare + from_buffer %6.1f ns/packet, MessageRouter %6.1f ns/packet, "
+           "route() with crc %6.1f ns/packet (%.0f)\n",
+           compareDispatch / n * 1e9, routedDispatch / n * 1e9, validated / n * 1e9, sink);
+}
+
+void test_reader_thread()
+{
+    int port;
+    int listenfd = listen_loopback(&port);
+    std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+    if (listenfd == -1 || !stream->open("127.0.0.1", port))
+    {
+        printf("connect failed\n");
+        return;
+    }
+    int peer = accept(listenfd, NULL, NULL);
+    close(listenfd);
+
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    MsgPackParser controlParser(
+        {(uint8_t)TcpRobotControl::magic_header[0], (uint8_t)TcpRobotControl::magic_header[1]});
+    ReaderThread reader(stream);
+    FrameChannel* odomChannel = reader.addChannel(&odomParser, OverflowPolicy_dropOldest, 64);
+    FrameChannel* controlChannel = reader.addChannel(&controlParser, OverflowPolicy_block, 16);
+    reader.start();
+
+    // a slow odom consumer, ~20 us per message, and a control consumer that must see every command in order
+    const int odomCount = 20000;
+    const int controlCount = odomCount / 100;
+    std::atomic<int> lastOdom(-1);
+    std::atomic<int> controls(0);
+    std::atomic<bool> inOrder(true);
+    double worstControlUs = 0;
+
+    std::thread odomConsumer([&]() {
+        MessageRouter router;
+        router.add<Odom>([&](const Odom& msg, ros::Time) {
+            auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+            while (std::chrono::steady_clock::now() < until)
+                ;
+            lastOdom.store((int)msg.twist_linear_x, std::memory_order_relaxed);
+        });
+        ReceivedFrame frame;
+        while (reader.isRunning() || odomChannel->depth() > 0)
+            if (odomChannel->pop(frame, 100))
+                router.dispatch(frame.bytes.data(), frame.time);
+    });
+    std::thread controlConsumer([&]() {
+        MessageRouter router;
+        router.add<TcpRobotControl>([&](const TcpRobotControl& msg, ros::Time time) {
+            if (msg.enable_wheels != (controls.load() % 2 == 0))
+                inOrder = false;
+            worstControlUs = std::max(worstControlUs, time_diff_us(time, ros::Time::now()));
+            controls++;
+        });
+        ReceivedFrame frame;
+        while (reader.isRunning() || controlChannel->depth() > 0)
+            if (controlChannel->pop(frame, 100))
+                router.dispatch(frame.bytes.data(), frame.time);
+    });
+
+    // the peer sends as fast as the socket takes it
+    std::vector<char> bytes;
+    Odom odom;
+    TcpRobotControl control;
+    for (int i = 0; i < odomCount; i++)
+    {
+        odom.twist_linear_x = i;
+        to_buffer(odom, bytes);
+        if (i % 100 == 99)
+        {
+            control.enable_wheels = (i / 100) % 2 == 0;
+            to_buffer(control, bytes);
+        }
+    }
+    for (size_t sent = 0; sent < bytes.size();)
+    {
+        ssize_t n = send(peer, &bytes[sent], bytes.size() - sent, 0);
+        if (n <= 0)
+            break;
+        sent += n;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while ((controls < controlCount || lastOdom < odomCount - 1) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    reader.stop();
+    odomConsumer.join();
+    controlConsumer.join();
+    close(peer);
+
+    printf("odom:    %zu queued, %zu dropped, max depth %zu/%zu, last seen %d\n", odomChannel->pushed(),
+           odomChannel->dropped(), odomChannel->maxDepth(), odomChannel->capacity(), lastOdom.load());
+    printf("control: %zu queued, %zu dropped, max depth %zu/%zu, %d delivered %s, worst latency %.0f us\n",
+           controlChannel->pushed(), controlChannel->dropped(), controlChannel->maxDepth(),
+           controlChannel->capacity(), controls.load(), inOrder ? "in order" : "OUT OF ORDER", worstControlUs);
+    printf("%s\n", controls == controlCount && inOrder && lastOdom == odomCount - 1 ? "OK" : "FAILED");
+}
+
+// stores every state frame in the mailbox of its type, nothing is deserialized
+class MailboxDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                   size_t bytes) override
+    {
+        if (header[0] == Odom::magic_header[0])
+            odom.store(pack, bytes, time);
+        else if (header[0] == DeviceState::magic_header[0])
+            state.store(pack, bytes, time);
+        else
+            robot.store(pack, bytes, time);
+    }
+
+    FrameMailbox odom, state, robot;
+};
+
+// bursts of `burst` frames per state stream, one consumer at a time: timed without the sender
+void bench_state_burst(int burst, int bursts)
+{
+    std::vector<char> bytes;
+    Odom odom;
+    DeviceState state{};
+    TcpRobotState robot{};
+    for (int i = 0; i < burst; i++)
+    {
+        odom.twist_linear_x = i;
+        state.left_voltage = i;
+        robot.battery_percent = (uint8_t)i;
+        to_buffer(odom, bytes);
+        to_buffer(state, bytes);
+        to_buffer(robot, bytes);
+    }
+
+    double sink = 0;
+    MessageRouter router;
+    router.add<Odom>([&](const Odom& msg, ros::Time) { sink += msg.twist_linear_x; });
+    router.add<DeviceState>([&](const DeviceState& msg, ros::Time) { sink += msg.left_voltage; });
+    router.add<TcpRobotState>([&](const TcpRobotState& msg, ros::Time) { sink += msg.battery_percent; });
+    ParserManager routed(&router);
+    router.attach(routed);
+
+    // the crc is left to FrameMailbox::read, only the frames that are read get checked
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]}, false);
+    MsgPackParser stateParser({DeviceState::magic_header[0], DeviceState::magic_header[1]}, false);
+    MsgPackParser robotParser({(uint8_t)TcpRobotState::magic_header[0], (uint8_t)TcpRobotState::magic_header[1]},
+                              false);
+    MailboxDelegate mailboxes;
+    ParserManager conflated(&mailboxes);
+    conflated.addParser(&odomParser);
+    conflated.addParser(&stateParser);
+    conflated.addParser(&robotParser);
+
+    uint64_t seen[3] = {0, 0, 0};
+    bool newest = true;
+    double every = 1e30, latest = 1e30;
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < bursts; i++)
+            routed.feed((const uint8_t*)&bytes[0], bytes.size());
+        auto middle = std::chrono::steady_clock::now();
+        for (int i = 0; i < bursts; i++)
+        {
+            conflated.feed((const uint8_t*)&bytes[0], bytes.size());
+            // the consumer wakes up once per burst and takes the newest of each
+            newest = mailboxes.odom.read(odom, &seen[0]) && newest && odom.twist_linear_x == burst - 1;
+            newest = mailboxes.state.read(state, &seen[1]) && newest && state.left_voltage == burst - 1;
+            newest = mailboxes.robot.read(robot, &seen[2]) && newest && robot.battery_percent == (uint8_t)(burst - 1);
+        }
+        auto end = std::chrono::steady_clock::now();
+        every = std::min(every, std::chrono::duration<double>(middle - start).count());
+        latest = std::min(latest, std::chrono::duration<double>(end - middle).count());
+    }
+    printf("bursts of %4d x 3 frames: deserialize every frame %8.2f us/burst, mailbox %8.2f us/burst, newest %s "
+           "(%.0f)\n",
+           burst, every / bursts * 1e6, latest / bursts * 1e6, newest ? "OK" : "FAILED", sink);
+}
+
+void test_frame_mailbox()
+{
+    for (int burst : {1, 10, 100, 1000})
+        bench_state_burst(burst, 100000 / burst);
+
+    // through a reader thread: a consumer needing 20 us per sample against bursts of 100 odom every 10 ms
+    for (bool conflate : {false, true})
+    {
+        int port;
+        int listenfd = listen_loopback(&port);
+        std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+        if (listenfd == -1 || !stream->open("127.0.0.1", port))
+        {
+            printf("connect failed\n");
+            return;
+        }
+        int peer = accept(listenfd, NULL, NULL);
+        close(listenfd);
+
+        MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]}, !conflate);
+        ReaderThread reader(stream);
+        FrameChannel* channel = NULL;
+        FrameMailbox* mailbox = NULL;
+        if (conflate)
+            mailbox = reader.addMailbox(&odomParser);
+        else
+            channel = reader.addChannel(&odomParser, OverflowPolicy_block, 4096);
+        reader.start();
+
+        size_t handled = 0;
+        double ageUs = 0;
+        double cpu = 0;
+        std::thread consumer([&]() {
+            double cpuStart = thread_cpu_seconds();
+            Odom msg;
+            ros::Time time;
+            auto handle = [&]() {
+                ageUs += time_diff_us(time, ros::Time::now());
+                handled++;
+                auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+                while (std::chrono::steady_clock::now() < until)
+                    ;
+            };
+            uint64_t seen = 0;
+            ReceivedFrame frame;
+            while (reader.isRunning())
+            {
+                if (conflate)
+                {
+                    if (mailbox->read(msg, &seen, &time))
+                        handle();
+                    else
+                        std::this_thread::sleep_for(std::chrono::microseconds(100));
+                }
+                else if (channel->pop(frame, 100))
+                {
+                    from_buffer(msg, (const char*)frame.bytes.data(), frame.bytes.size());
+                    time = frame.time;
+                    handle();
+                }
+            }
+            cpu = thread_cpu_seconds() - cpuStart;
+        });
+
+        std::vector<char> bytes;
+        Odom odom;
+        for (int i = 0; i < 100; i++)
+        {
+            odom.twist_linear_x = i;
+            to_buffer(odom, bytes);
+        }
+        for (int i = 0; i < 100; i++)
+        {
+            if (send(peer, &bytes[0], bytes.size(), 0) != (ssize_t)bytes.size())
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        reader.stop();
+        consumer.join();
+        close(peer);
+
+        printf("%-10s %5zu samples handled, mean age %8.1f us, consumer cpu %6.1f ms\n",
+               conflate ? "mailbox:" : "channel:", handled, handled > 0 ? ageUs / handled : 0, cpu * 1e3);
+    }
+
+    // a big endian peer, fed the way a MsgPackParser(header, false, true) would
+    ros::serialization::BigEndian big;
+    Odom odom;
+    odom.twist_linear_x = 1.5;
+    std::vector<char> frame;
+    to_buffer(odom, frame, big);
+    FrameMailbox mailbox;
+    mailbox.store((const uint8_t*)&frame[0], frame.size(), ros::Time::now());
+    Odom bigOdom;
+    bool bigRead = mailbox.read(bigOdom, NULL, NULL, big) && bigOdom.twist_linear_x == 1.5;
+
+    // a frame with a valid crc whose payload is too short for an Odom
+    uint8_t shortFrame[sizeof(MsgPack) + 4] = {};
+    ax::write_wrapper_header<ros::serialization::LittleEndian>(shortFrame, Odom::magic_header, 4,
+                                                               calculateCRC16(shortFrame + sizeof(MsgPack), 4));
+    mailbox.store(shortFrame, sizeof(shortFrame), ros::Time::now());
+    bool shortRejected = !mailbox.read(bigOdom);
+    printf("mailbox big endian read %d, malformed frame rejected %d %s\n", bigRead, shortRejected,
+           bigRead && shortRejected ? "OK" : "FAILED");
+}
+
+// Odom, DeviceState and TcpRobotState at 1 kHz each for durationMs, Odom latency measured by the receiver
+void bench_batching(const char* name, uint32_t windowUs, bool cork, int durationMs)
+{
+    int port;
+    int listenfd = listen_loopback(&port);
+    std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+    if (listenfd == -1 || !stream->open("127.0.0.1", port))
+    {
+        printf("connect failed\n");
+        return;
+    }
+    int peer = accept(listenfd, NULL, NULL);
+    close(listenfd);
+
+    LatencyDelegate delegate;
+    std::thread receiver([&]() {
+        MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+        ParserManager manager(&delegate);
+        manager.addParser(&odomParser);
+        uint8_t bytes[4096];
+        ssize_t n;
+        while ((n = recv(peer, bytes, sizeof(bytes), 0)) > 0)
+            manager.feed(bytes, n);
+    });
+
+    BatchingWriter writer(stream, 16 * 1024, windowUs, cork);
+    Odom odom;
+    DeviceState state{};
+    TcpRobotState robot{};
+    const uint64_t periodUs = 1000 / 3;
+    uint64_t start = BatchingWriter::nowUs();
+    uint64_t next = start;
+    for (int i = 0; next < start + (uint64_t)durationMs * 1000; i++)
+    {
+        // sleep until the next message or until the batch is due, whichever comes first
+        while (true)
+        {
+            uint64_t now = BatchingWriter::nowUs();
+            if (now >= next)
+                break;
+            int64_t wait = (int64_t)(next - now);
+            int64_t due = writer.untilDeadlineUs();
+            if (due >= 0 && due < wait)
+                wait = due;
+            if (wait > 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(wait));
+            writer.flushIfDue();
+        }
+        next += periodUs;
+
+        switch (i % 3)
+        {
+        case 0:
+            odom.stamp = ros::Time::now();
+            writer.write(odom);
+            break;
+        case 1:
+            writer.write(state);
+            break;
+        default:
+            writer.write(robot);
+            break;
+        }
+    }
+    writer.flush();
+    size_t messages = writer.messageCount();
+    size_t syscalls = writer.syscallCount();
+    size_t flushes = writer.flushCount();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    stream->close();
+    receiver.join();
+    close(peer);
+
+    printf("%-16s %5zu msgs, %5zu flushes, %.3f syscalls/msg, ", name, messages, flushes, (double)syscalls / messages);
+    print_percentiles("odom latency", delegate.latencies);
+}
+
+void test_batching_writer()
+{
+    bench_batching("unbatched", 0, false, 1000);
+    bench_batching("window 100us", 100, false, 1000);
+    bench_batching("window 500us", 500, false, 1000);
+    bench_batching("window 1ms", 1000, false, 1000);
+    bench_batching("window 5ms", 5000, false, 1000);
+    bench_batching("window 1ms cork", 1000, true, 1000);
+
+    // a peer that does not read: the queue stops at maxPendingBytes and the rest is dropped
+    int port;
+    int listenfd = listen_loopback(&port);
+    std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+    if (listenfd == -1 || !stream->open("127.0.0.1", port))
+    {
+        printf("connect failed\n");
+        return;
+    }
+    int peer = accept(listenfd, NULL, NULL);
+    close(listenfd);
+
+    const size_t maxPending = 64 * 1024;
+    BatchingWriter writer(stream, 16 * 1024, 1000, false, maxPending);
+    Odom odom;
+    size_t peak = 0;
+    for (int i = 0; i < 200000; i++)
+    {
+        writer.write(odom);
+        peak = std::max(peak, writer.pendingBytes());
+    }
+    size_t sent = writer.messageCount();
+    printf("stalled peer: %zu of 200000 queued or sent, %zu dropped, peak queue %zu bytes %s\n", sent,
+           writer.droppedCount(), peak,
+           sent + writer.droppedCount() == 200000 && writer.droppedCount() > 0 && peak < maxPending + 1024 ? "OK"
+                                                                                                         : "FAILED");
+    stream->close();
+    close(peer);
+
+    BatchingWriter detached(nullptr);
+    printf("writer without stream: write %d, flush %d\n", detached.write(odom), detached.flush());
+}
+
+// client side of raw_tcp_client_sim: odom one-way latency and TcpRobotControl round trips per connection
+class SimulatorDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t* pack, size_t bytes) override
+    {
+        ros::Time now = ros::Time::now();
+        Odom odom;
+        if (from_buffer(odom, (const char*)pack, bytes))
+        {
+            odomUs.push_back(time_diff_us(odom.stamp, now));
+        }
+        else if (pack[0] == (uint8_t)TcpRobotControl::magic_header[0] && !controlSent.empty())
+        {
+            // echoes come back in send order
+            roundTripUs.push_back(time_diff_us(controlSent.front(), now));
+            controlSent.pop_front();
+        }
+        else
+        {
+            others++;
+        }
+    }
+
+    std::deque<ros::Time> controlSent;
+    std::vector<double> odomUs;
+    std::vector<double> roundTripUs;
+    size_t others = 0;
+};
+
+// needs raw_tcp_client_sim running, e.g. `raw_tcp_client_sim --odom-hz=10000`
+void test_simulator()
+{
+    const int connectionCount = 8;
+    const int durationMs = 5000;
+
+    EventLoop loop;
+    std::vector<SimulatorDelegate> delegates(connectionCount);
+    std::vector<Connection*> connections;
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    MsgPackParser deviceStateParser({DeviceState::magic_header[0], DeviceState::magic_header[1]});
+    MsgPackParser robotStateParser({(uint8_t)TcpRobotState::magic_header[0], (uint8_t)TcpRobotState::magic_header[1]});
+    MsgPackParser controlParser({(uint8_t)TcpRobotControl::magic_header[0], (uint8_t)TcpRobotControl::magic_header[1]});
+    for (int i = 0; i < connectionCount; i++)
+    {
+        std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+        if (!stream->open("127.0.0.1", 8091))
+        {
+            printf("raw_tcp_client_sim is not running on 127.0.0.1:8091\n");
+            return;
+        }
+        int one = 1;
+        setsockopt(stream->fd(), IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        Connection* connection = loop.add(stream, &delegates[i]);
+        connection->parser().addParser(&odomParser);
+        connection->parser().addParser(&deviceStateParser);
+        connection->parser().addParser(&robotStateParser);
+        connection->parser().addParser(&controlParser);
+        connections.push_back(connection);
+    }
+
+    // one control message and one odom per connection and millisecond
+    TcpRobotControl control;
+    control.enable_wheels = true;
+    Odom odom{};
+    std::vector<char> buffer;
+    auto start = std::chrono::steady_clock::now();
+    auto next = start;
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(durationMs))
+    {
+        loop.runOnce(1);
+        if (std::chrono::steady_clock::now() < next)
+            continue;
+        next += std::chrono::milliseconds(1);
+        for (int i = 0; i < connectionCount; i++)
+        {
+            buffer.clear();
+            to_buffer(control, buffer);
+            odom.stamp = ros::Time::now();
+            to_buffer(odom, buffer);
+            delegates[i].controlSent.push_back(odom.stamp);
+            loop.send(connections[i], (const uint8_t*)&buffer[0], buffer.size());
+        }
+    }
+
+    std::vector<double> odomUs, roundTripUs;
+    size_t others = 0;
+    for (auto& d : delegates)
+    {
+        odomUs.insert(odomUs.end(), d.odomUs.begin(), d.odomUs.end());
+        roundTripUs.insert(roundTripUs.end(), d.roundTripUs.begin(), d.roundTripUs.end());
+        others += d.others;
+    }
+    printf("%d connections, %.0f odom/s per connection, %zu state messages\n", connectionCount,
+           odomUs.size() * 1000.0 / durationMs / connectionCount, others);
+    print_percentiles("odom one-way", odomUs);
+    print_percentiles("control round trip", roundTripUs);
+}
+
+void test_pipeline_metrics()
+{
+    // histogram resolution
+    HdrHistogram histogram;
+    for (uint64_t v = 1; v <= 1000000; v++)
+        histogram.record(v);
+    const double percentiles[] = {50, 90, 99, 99.9};
+    for (double p : percentiles)
+    {
+        double error = histogram.valueAtPercentile(p) / (p * 10000) - 1;
+        printf("p%g of 1..1e6: %llu, error %.2f%%\n", p, (unsigned long long)histogram.valueAtPercentile(p),
+               error * 100);
+    }
+
+    // one corrupted frame and 10 garbage bytes between frames
+    std::vector<char> stream = make_frame_stream(1024 * 1024, 10);
+    std::vector<char> corrupted = stream;
+    corrupted[sizeof(MsgPack) + 2] ^= 0x55;
+
+    size_t delivered = 0;
+    MessageRouter router;
+    router.add<Odom>([&](const Odom&, ros::Time) { delivered++; });
+    router.add<DeviceState>([&](const DeviceState&, ros::Time) { delivered++; });
+    router.add<CustomMsgArray>([&](const CustomMsgArray&, ros::Time) { delivered++; });
+
+    PipelineMetrics metrics;
+    {
+        ParserManager manager(&router);
+        router.attach(manager);
+        manager.setMetrics(&metrics);
+        feed_in_chunks(manager, corrupted, {1500});
+    }
+    PipelineSnapshot snapshot = metrics.snapshot();
+    snapshot.print(stdout);
+    printf("delivered %zu, frames %llu, crc failures %llu, bytes %llu of %zu\n", delivered,
+           (unsigned long long)snapshot.frames, (unsigned long long)snapshot.crcFailures,
+           (unsigned long long)snapshot.bytes, corrupted.size());
+
+    // overhead per frame, same stream with and without metrics
+    auto nsPerFrame = [&](bool instrumented) {
+        ParserManager manager(&router);
+        router.attach(manager);
+        PipelineMetrics local;
+        if (instrumented)
+            manager.setMetrics(&local);
+        double best = 1e9;
+        for (int round = 0; round < 20; round++)
+        {
+            size_t before = delivered;
+            double seconds = feed_in_chunks(manager, stream, {1500});
+            best = std::min(best, seconds * 1e9 / (delivered - before));
+        }
+        return best;
+    };
+    double plain = nsPerFrame(false);
+    double instrumented = nsPerFrame(true);
+    printf("feed + dispatch: %.1f ns/frame plain, %.1f ns/frame with metrics (+%.1f ns)\n", plain, instrumented,
+           instrumented - plain);
+}
+
+// stamps every packet with ros::Time::now(), what ParserManager did per header before it stamped once per chunk
+class WallStampDelegate : public ParserManagerDelegate
+{
+public:
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t*, size_t) override
+    {
+        last = ros::Time::now();
+        packets++;
+    }
+
+    ros::Time last;
+    size_t packets = 0;
+};
+
+void test_clock()
+{
+    for (int source = 0; source < ClockSource_count; source++)
+    {
+        if (!clockSelectSource((ClockSource)source))
+            continue;
+        double ns = best_ns_per_call([]() { clobber_memory(); return clockToRosTime(clockNowNs()).nsec; }, 100000);
+        printf("%-14s %5.1f ns per stamp\n", clockSourceName((ClockSource)source), ns);
+    }
+    printf("%-14s %5.1f ns per stamp\n", "ros::Time::now",
+           best_ns_per_call([]() { clobber_memory(); return ros::Time::now().nsec; }, 100000));
+
+    // odom frames in 1500 byte chunks, about 60 per chunk
+    std::vector<char> stream;
+    Odom odom;
+    while (stream.size() < 256 * 1024)
+        to_buffer(odom, stream);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+
+    auto nsPerPacket = [&](ParserManagerDelegate& delegate, size_t& packets) {
+        ParserManager manager(&delegate);
+        manager.addParser(&odomParser);
+        double best = 1e9;
+        for (int round = 0; round < 50; round++)
+        {
+            size_t before = packets;
+            double seconds = feed_in_chunks(manager, stream, {1500});
+            best = std::min(best, seconds * 1e9 / (packets - before));
+        }
+        return best;
+    };
+
+    for (int source = 0; source < ClockSource_count; source++)
+    {
+        if (!clockSelectSource((ClockSource)source))
+            continue;
+        CountingDelegate counting;
+        WallStampDelegate stamping;
+        double after = nsPerPacket(counting, counting.packets);
+        double before = nsPerPacket(stamping, stamping.packets);
+        printf("%-14s per packet: %5.1f ns one stamp per chunk, %5.1f ns with a ros::Time::now() per packet\n",
+               clockSourceName((ClockSource)source), after, before);
+    }
+    clockSelectSource(ClockSource_monotonic);
+
+    // stamps are monotonic clock time shifted to the wall clock once, they stay close to ros::Time::now()
+    ros::Time wall = ros::Time::now();
+    ros::Time stamp = clockToRosTime(clockNowNs());
+    printf("stamp - wall clock: %.1f us\n", time_diff_us(wall, stamp));
+}
+
+void test_frame_capture()
+{
+    const char* path = "/tmp/raw_tcp_client_capture";
+    std::vector<char> stream = make_frame_stream(8 * 1024 * 1024, 3);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+    MsgPackParser deviceStateParser({DeviceState::magic_header[0], DeviceState::magic_header[1]});
+    MsgPackParser arrayParser({CustomMsgArray::magic_header[0], CustomMsgArray::magic_header[1]});
+
+    // record through a ParserManager, 1 MB segments so the capture spans several
+    CountingDelegate live;
+    {
+        FrameRecorder recorder(&live, 1024 * 1024);
+        if (!recorder.open(path))
+        {
+            printf("can not open %s\n", path);
+            return;
+        }
+        ParserManager manager(&recorder);
+        manager.addParser(&odomParser);
+        manager.addParser(&deviceStateParser);
+        manager.addParser(&arrayParser);
+        feed_in_chunks(manager, stream, {1500});
+        printf("recorded %zu frames in %zu segments\n", recorder.frameCount(), recorder.segmentCount());
+    }
+
+    FrameReplayer replayer;
+    if (!replayer.open(path))
+    {
+        printf("can not replay %s\n", path);
+        return;
+    }
+
+    // as fast as possible, the frames and their bytes have to come out as they went in
+    CountingDelegate replayed;
+    ParserManager manager(&replayed);
+    manager.addParser(&odomParser);
+    manager.addParser(&deviceStateParser);
+    manager.addParser(&arrayParser);
+    auto begin = std::chrono::steady_clock::now();
+    size_t fed = replayer.replay(manager, ReplayMode_fastest);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("replayed %zu of %zu frames, %zu of %zu bytes, %.0f frames/s %s\n", replayed.packets, live.packets,
+           replayed.total, live.total, fed / seconds,
+           fed == live.packets && replayed.packets == live.packets && replayed.total == live.total ? "OK" : "FAILED");
+
+    // seeking: every frame before the position is older than the time, the one at it is not
+    bool ordered = true;
+    uint64_t span = replayer.lastStampNs() - replayer.firstStampNs();
+    for (int i = 1; i < 10; i++)
+    {
+        uint64_t ns = replayer.firstStampNs() + span * i / 10;
+        ros::Time target((uint32_t)(ns / 1000000000), (uint32_t)(ns % 1000000000));
+        const uint8_t* pack;
+        size_t bytes;
+        ros::Time time;
+        auto seekBegin = std::chrono::steady_clock::now();
+        bool found = replayer.seek(target) && replayer.next(&pack, &bytes, &time);
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - seekBegin).count();
+        ordered = ordered && found && time_diff_us(target, time) >= 0;
+        printf("seek to %d/10: %.1f us\n", i, us);
+    }
+
+    // original timing, 200 frames stamped 1 ms apart replayed at 4x speed take about 50 ms
+    {
+        FrameRecorder recorder;
+        recorder.open(path);
+        std::vector<char> frame;
+        to_buffer(Odom(), frame);
+        for (int i = 0; i < 200; i++)
+            recorder.append((const uint8_t*)&frame[0], frame.size(), ros::Time(1700000000, i * 1000000));
+    }
+    replayer.open(path);
+    begin = std::chrono::steady_clock::now();
+    fed = replayer.replay(manager, ReplayMode_originalTiming, 4.0);
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    printf("timed replay: %zu frames in %.1f ms %s\n", fed, ms,
+           ordered && fed == 200 && ms > 49 && ms < 70 ? "OK" : "FAILED");
+}
+
+class ReconnectTimingDelegate : public ReconnectingStreamDelegate
+{
+public:
+    void ReconnectingStream_connected() override { connectedAt = std::chrono::steady_clock::now(); }
+
+    std::chrono::steady_clock::time_point connectedAt;
+};
+
+// accepts a connection on listenfd and reads until count frames arrived, or until timeoutMs passed
+int accept_and_count(int listenfd, ReconnectingStream& client, ParserManager& server, CountingDelegate& frames,
+                     size_t count, int timeoutMs, std::chrono::steady_clock::time_point* firstByte)
+{
+    int fd = -1;
+    bool first = true;
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    while (frames.packets < count && std::chrono::steady_clock::now() < until)
+    {
+        client.poll(1);
+        if (fd == -1)
+            fd = accept4(listenfd, NULL, NULL, SOCK_NONBLOCK);
+        uint8_t buffer[4096];
+        ssize_t n = fd == -1 ? -1 : recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0)
+        {
+            if (firstByte != NULL && first)
+                *firstByte = std::chrono::steady_clock::now();
+            first = false;
+            server.feed(buffer, n);
+        }
+    }
+    return fd;
+}
+
+void test_reconnect()
+{
+    std::vector<char> frame;
+    to_buffer(Odom(), frame);
+    MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]});
+
+    // nobody listening: attempts fail right away and the backoff grows up to its maximum
+    int port = 0;
+    int listenfd = listen_loopback(&port);
+    close(listenfd);
+
+    ReconnectConfig config;
+    config.port = port;
+    config.backoffInitialMs = 5;
+    config.backoffMaxMs = 40;
+    config.maxQueuedBytes = 10 * frame.size();
+
+    CountingDelegate received;
+    ParserManager clientParser(&received);
+    clientParser.addParser(&odomParser);
+    ReconnectTimingDelegate timing;
+    ReconnectingStream client(config, &clientParser, &timing);
+    client.start();
+    auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(300);
+    while (std::chrono::steady_clock::now() < until)
+        client.poll(10);
+    printf("refused: %zu attempts in 300 ms, backoff now %d ms %s\n", client.failedAttempts(), client.backoffMs(),
+           client.failedAttempts() >= 6 && client.failedAttempts() < 30 && client.backoffMs() <= 40 ? "OK" : "FAILED");
+
+    // sent while disconnected: the queue keeps the newest 10 of 15 whole messages
+    for (int i = 0; i < 15; i++)
+        client.send((const uint8_t*)&frame[0], frame.size());
+    printf("queued %zu messages, dropped %zu %s\n", client.queuedMessages(), client.droppedMessages(),
+           client.queuedMessages() == 10 && client.droppedMessages() == 5 ? "OK" : "FAILED");
+
+    // the server comes up on the same port, the queue goes out right after the connect
+    listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenfd, 16) != 0)
+    {
+        printf("can not listen on %d again\n", port);
+        return;
+    }
+
+    CountingDelegate serverFrames;
+    ParserManager server(&serverFrames);
+    server.addParser(&odomParser);
+    std::chrono::steady_clock::time_point firstByte;
+    auto listening = std::chrono::steady_clock::now();
+    int peer = accept_and_count(listenfd, client, server, serverFrames, 10, 2000, &firstByte);
+    double upMs = std::chrono::duration<double, std::milli>(timing.connectedAt - listening).count();
+    double firstUs = std::chrono::duration<double, std::micro>(firstByte - timing.connectedAt).count();
+    bool ok = serverFrames.packets == 10 && upMs < 60 && client.queuedBytes() == 0;
+    printf("server up -> connected %.1f ms, connected -> first byte %.0f us, %zu frames %s\n", upMs, firstUs,
+           serverFrames.packets, ok ? "OK" : "FAILED");
+
+    // the server drops mid-frame: the head must not be completed with bytes of the next connection
+    send(peer, &frame[0], frame.size() / 2, MSG_NOSIGNAL);
+    until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (std::chrono::steady_clock::now() < until)
+        client.poll(1);
+    close(peer);
+    // sent before the client saw the close it would go into the dead socket, lost like with any TCP sender
+    until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (client.isConnected() && std::chrono::steady_clock::now() < until)
+        client.poll(1);
+
+    CountingDelegate secondFrames;
+    ParserManager second(&secondFrames);
+    second.addParser(&odomParser);
+    client.send((const uint8_t*)&frame[0], frame.size());
+    peer = accept_and_count(listenfd, client, second, secondFrames, 1, 2000, NULL);
+    send(peer, &frame[0], frame.size(), MSG_NOSIGNAL);
+    until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    while (std::chrono::steady_clock::now() < until)
+        client.poll(1);
+    printf("after the drop: connects %zu, frames received %zu, bytes %zu, sent over the new connection %zu %s\n",
+           client.connectCount(), received.packets, received.total, secondFrames.packets,
+           client.connectCount() == 2 && received.packets == 1 && received.total == frame.size()
+                   && secondFrames.packets == 1
+               ? "OK"
+               : "FAILED");
+
+    client.stop();
+    close(peer);
+    close(listenfd);
+}
+
+// a pod whose memory layout is longer than its serialized form: 3 bytes of padding after id
+struct PaddedRecord
+{
+    uint8_t id;
+    uint32_t value;
+};
+
+namespace ros
+{
+namespace message_traits
+{
+template <>
+struct IsFixedSize<PaddedRecord> : public TrueType
+{
+};
+} // namespace message_traits
+
+namespace serialization
+{
+template <>
+struct Serializer<PaddedRecord>
+{
+    template <typename Stream, typename T>
+    constexpr static void allInOne(Stream& stream, T&& m)
+    {
+        stream.next(m.id);
+        stream.next(m.value);
+    }
+
+    ROS_DECLARE_ALLINONE_SERIALIZER
+};
+} // namespace serialization
+} // namespace ros
+
+void test_bulk_arrays()
+{
+    // every engine against bswap per word, all word sizes, odd lengths and offsets, in place
+    bool ok = true;
+    std::vector<uint8_t> src(8 * 300 + 8), expect(src.size()), out(src.size());
+    for (size_t i = 0; i < src.size(); i++)
+        src[i] = (uint8_t)(i * 31 + 7);
+    const ByteSwapFuncs* scalar = byteSwapEngineFuncs(ByteSwapEngine_scalar);
+    for (int e = ByteSwapEngine_ssse3; e < ByteSwapEngine_count; e++)
+    {
+        ByteSwapEngine engine = (ByteSwapEngine)e;
+        if (!byteSwapEngineSupported(engine))
+        {
+            printf("byte swap %s not supported here\n", byteSwapEngineName(engine));
+            continue;
+        }
+        const ByteSwapFuncs* funcs = byteSwapEngineFuncs(engine);
+        ByteSwapFunc checked[3] = {funcs->swap16, funcs->swap32, funcs->swap64};
+        ByteSwapFunc reference[3] = {scalar->swap16, scalar->swap32, scalar->swap64};
+        for (int w = 0; w < 3; w++)
+            for (size_t count = 0; count <= 300; count++)
+                for (size_t offset = 0; offset < 4; offset++)
+                {
+                    reference[w](&expect[offset], &src[offset], count);
+                    checked[w](&out[offset], &src[offset], count);
+                    size_t bytes = count << (w + 1);
+                    bool same = memcmp(&expect[offset], &out[offset], bytes) == 0;
+                    out.assign(src.begin(), src.end());
+                    checked[w](&out[offset], &out[offset], count);
+                    ok = ok && same && memcmp(&expect[offset], &out[offset], bytes) == 0;
+                }
+    }
+    printf("byte swap engines match scalar, current %s %s\n", byteSwapEngineName(byteSwapCurrentEngine()),
+           ok ? "OK" : "FAILED");
+
+    // padded pods go element by element, in the 5 bytes each one takes on the wire
+    std::vector<PaddedRecord> padded = {{1, 0x01020304}, {2, 0x05060708}, {3, 0x090a0b0c}};
+    std::array<PaddedRecord, 2> paddedArray = {padded[1], padded[2]};
+    std::vector<char> paddedBuffer(ros::serialization::serializationLength(padded)
+                                   + ros::serialization::serializationLength(paddedArray));
+    ros::serialization::OStream paddedOut((uint8_t*)&paddedBuffer[0], (uint32_t)paddedBuffer.size());
+    ros::serialization::serialize(paddedOut, padded);
+    ros::serialization::serialize(paddedOut, paddedArray);
+    std::vector<PaddedRecord> paddedBack;
+    std::array<PaddedRecord, 2> paddedArrayBack{};
+    ros::serialization::IStream paddedIn((uint8_t*)&paddedBuffer[0], (uint32_t)paddedBuffer.size());
+    ros::serialization::deserialize(paddedIn, paddedBack);
+    ros::serialization::deserialize(paddedIn, paddedArrayBack);
+    bool paddedOk = paddedBuffer.size() == 4 + 3 * 5 + 2 * 5 && paddedOut.getLength() == 0 && paddedIn.getLength() == 0
+                    && paddedBack.size() == 3 && paddedBack[2].id == 3 && paddedBack[2].value == 0x090a0b0c
+                    && paddedArrayBack[1].id == 3 && paddedArrayBack[1].value == 0x090a0b0c;
+    printf("padded pod arrays: %zu bytes %s\n", paddedBuffer.size(), paddedOk ? "OK" : "FAILED");
+
+    // arrays of fixed size records go through one bounds check and a bulk copy
+    std::vector<Odom> poses(1000);
+    for (size_t i = 0; i < poses.size(); i++)
+    {
+        poses[i].stamp = ros::Time(1701769169 + i, i * 1000);
+        poses[i].twist_linear_x = i * 0.5f;
+        poses[i].twist_linear_y = -(float)i;
+        poses[i].twist_angular = 0.25f;
+    }
+    std::vector<TcpRobotState> states(1000);
+    for (size_t i = 0; i < states.size(); i++)
+    {
+        states[i].wheels_enabled = i % 2;
+        states[i].battery_percent = i % 101;
+        states[i].is_charge = i % 3 == 0;
+    }
+    std::array<TcpRobotState, 3> fixed = {states[1], states[2], states[3]};
+
+    uint32_t length = ros::serialization::serializationLength(poses) + ros::serialization::serializationLength(states)
+                      + ros::serialization::serializationLength(fixed);
+    std::vector<uint8_t> payload(length);
+    ros::serialization::OStream ostream(&payload[0], length);
+    ros::serialization::serialize(ostream, poses);
+    ros::serialization::serialize(ostream, states);
+    ros::serialization::serialize(ostream, fixed);
+
+    std::vector<Odom> posesOut;
+    std::vector<TcpRobotState> statesOut;
+    std::array<TcpRobotState, 3> fixedOut;
+    ros::serialization::IStream istream(&payload[0], length);
+    ros::serialization::deserialize(istream, posesOut);
+    ros::serialization::deserialize(istream, statesOut);
+    ros::serialization::deserialize(istream, fixedOut);
+    ok = posesOut.size() == poses.size() && statesOut.size() == states.size() && istream.getLength() == 0;
+    for (size_t i = 0; ok && i < poses.size(); i++)
+        ok = posesOut[i].stamp.nsec == poses[i].stamp.nsec && posesOut[i].twist_linear_x == poses[i].twist_linear_x
+             && posesOut[i].twist_linear_y == poses[i].twist_linear_y
+             && statesOut[i].battery_percent == states[i].battery_percent
+             && statesOut[i].is_charge == states[i].is_charge;
+    ok = ok && fixedOut[2].battery_percent == fixed[2].battery_percent;
+    printf("%u bytes of record arrays round trip %s\n", length, ok ? "OK" : "FAILED");
+
+    // a corrupt element count is caught before anything is resized or read
+    uint32_t corrupt = 0x7fffffff;
+    memcpy(&payload[0], &corrupt, sizeof(corrupt));
+    bool thrown = false;
+    try
+    {
+        ros::serialization::IStream stream(&payload[0], length);
+        ros::serialization::deserialize(stream, posesOut);
+    }
+    catch (ros::serialization::StreamOverrunException&)
+    {
+        thrown = true;
+    }
+    printf("corrupt count rejected %s\n", thrown ? "OK" : "FAILED");
+    uint32_t count = poses.size();
+    memcpy(&payload[0], &count, sizeof(count));
+
+    double write = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::OStream stream(&payload[0], length);
+            ros::serialization::serialize(stream, poses);
+            clobber_memory();
+        },
+        1000);
+    double read = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::IStream stream(&payload[0], length);
+            ros::serialization::deserialize(stream, posesOut);
+            clobber_memory();
+        },
+        1000);
+    printf("vector<Odom>: serialize %.2f ns, deserialize %.2f ns per element\n", write / poses.size(),
+           read / poses.size());
+}
+
+// serialized in the byte order Endian
+template <typename Endian, typename MessageType>
+std::vector<uint8_t> serialize_in(const MessageType& msg)
+{
+    std::vector<uint8_t> bytes(ros::serialization::serializationLength(msg));
+    ros::serialization::OStream<Endian> stream(bytes.data(), (uint32_t)bytes.size());
+    ros::serialization::serialize(stream, msg);
+    return bytes;
+}
+
+// msg through the wire in both orders, compared by its little endian bytes since messages have no operator==
+template <typename MessageType>
+bool endian_round_trip(const char* name, const MessageType& msg)
+{
+    std::vector<uint8_t> little = serialize_in<ros::serialization::LittleEndian>(msg);
+    std::vector<uint8_t> big = serialize_in<ros::serialization::BigEndian>(msg);
+
+    MessageType fromLittle{}, fromBig{};
+    ros::serialization::IStream<ros::serialization::LittleEndian> littleStream(little.data(), (uint32_t)little.size());
+    ros::serialization::deserialize(littleStream, fromLittle);
+    ros::serialization::IStream<ros::serialization::BigEndian> bigStream(big.data(), (uint32_t)big.size());
+    ros::serialization::deserialize(bigStream, fromBig);
+
+    // the default stream is little endian, what every peer got before there was a choice
+    std::vector<uint8_t> plain(little.size());
+    ros::serialization::OStream stream(plain.data(), (uint32_t)plain.size());
+    ros::serialization::serialize(stream, msg);
+
+    bool ok = plain == little && serialize_in<ros::serialization::LittleEndian>(fromLittle) == little
+              && serialize_in<ros::serialization::LittleEndian>(fromBig) == little;
+    printf("%-24s %4zu bytes, orders %s, round trips %s\n", name, little.size(), little == big ? "same" : "differ",
+           ok ? "OK" : "FAILED");
+    return ok;
+}
+
+// framed with to_buffer, to_stream and to_iovec in big endian, parsed by a big endian MsgPackParser
+template <typename MessageType>
+bool endian_wrapped(const char* name, const MessageType& msg)
+{
+    ros::serialization::BigEndian big;
+    std::vector<char> buffer;
+    to_buffer(msg, buffer, big);
+    ros::serialization::GrowBuffer grow;
+    to_stream(msg, grow, big);
+    ros::serialization::GatherStream<ros::serialization::BigEndian> gather;
+    to_iovec(msg, gather);
+    std::vector<char> gathered;
+    for (const struct iovec& iov : gather.iov())
+        gathered.insert(gathered.end(), (const char*)iov.iov_base, (const char*)iov.iov_base + iov.iov_len);
+    bool same = gathered == buffer && grow.size() == buffer.size()
+                && memcmp(grow.getData(), &buffer[0], grow.size()) == 0;
+
+    MessageType out{};
+    bool read = from_buffer(out, &buffer[0], buffer.size(), big);
+    std::vector<char> little;
+    to_buffer(out, little);
+    std::vector<char> expected;
+    to_buffer(msg, expected);
+    // a little endian reader takes the length for garbage and rejects the frame
+    MessageType wrong{};
+    bool rejected = !from_buffer(wrong, &buffer[0], buffer.size());
+
+    CountingDelegate frames;
+    ParserManager manager(&frames);
+    MsgPackParser parser({(uint8_t)MessageType::magic_header[0], (uint8_t)MessageType::magic_header[1]}, true, true);
+    manager.addParser(&parser);
+    manager.feed((const uint8_t*)&buffer[0], buffer.size());
+
+    bool ok = same && read && little == expected && rejected && frames.packets == 1;
+    printf("%-24s framed big endian, to_stream and to_iovec same bytes %d, parsed %zu %s\n", name, same,
+           frames.packets, ok ? "OK" : "FAILED");
+    return ok;
+}
+
+void test_endian()
+{
+    // Big    Endian: 01 23 45 67
+    // Little Endian: 67 45 23 01
+    int value = 0x01234567;
+    print_buffer(&value, sizeof(int));
+
+    CustomMsgArray array;
+    array.msgs[0] = CustomMsg("aaaa", 0.1, 0.2, 5.0 / 180 * M_PI);
+    array.msgs[1] = CustomMsg("bbbbbbbb", -0.1, 1e-20, 1e20);
+    for (int i = 0; i < 100; i++)
+        array.msgs_vector.push_back(CustomMsg(std::string(i % 17, 'x'), i, -i, i * 0.5));
+
+    DeviceState device;
+    device.left_voltage = 24000;
+    device.left_current = 1200;
+    device.left_temperature = 45;
+    device.left_code = 0x0102;
+    device.right_voltage = 24100;
+    device.right_current = 1300;
+    device.right_temperature = 46;
+    device.right_code = 0xfffe;
+
+    Header header;
+    header.seq = 0x01020304;
+    header.stamp = ros::Time(1701769169, 123456789);
+    header.frame_id = "base_link";
+
+    Odom odom;
+    odom.stamp = ros::Time(1701769169.12340);
+    odom.twist_linear_x = 1.123;
+    odom.twist_linear_y = -2.345;
+    odom.twist_angular = 3.14;
+
+    TcpRobotControl control;
+    control.enable_wheels = true;
+
+    TcpRobotState state;
+    state.wheels_enabled = true;
+    state.battery_percent = 87;
+    state.is_charge = false;
+
+    Vector3 vector3;
+    vector3.x = 1.5;
+    vector3.y = -2.25e-300;
+    vector3.z = 3e300;
+
+    WheelState wheel;
+    wheel.enable_state = DISABLED;
+    wheel.wheel_error_msg = "overcurrent";
+
+    // every port_msgs type, then arrays of them for the bulk paths: word swapped when the words are of one size
+    bool ok = endian_round_trip("CustomMsgArray", array);
+    ok = endian_round_trip("DeviceState", device) && ok;
+    ok = endian_round_trip("Header", header) && ok;
+    ok = endian_round_trip("Odom", odom) && ok;
+    ok = endian_round_trip("TcpRobotControl", control) && ok;
+    ok = endian_round_trip("TcpRobotState", state) && ok;
+    ok = endian_round_trip("Vector3", vector3) && ok;
+    ok = endian_round_trip("WheelControlEnableState", ENABLED) && ok;
+    ok = endian_round_trip("WheelState", wheel) && ok;
+    ok = endian_round_trip("vector<Odom>", std::vector<Odom>(100, odom)) && ok;
+    ok = endian_round_trip("vector<float>", std::vector<float>(99, -2.345f)) && ok;
+    ok = endian_round_trip("array<DeviceState, 3>", std::array<DeviceState, 3>{device, device, device}) && ok;
+    ok = endian_round_trip("array<Vector3, 2>", std::array<Vector3, 2>{vector3, vector3}) && ok;
+    ok = endian_round_trip("vector<TcpRobotState>", std::vector<TcpRobotState>(5, state)) && ok;
+    ok = endian_round_trip("vector<Header>", std::vector<Header>(3, header)) && ok;
+
+    ok = endian_wrapped("CustomMsgArray", array) && ok;
+    ok = endian_wrapped("DeviceState", device) && ok;
+    ok = endian_wrapped("Odom", odom) && ok;
+    ok = endian_wrapped("TcpRobotState", state) && ok;
+    ok = endian_wrapped("WheelState", wheel) && ok;
+
+    // big endian is the most significant byte first, field by field
+    std::vector<uint8_t> big = serialize_in<ros::serialization::BigEndian>(header);
+    const uint8_t expected[] = {0x01, 0x02, 0x03, 0x04, 0x65, 0x6e, 0xef, 0xd1, 0x07, 0x5b, 0xcd, 0x15, 0, 0, 0, 9};
+    ok = memcmp(big.data(), expected, sizeof(expected)) == 0 && ok;
+    print_buffer(big.data(), big.size());
+    printf("all port_msgs types in both byte orders %s\n", ok ? "OK" : "FAILED");
+
+    // the swap is only paid for when the orders differ
+    uint8_t payload[64];
+    volatile uint8_t sink = 0;
+    double little = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::OStream<ros::serialization::LittleEndian> stream(payload, sizeof(payload));
+            ros::serialization::serialize(stream, odom);
+            sink = payload[0];
+        },
+        1000000);
+    double swapped = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::OStream<ros::serialization::BigEndian> stream(payload, sizeof(payload));
+            ros::serialization::serialize(stream, odom);
+            sink = payload[0];
+        },
+        1000000);
+    std::vector<Odom> odoms(1000, odom);
+    std::vector<uint8_t> bytes(ros::serialization::serializationLength(odoms));
+    double bulk = best_ns_per_call(
+        [&]() {
+            clobber_memory();
+            ros::serialization::OStream<ros::serialization::BigEndian> stream(bytes.data(), (uint32_t)bytes.size());
+            ros::serialization::serialize(stream, odoms);
+            sink = bytes[4];
+        },
+        1000);
+    printf("Odom serialize: little endian %.2f ns, big endian %.2f ns, vector<Odom> big endian %.2f ns per element\n",
+           little, swapped, bulk / odoms.size());
 }
 
 int main()
@@ -222,6 +2660,29 @@ int main()
     // test_wheel_enable();
     // test_device_state();
     // test_robot_state();
+    // test_crc16();
+    // test_parser_manager();
+    // test_header_scanner();
+    // test_event_loop();
+    // test_uring();
+    // test_gather_send();
+    // test_message_view();
+    // test_serializer_refs();
+    // test_single_pass();
+    // test_fixed_size();
+    // test_buffer_pool();
+    // test_message_arena();
+    // test_message_router();
+    // test_reader_thread();
+    // test_frame_mailbox();
+    // test_batching_writer();
+    // test_simulator();
+    // test_pipeline_metrics();
+    // test_clock();
+    // test_frame_capture();
+    // test_reconnect();
+    // test_bulk_arrays();
+    // test_endian();
 
     test_recv();
 
@@ -0,0 +1,132 @@
+#include "packet/batching_writer.h"
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+BatchingWriter::BatchingWriter(std::shared_ptr<TcpStream> stream, size_t flushBytes, uint32_t windowUs, bool cork,
+                               size_t maxPendingBytes)
+    : m_stream(stream),
+      m_flushBytes(flushBytes),
+      m_windowUs(windowUs),
+      m_cork(cork),
+      m_maxPendingBytes(maxPendingBytes),
+      m_buffer(flushBytes + 1024)
+{
+    // small batches must not wait for acks, the window above decides how long bytes are held
+    int on = 1;
+    if (m_stream && m_stream->fd() != -1)
+        setsockopt(m_stream->fd(), IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+BatchingWriter::~BatchingWriter()
+{
+    flush();
+}
+
+uint64_t BatchingWriter::nowUs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+bool BatchingWriter::append(const uint8_t* bytes, size_t n)
+{
+    if (!makeRoom())
+        return false;
+    if (m_buffer.size() == m_sent)
+        m_oldestUs = nowUs();
+    {
+        ros::serialization::GrowStream stream(m_buffer);
+        memcpy(stream.advance((uint32_t)n), bytes, n);
+    }
+    m_messages++;
+    return afterAppend();
+}
+
+bool BatchingWriter::makeRoom()
+{
+    if (!m_stream || !m_stream->isConnected())
+        return false;
+    if (pendingBytes() < m_maxPendingBytes)
+        return true;
+
+    // the socket may have drained since the last flush
+    flush();
+    if (pendingBytes() < m_maxPendingBytes)
+        return m_stream->isConnected();
+    m_dropped++;
+    return false;
+}
+
+bool BatchingWriter::afterAppend()
+{
+    if (m_windowUs == 0 || pendingBytes() >= m_flushBytes)
+        return flush();
+    return flushIfDue();
+}
+
+bool BatchingWriter::flushIfDue()
+{
+    if (!m_stream)
+        return false;
+    if (pendingBytes() == 0 || nowUs() - m_oldestUs < m_windowUs)
+        return m_stream->isConnected();
+    return flush();
+}
+
+int64_t BatchingWriter::untilDeadlineUs() const
+{
+    if (pendingBytes() == 0)
+        return -1;
+    int64_t left = (int64_t)(m_oldestUs + m_windowUs) - (int64_t)nowUs();
+    return left > 0 ? left : 0;
+}
+
+bool BatchingWriter::flush()
+{
+    if (!m_stream)
+        return false;
+    if (pendingBytes() == 0)
+        return m_stream->isConnected();
+
+    int fd = m_stream->fd();
+    int on = 1, off = 0;
+    if (m_cork)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_CORK, &on, sizeof(on));
+        m_syscalls++;
+    }
+
+    while (pendingBytes() > 0)
+    {
+        int written = m_stream->write(m_buffer.getData() + m_sent, pendingBytes());
+        m_syscalls++;
+        if (written <= 0)
+            break;
+        m_sent += written;
+    }
+
+    // uncorking pushes out the last partial segment
+    if (m_cork)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_CORK, &off, sizeof(off));
+        m_syscalls++;
+    }
+
+    m_flushes++;
+    if (pendingBytes() == 0)
+    {
+        m_buffer.clear();
+        m_sent = 0;
+    }
+    else if (m_sent >= pendingBytes())
+    {
+        // drop the sent prefix once it outweighs the rest, so the move costs no more than what was sent
+        m_buffer.erase(m_sent);
+        m_sent = 0;
+    }
+    return m_stream->isConnected();
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stdint.h>
+#include <memory>
+#include "packet/tcp_stream.h"
+#include "ros/message_wrapper.h"
+
+/**
+Coalesces framed messages into one buffer and sends them with one write, instead of one send per message.
+
+A batch goes out when it reaches flushBytes, when its oldest message has waited windowUs, or on flush(). The
+window is only checked when a message is added or flushIfDue() is called, so a sender that may go quiet calls
+flushIfDue() from its loop, for example with untilDeadlineUs() as poll timeout. Nagle is turned off, batching is
+done here. With cork the socket is corked around every flush so the kernel cuts full segments even when a flush
+takes several sends, at the price of two setsockopt calls per flush.
+
+Bytes the socket does not take stay queued and go out first with the next flush. While maxPendingBytes or more are
+queued new messages are refused and counted as dropped, so a peer that stops reading can not grow the queue
+without bound.
+
+demo code:
+```
+BatchingWriter writer(stream, 16 * 1024, 500);
+writer.write(odom);
+writer.write(deviceState);
+...
+writer.flushIfDue();
+```
+*/
+class BatchingWriter
+{
+public:
+    /// windowUs 0 sends every message right away
+    BatchingWriter(std::shared_ptr<TcpStream> stream, size_t flushBytes = 16 * 1024, uint32_t windowUs = 1000,
+                   bool cork = false, size_t maxPendingBytes = 1024 * 1024);
+    ~BatchingWriter();
+
+    BatchingWriter(const BatchingWriter&) = delete;
+    BatchingWriter& operator=(const BatchingWriter&) = delete;
+
+    /// frames msg into the batch, false if it was dropped because the queue is full or the connection is gone
+    template <typename MessageType>
+    bool write(const MessageType& msg)
+    {
+        if (!makeRoom())
+            return false;
+        if (m_buffer.size() == m_sent)
+            m_oldestUs = nowUs();
+        ax::to_stream(msg, m_buffer);
+        m_messages++;
+        return afterAppend();
+    }
+
+    /// appends an already framed message
+    bool append(const uint8_t* bytes, size_t n);
+
+    /// sends everything queued, false if the connection is gone
+    bool flush();
+    /// flushes if the window of the oldest queued message has passed
+    bool flushIfDue();
+    /// microseconds until the batch is due, -1 if nothing is queued
+    int64_t untilDeadlineUs() const;
+
+    size_t pendingBytes() const { return m_buffer.size() - m_sent; }
+    size_t messageCount() const { return m_messages; }
+    /// messages refused because maxPendingBytes were queued
+    size_t droppedCount() const { return m_dropped; }
+    size_t flushCount() const { return m_flushes; }
+    /// send and setsockopt calls made so far
+    size_t syscallCount() const { return m_syscalls; }
+
+    static uint64_t nowUs();
+
+private:
+    bool makeRoom();
+    bool afterAppend();
+
+private:
+    std::shared_ptr<TcpStream> m_stream;
+    size_t m_flushBytes;
+    uint32_t m_windowUs;
+    bool m_cork;
+    size_t m_maxPendingBytes;
+
+    ros::serialization::GrowBuffer m_buffer;
+    // bytes at the front of m_buffer that an earlier flush already sent
+    size_t m_sent = 0;
+    uint64_t m_oldestUs = 0;
+
+    size_t m_messages = 0;
+    size_t m_dropped = 0;
+    size_t m_flushes = 0;
+    size_t m_syscalls = 0;
+};
@@ -0,0 +1,261 @@
+#include "packet/buffer_pool.h"
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <utility>
+
+#define BUFFER_POOL_CACHE_BLOCKS 32
+#define BUFFER_POOL_ALIGNMENT 64
+
+// header in front of every block, one cache line so the data starts on the next one
+struct alignas(BUFFER_POOL_ALIGNMENT) BufferBlock
+{
+    std::atomic<BufferBlock*> next;
+    uint32_t sizeClass; // kSizeClasses for blocks that are too large to pool
+    uint32_t capacity;
+
+    uint8_t* data() { return (uint8_t*)(this + 1); }
+};
+
+namespace
+{
+// freelist heads pack a 48 bit pointer and a 16 bit tag that changes on every update, so a pop that read a head
+// which was popped and pushed back in the meantime fails its compare and retries (ABA)
+const uint64_t kPointerMask = (1ull << 48) - 1;
+
+inline BufferBlock* headBlock(uint64_t head)
+{
+    return (BufferBlock*)(head & kPointerMask);
+}
+
+inline uint64_t makeHead(BufferBlock* block, uint64_t oldHead)
+{
+    return (uint64_t)block | ((oldHead & ~kPointerMask) + (1ull << 48));
+}
+
+struct alignas(BUFFER_POOL_ALIGNMENT) FreeList
+{
+    std::atomic<uint64_t> head{0};
+};
+
+FreeList g_freeLists[BufferPool::kSizeClasses];
+std::atomic<size_t> g_allocatedBlocks(0);
+
+// plain data, so it is usable at any point of the thread's life, ThreadCacheFlusher hands it back on exit
+struct ThreadCache
+{
+    BufferBlock* heads[BufferPool::kSizeClasses];
+    int counts[BufferPool::kSizeClasses];
+    bool closed;
+};
+
+thread_local ThreadCache t_cache;
+
+int sizeClassOf(size_t capacity)
+{
+    int sizeClass = 0;
+    for (size_t size = BufferPool::kMinBlockSize; size < capacity; size <<= 1)
+        sizeClass++;
+    return sizeClass;
+}
+
+BufferBlock* allocateBlock(int sizeClass, size_t capacity)
+{
+    void* p = ::operator new(sizeof(BufferBlock) + capacity, std::align_val_t(BUFFER_POOL_ALIGNMENT));
+    BufferBlock* block = new (p) BufferBlock;
+    block->next.store(nullptr, std::memory_order_relaxed);
+    block->sizeClass = (uint32_t)sizeClass;
+    block->capacity = (uint32_t)capacity;
+    g_allocatedBlocks.fetch_add(1, std::memory_order_relaxed);
+    return block;
+}
+
+// first..last must already be linked
+void pushChain(int sizeClass, BufferBlock* first, BufferBlock* last)
+{
+    std::atomic<uint64_t>& head = g_freeLists[sizeClass].head;
+    uint64_t old = head.load(std::memory_order_relaxed);
+    do
+    {
+        last->next.store(headBlock(old), std::memory_order_relaxed);
+    } while (!head.compare_exchange_weak(old, makeHead(first, old), std::memory_order_release,
+                                         std::memory_order_relaxed));
+}
+
+BufferBlock* pop(int sizeClass)
+{
+    std::atomic<uint64_t>& head = g_freeLists[sizeClass].head;
+    uint64_t old = head.load(std::memory_order_acquire);
+    while (headBlock(old) != nullptr)
+    {
+        // blocks are never freed, reading next of a block another thread just took is harmless, the tag catches it
+        BufferBlock* next = headBlock(old)->next.load(std::memory_order_relaxed);
+        if (head.compare_exchange_weak(old, makeHead(next, old), std::memory_order_acquire,
+                                       std::memory_order_acquire))
+            return headBlock(old);
+    }
+    return nullptr;
+}
+
+struct ThreadCacheFlusher
+{
+    ~ThreadCacheFlusher()
+    {
+        for (int i = 0; i < BufferPool::kSizeClasses; i++)
+        {
+            BufferBlock* first = t_cache.heads[i];
+            if (first == nullptr)
+                continue;
+            BufferBlock* last = first;
+            while (last->next.load(std::memory_order_relaxed) != nullptr)
+                last = last->next.load(std::memory_order_relaxed);
+            pushChain(i, first, last);
+            t_cache.heads[i] = nullptr;
+            t_cache.counts[i] = 0;
+        }
+        // buffers released after this, by thread_local or static destructors, go straight to the freelists
+        t_cache.closed = true;
+    }
+};
+
+inline void registerFlusher()
+{
+    // constructed the first time the thread's cache is touched, destroyed when the thread exits
+    static thread_local ThreadCacheFlusher flusher;
+    (void)flusher;
+}
+} // namespace
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept
+    : m_block(other.m_block), m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity)
+{
+    other.m_block = nullptr;
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_block = other.m_block;
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        other.m_block = nullptr;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+    }
+    return *this;
+}
+
+void PooledBuffer::resize(size_t size)
+{
+    if (size > m_capacity)
+    {
+        PooledBuffer larger = BufferPool::acquire(size > m_capacity * 2 ? size : m_capacity * 2);
+        if (m_size > 0)
+            memcpy(larger.m_data, m_data, m_size);
+        *this = std::move(larger);
+    }
+    m_size = size;
+}
+
+void PooledBuffer::release()
+{
+    if (m_block == nullptr)
+        return;
+    BufferPool::release(m_block);
+    m_block = nullptr;
+    m_data = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+PooledBuffer BufferPool::acquire(size_t capacity)
+{
+    PooledBuffer buffer;
+    BufferBlock* block;
+    if (capacity > kMaxBlockSize)
+    {
+        block = allocateBlock(kSizeClasses, capacity);
+    }
+    else
+    {
+        int sizeClass = sizeClassOf(capacity);
+        block = t_cache.heads[sizeClass];
+        if (block != nullptr)
+        {
+            t_cache.heads[sizeClass] = block->next.load(std::memory_order_relaxed);
+            t_cache.counts[sizeClass]--;
+        }
+        else
+        {
+            if (!t_cache.closed)
+                registerFlusher();
+            block = pop(sizeClass);
+            if (block == nullptr)
+                block = allocateBlock(sizeClass, kMinBlockSize << sizeClass);
+        }
+    }
+
+    buffer.m_block = block;
+    buffer.m_data = block->data();
+    buffer.m_capacity = block->capacity;
+    return buffer;
+}
+
+void BufferPool::release(BufferBlock* block)
+{
+    int sizeClass = (int)block->sizeClass;
+    if (sizeClass == kSizeClasses)
+    {
+        block->~BufferBlock();
+        ::operator delete(block, std::align_val_t(BUFFER_POOL_ALIGNMENT));
+        return;
+    }
+
+    if (t_cache.closed)
+    {
+        pushChain(sizeClass, block, block);
+        return;
+    }
+
+    // a full cache gives half of its blocks to the freelist in one go, the other threads pick them up from there
+    if (t_cache.counts[sizeClass] == BUFFER_POOL_CACHE_BLOCKS)
+    {
+        BufferBlock* first = t_cache.heads[sizeClass];
+        BufferBlock* last = first;
+        for (int i = 1; i < BUFFER_POOL_CACHE_BLOCKS / 2; i++)
+            last = last->next.load(std::memory_order_relaxed);
+        t_cache.heads[sizeClass] = last->next.load(std::memory_order_relaxed);
+        t_cache.counts[sizeClass] -= BUFFER_POOL_CACHE_BLOCKS / 2;
+        pushChain(sizeClass, first, last);
+    }
+
+    if (t_cache.heads[sizeClass] == nullptr)
+        registerFlusher();
+    block->next.store(t_cache.heads[sizeClass], std::memory_order_relaxed);
+    t_cache.heads[sizeClass] = block;
+    t_cache.counts[sizeClass]++;
+}
+
+void BufferPool::reserve(size_t capacity, int count)
+{
+    if (capacity > kMaxBlockSize)
+        return;
+    int sizeClass = sizeClassOf(capacity);
+    for (int i = 0; i < count; i++)
+    {
+        BufferBlock* block = allocateBlock(sizeClass, kMinBlockSize << sizeClass);
+        pushChain(sizeClass, block, block);
+    }
+}
+
+size_t BufferPool::allocatedBlocks()
+{
+    return g_allocatedBlocks.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+struct BufferBlock;
+
+/**
+Send buffer borrowed from BufferPool, it goes back to the pool when the handle is destroyed.
+
+Usable wherever to_buffer takes a std::vector<char>: size(), resize() and operator[] behave the same, except that
+resize() does not zero the new bytes. Growing past capacity() swaps in a block of a larger size class.
+
+demo code:
+```
+PooledBuffer buffer = BufferPool::acquire(256);
+to_buffer(msg, buffer);
+tcpStream.write(buffer);
+```
+*/
+class PooledBuffer
+{
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer() { release(); }
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    uint8_t* data() { return m_data; }
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    char& operator[](size_t i) { return ((char*)m_data)[i]; }
+    const char& operator[](size_t i) const { return ((const char*)m_data)[i]; }
+
+    void resize(size_t size);
+    /// forgets the content, the block is kept
+    void clear() { m_size = 0; }
+    /// hands the block back to the pool now
+    void release();
+
+private:
+    friend class BufferPool;
+
+    BufferBlock* m_block = nullptr;
+    uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+};
+
+/**
+Process wide pool of cache line aligned send buffers in power of two size classes from 64 bytes to 64 KB.
+
+Every thread keeps a small cache per size class and only touches the shared lock free freelists when its cache runs
+empty or overflows, so a buffer acquired on one thread and released on another (serializer and writer thread)
+flows back through the freelist. Blocks are never returned to the system: once the pool has seen the peak number of
+buffers in flight, acquire and release do no heap allocation. Requests above 64 KB are allocated and freed directly.
+*/
+class BufferPool
+{
+public:
+    static const size_t kMinBlockSize = 64;
+    static const size_t kMaxBlockSize = 64 * 1024;
+    static const int kSizeClasses = 11;
+
+    /// a buffer with at least capacity bytes and size 0
+    static PooledBuffer acquire(size_t capacity);
+
+    /// allocates count blocks of the size class for capacity up front, so the first messages do not allocate either
+    static void reserve(size_t capacity, int count);
+
+    /// number of blocks allocated from the system so far, all size classes
+    static size_t allocatedBlocks();
+
+private:
+    friend class PooledBuffer;
+
+    static void release(BufferBlock* block);
+};
@@ -0,0 +1,168 @@
+#include "packet/event_loop.h"
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+
+#define EVENT_LOOP_READ_SIZE 64 * 1024
+#define EVENT_LOOP_MAX_EVENTS 256
+
+EventLoop::EventLoop(EventLoopDelegate* delegate) : m_delegate(delegate), m_readBuffer(EVENT_LOOP_READ_SIZE)
+{
+    m_epollfd = epoll_create1(EPOLL_CLOEXEC);
+}
+
+EventLoop::~EventLoop()
+{
+    for (auto& connection : m_connections)
+        connection->m_stream->close();
+    if (m_epollfd != -1)
+        ::close(m_epollfd);
+}
+
+Connection* EventLoop::add(std::shared_ptr<TcpStream> stream, ParserManagerDelegate* delegate, size_t bufferSize)
+{
+    if (!isValid() || !stream || !stream->isConnected())
+        return NULL;
+
+    std::unique_ptr<Connection> connection(new Connection(stream, delegate, bufferSize));
+
+    // always ask for EPOLLOUT, with edge triggering it only fires when the send buffer drains
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.ptr = connection.get();
+    if (epoll_ctl(m_epollfd, EPOLL_CTL_ADD, stream->fd(), &ev) != 0)
+        return NULL;
+
+    m_connections.push_back(std::move(connection));
+    return m_connections.back().get();
+}
+
+void EventLoop::remove(Connection* connection)
+{
+    if (connection->m_closed)
+        return;
+
+    connection->m_closed = true;
+    epoll_ctl(m_epollfd, EPOLL_CTL_DEL, connection->m_stream->fd(), NULL);
+    connection->m_stream->close();
+
+    auto it = std::find_if(m_connections.begin(), m_connections.end(),
+                           [connection](const std::unique_ptr<Connection>& c) { return c.get() == connection; });
+    if (it != m_connections.end())
+    {
+        m_closed.push_back(std::move(*it));
+        m_connections.erase(it);
+    }
+}
+
+void EventLoop::close(Connection* connection)
+{
+    if (connection->m_closed)
+        return;
+
+    if (m_delegate != NULL)
+        m_delegate->EventLoop_connectionClosed(connection);
+    remove(connection);
+}
+
+bool EventLoop::send(Connection* connection, const uint8_t* bytes, size_t n)
+{
+    if (connection->m_closed || !connection->m_stream->isConnected())
+        return false;
+
+    // keep ordering, nothing goes out directly while older bytes are queued
+    if (connection->pendingBytes() == 0)
+    {
+        while (n > 0)
+        {
+            int written = connection->m_stream->write(bytes, n);
+            if (written <= 0)
+                break;
+            bytes += written;
+            n -= written;
+        }
+
+        if (!connection->m_stream->isConnected())
+        {
+            close(connection);
+            return false;
+        }
+    }
+
+    connection->m_pending.insert(connection->m_pending.end(), bytes, bytes + n);
+    return true;
+}
+
+int EventLoop::runOnce(int timeoutMs)
+{
+    struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+    int count = epoll_wait(m_epollfd, events, EVENT_LOOP_MAX_EVENTS, timeoutMs);
+
+    for (int i = 0; i < count; i++)
+    {
+        Connection* connection = (Connection*)events[i].data.ptr;
+        if (connection->m_closed)
+            continue;
+
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+            handleReadable(connection);
+        if (!connection->m_closed && (events[i].events & EPOLLOUT))
+            handleWritable(connection);
+    }
+
+    m_closed.clear();
+    return count;
+}
+
+void EventLoop::run()
+{
+    m_running = true;
+    while (m_running)
+        runOnce(-1);
+}
+
+void EventLoop::handleReadable(Connection* connection)
+{
+    // edge triggered: drain the socket, otherwise we are not woken again
+    while (true)
+    {
+        int n = connection->m_stream->read(&m_readBuffer[0], m_readBuffer.size());
+        if (n > 0)
+        {
+            connection->m_parser.feed(&m_readBuffer[0], n);
+            if (connection->m_closed) // closed from a packet callback
+                return;
+        }
+        else
+        {
+            if (!connection->m_stream->isConnected())
+                close(connection);
+            return;
+        }
+    }
+}
+
+void EventLoop::handleWritable(Connection* connection)
+{
+    while (connection->pendingBytes() > 0)
+    {
+        const uint8_t* bytes = &connection->m_pending[connection->m_pendingOffset];
+        int written = connection->m_stream->write(bytes, connection->pendingBytes());
+        if (written <= 0)
+            break;
+        connection->m_pendingOffset += written;
+    }
+
+    if (!connection->m_stream->isConnected())
+    {
+        close(connection);
+        return;
+    }
+
+    // drop what has been sent so the queue does not grow while the peer is slow
+    connection->m_pending.erase(connection->m_pending.begin(),
+                                connection->m_pending.begin() + connection->m_pendingOffset);
+    connection->m_pendingOffset = 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "packet/packet_parser.h"
+#include "packet/tcp_stream.h"
+
+// per connection parser buffer, room for the largest frame of the protocol with margin. UART_BUFFER_MAX_SIZE for
+// every one of hundreds of peers would commit hundreds of MB
+#define EVENT_LOOP_BUFFER_SIZE 64 * 1024
+
+class EventLoop;
+
+/**
+One TcpStream owned by an EventLoop. Received bytes go straight into the connection's ParserManager,
+writes that the socket can not take right away are queued and flushed when it becomes writable.
+*/
+class Connection
+{
+public:
+    Connection(std::shared_ptr<TcpStream> stream, ParserManagerDelegate* delegate, size_t bufferSize)
+        : m_stream(stream), m_parser(delegate, bufferSize)
+    {
+    }
+
+    TcpStream& stream() { return *m_stream; }
+    ParserManager& parser() { return m_parser; }
+    size_t pendingBytes() const { return m_pending.size() - m_pendingOffset; }
+
+    /// user data, not touched by the loop
+    void* context = nullptr;
+
+private:
+    friend class EventLoop;
+
+    std::shared_ptr<TcpStream> m_stream;
+    ParserManager m_parser;
+    std::vector<uint8_t> m_pending;
+    size_t m_pendingOffset = 0;
+    bool m_closed = false;
+};
+
+class EventLoopDelegate
+{
+public:
+    virtual void EventLoop_connectionClosed(Connection* connection) = 0;
+};
+
+/**
+Edge-triggered epoll loop over many connections, single threaded: add, send and runOnce must be called from
+the same thread.
+
+demo code:
+```
+EventLoop loop;
+Connection* c = loop.add(stream, &packetDelegate);
+c->parser().addParser(&odomParser);
+while (true)
+    loop.runOnce(-1);
+```
+*/
+class EventLoop
+{
+public:
+    EventLoop(EventLoopDelegate* delegate = nullptr);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    bool isValid() const { return m_epollfd != -1; }
+    size_t connectionCount() const { return m_connections.size(); }
+
+    /// the stream must already be open, returns NULL if it can not be watched. A frame larger than bufferSize is
+    /// dropped
+    Connection* add(std::shared_ptr<TcpStream> stream, ParserManagerDelegate* delegate,
+                    size_t bufferSize = EVENT_LOOP_BUFFER_SIZE);
+    /// closes the stream, the connection is destroyed
+    void remove(Connection* connection);
+
+    /// writes what the socket takes now and queues the rest, false if the connection is gone
+    bool send(Connection* connection, const uint8_t* bytes, size_t n);
+
+    /// waits up to timeoutMs (-1 forever) and handles ready connections, returns the number of events
+    int runOnce(int timeoutMs);
+    void run();
+    void stop() { m_running = false; }
+
+private:
+    void handleReadable(Connection* connection);
+    void handleWritable(Connection* connection);
+    void close(Connection* connection);
+
+private:
+    EventLoopDelegate* m_delegate;
+    int m_epollfd = -1;
+    bool m_running = false;
+    std::vector<std::unique_ptr<Connection>> m_connections;
+    // closed while events may still point at them, freed at the end of runOnce
+    std::vector<std::unique_ptr<Connection>> m_closed;
+    std::vector<uint8_t> m_readBuffer;
+};
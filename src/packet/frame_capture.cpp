@@ -0,0 +1,348 @@
+#include "packet/frame_capture.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#define FRAME_CAPTURE_VERSION 1
+
+namespace
+{
+std::string segmentName(const std::string& path, uint32_t segment)
+{
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), ".%06u", segment);
+    return path + suffix;
+}
+
+size_t recordSize(size_t bytes)
+{
+    return sizeof(FrameRecordHeader) + ((bytes + 7) & ~(size_t)7);
+}
+
+uint64_t toNs(ros::Time time)
+{
+    return (uint64_t)time.sec * 1000000000ull + time.nsec;
+}
+
+ros::Time fromNs(uint64_t ns)
+{
+    return ros::Time((uint32_t)(ns / 1000000000ull), (uint32_t)(ns % 1000000000ull));
+}
+} // namespace
+
+FrameRecorder::FrameRecorder(ParserManagerDelegate* next, size_t segmentBytes)
+    : m_next(next), m_segmentBytes(std::max(segmentBytes, (size_t)4096))
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    close();
+}
+
+bool FrameRecorder::open(const std::string& path)
+{
+    close();
+    m_path = path;
+    m_segment = 0;
+    m_frames = 0;
+
+    // a replayer reads segments until one is missing, leftovers of a longer capture would be taken as ours
+    for (uint32_t i = 0; unlink(segmentName(path, i).c_str()) == 0; i++)
+    {
+    }
+    return openSegment();
+}
+
+void FrameRecorder::close()
+{
+    if (m_map != NULL)
+        closeSegment();
+}
+
+bool FrameRecorder::openSegment()
+{
+    std::string name = segmentName(m_path, m_segment);
+    m_fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (m_fd == -1)
+        return false;
+
+    void* map = MAP_FAILED;
+    if (ftruncate(m_fd, (off_t)m_segmentBytes) == 0)
+        map = mmap(NULL, m_segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (map == MAP_FAILED)
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    m_map = (uint8_t*)map;
+    FrameSegmentHeader* header = (FrameSegmentHeader*)m_map;
+    memset(header, 0, sizeof(FrameSegmentHeader));
+    memcpy(header->magic, FRAME_CAPTURE_MAGIC, sizeof(header->magic));
+    header->version = FRAME_CAPTURE_VERSION;
+    header->headerSize = sizeof(FrameSegmentHeader);
+    m_used = sizeof(FrameSegmentHeader);
+    m_index.clear();
+    m_segment++;
+    return true;
+}
+
+void FrameRecorder::closeSegment()
+{
+    // the index goes behind the records, the header points at it only once it is written
+    size_t indexBytes = m_index.size() * sizeof(FrameIndexEntry);
+    FrameSegmentHeader* header = (FrameSegmentHeader*)m_map;
+    if (indexBytes == 0 || pwrite(m_fd, &m_index[0], indexBytes, (off_t)m_used) == (ssize_t)indexBytes)
+    {
+        header->indexOffset = m_used;
+        header->indexCount = m_index.size();
+    }
+    else
+    {
+        indexBytes = 0;
+    }
+
+    munmap(m_map, m_segmentBytes);
+    m_map = NULL;
+    if (ftruncate(m_fd, (off_t)(m_used + indexBytes)) != 0)
+        perror("FrameRecorder truncate");
+    ::close(m_fd);
+    m_fd = -1;
+}
+
+bool FrameRecorder::append(const uint8_t* pack, size_t bytes, ros::Time time)
+{
+    if (m_map == NULL)
+        return false;
+
+    size_t size = recordSize(bytes);
+    if (m_used + size > m_segmentBytes)
+    {
+        if (m_used == sizeof(FrameSegmentHeader))
+            return false; // does not fit an empty segment either
+        closeSegment();
+        if (!openSegment())
+            return false;
+    }
+
+    FrameSegmentHeader* header = (FrameSegmentHeader*)m_map;
+    uint64_t stampNs = toNs(time);
+    if (header->frameCount % FRAME_CAPTURE_INDEX_INTERVAL == 0)
+        m_index.push_back(FrameIndexEntry{stampNs, m_used});
+
+    FrameRecordHeader* record = (FrameRecordHeader*)(m_map + m_used);
+    record->stampNs = stampNs;
+    record->length = (uint32_t)bytes;
+    record->reserved = 0;
+    memcpy(record + 1, pack, bytes);
+    m_used += size;
+
+    // counters last, a reader of a cut off segment trusts them
+    if (header->frameCount == 0)
+        header->firstStampNs = stampNs;
+    header->lastStampNs = stampNs;
+    header->dataBytes = m_used - sizeof(FrameSegmentHeader);
+    header->frameCount++;
+    m_frames++;
+    return true;
+}
+
+void FrameRecorder::ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                              size_t bytes)
+{
+    append(pack, bytes, time);
+    if (m_next != NULL)
+        m_next->ParserManager_packetFound(header, time, pack, bytes);
+}
+
+FrameReplayer::~FrameReplayer()
+{
+    close();
+}
+
+bool FrameReplayer::open(const std::string& path)
+{
+    close();
+    for (uint32_t i = 0;; i++)
+    {
+        Segment segment;
+        if (!openSegment(segmentName(path, i), segment))
+            break;
+        m_frameCount += segment.header->frameCount;
+        m_segments.push_back(std::move(segment));
+    }
+    rewind();
+    return !m_segments.empty();
+}
+
+void FrameReplayer::close()
+{
+    for (Segment& segment : m_segments)
+    {
+        munmap((void*)segment.map, segment.size);
+        ::close(segment.fd);
+    }
+    m_segments.clear();
+    m_frameCount = 0;
+    rewind();
+}
+
+bool FrameReplayer::openSegment(const std::string& name, Segment& segment)
+{
+    int fd = ::open(name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(FrameSegmentHeader))
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    const FrameSegmentHeader* header = (const FrameSegmentHeader*)map;
+    if (map == MAP_FAILED || memcmp(header->magic, FRAME_CAPTURE_MAGIC, sizeof(header->magic)) != 0
+        || header->headerSize < sizeof(FrameSegmentHeader)
+        || header->headerSize + header->dataBytes > (size_t)st.st_size)
+    {
+        if (map != MAP_FAILED)
+            munmap(map, (size_t)st.st_size);
+        ::close(fd);
+        return false;
+    }
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    segment.fd = fd;
+    segment.map = (const uint8_t*)map;
+    segment.size = (size_t)st.st_size;
+    segment.header = header;
+
+    size_t indexBytes = header->indexCount * sizeof(FrameIndexEntry);
+    if (header->indexOffset != 0 && header->indexOffset + indexBytes <= segment.size)
+    {
+        const FrameIndexEntry* index = (const FrameIndexEntry*)(segment.map + header->indexOffset);
+        segment.index.assign(index, index + header->indexCount);
+        return true;
+    }
+
+    // not closed properly, rebuild the index from the records
+    size_t end = header->headerSize + header->dataBytes;
+    size_t offset = header->headerSize;
+    for (uint64_t frame = 0; offset + sizeof(FrameRecordHeader) <= end; frame++)
+    {
+        const FrameRecordHeader* record = (const FrameRecordHeader*)(segment.map + offset);
+        if (frame % FRAME_CAPTURE_INDEX_INTERVAL == 0)
+            segment.index.push_back(FrameIndexEntry{record->stampNs, offset});
+        offset += recordSize(record->length);
+    }
+    return true;
+}
+
+uint64_t FrameReplayer::firstStampNs() const
+{
+    return m_segments.empty() ? 0 : m_segments.front().header->firstStampNs;
+}
+
+uint64_t FrameReplayer::lastStampNs() const
+{
+    return m_segments.empty() ? 0 : m_segments.back().header->lastStampNs;
+}
+
+void FrameReplayer::rewind()
+{
+    m_segment = 0;
+    m_offset = m_segments.empty() ? 0 : m_segments[0].header->headerSize;
+}
+
+bool FrameReplayer::seek(ros::Time time)
+{
+    uint64_t stampNs = toNs(time);
+
+    // first segment that ends at or after the time
+    auto segment = std::lower_bound(m_segments.begin(), m_segments.end(), stampNs,
+                                    [](const Segment& s, uint64_t ns) { return s.header->lastStampNs < ns; });
+    if (segment == m_segments.end() || segment->index.empty())
+    {
+        m_segment = m_segments.size();
+        return false;
+    }
+
+    // the index entry before the first one at or after the time, frames in between may still be earlier
+    auto entry = std::lower_bound(segment->index.begin(), segment->index.end(), stampNs,
+                                  [](const FrameIndexEntry& e, uint64_t ns) { return e.stampNs < ns; });
+    if (entry != segment->index.begin())
+        entry--;
+
+    m_segment = segment - m_segments.begin();
+    m_offset = entry->offset;
+    size_t end = segment->header->headerSize + segment->header->dataBytes;
+    while (m_offset + sizeof(FrameRecordHeader) <= end)
+    {
+        const FrameRecordHeader* record = (const FrameRecordHeader*)(segment->map + m_offset);
+        if (record->stampNs >= stampNs)
+            return true;
+        m_offset += recordSize(record->length);
+    }
+    return false;
+}
+
+bool FrameReplayer::next(const uint8_t** pack, size_t* bytes, ros::Time* time)
+{
+    while (m_segment < m_segments.size())
+    {
+        const Segment& segment = m_segments[m_segment];
+        size_t end = segment.header->headerSize + segment.header->dataBytes;
+        if (m_offset + sizeof(FrameRecordHeader) <= end)
+        {
+            const FrameRecordHeader* record = (const FrameRecordHeader*)(segment.map + m_offset);
+            if (m_offset + sizeof(FrameRecordHeader) + record->length > end)
+                return false; // corrupt, the record runs past the data
+            *pack = (const uint8_t*)(record + 1);
+            *bytes = record->length;
+            if (time != NULL)
+                *time = fromNs(record->stampNs);
+            m_offset += recordSize(record->length);
+            return true;
+        }
+
+        m_segment++;
+        if (m_segment < m_segments.size())
+            m_offset = m_segments[m_segment].header->headerSize;
+    }
+    return false;
+}
+
+size_t FrameReplayer::replay(ParserManager& manager, ReplayMode mode, double speed, size_t maxFrames)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    uint64_t startNs = (uint64_t)start.tv_sec * 1000000000ull + start.tv_nsec;
+
+    size_t count = 0;
+    uint64_t firstStampNs = 0;
+    const uint8_t* pack;
+    size_t bytes;
+    ros::Time time;
+    while (count < maxFrames && next(&pack, &bytes, &time))
+    {
+        if (mode == ReplayMode_originalTiming)
+        {
+            uint64_t stampNs = toNs(time);
+            if (count == 0)
+                firstStampNs = stampNs;
+            uint64_t dueNs = startNs + (uint64_t)((double)(stampNs - firstStampNs) / speed);
+            struct timespec due = {(time_t)(dueNs / 1000000000ull), (long)(dueNs % 1000000000ull)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR)
+            {
+            }
+        }
+        manager.feed(pack, bytes);
+        count++;
+    }
+    return count;
+}
@@ -0,0 +1,171 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "packet/packet_parser.h"
+
+/**
+Capture files: a capture is a series of segment files <path>.000000, <path>.000001, ... Each one is a
+FrameSegmentHeader followed by records (FrameRecordHeader + the frame as received, wrapper header included,
+padded to 8 bytes) and, once the segment was closed, a sparse time index of FrameIndexEntry after the records.
+
+Segments are written through a shared mapping and the header counters are updated after every record, so a
+capture cut off by a crash is readable up to the last complete frame; the index is then rebuilt by a scan.
+*/
+
+#define FRAME_CAPTURE_MAGIC "AXFRCAP1"
+/// one index entry per this many frames, a seek reads at most this many records after the binary search
+#define FRAME_CAPTURE_INDEX_INTERVAL 256
+
+struct FrameSegmentHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t frameCount;
+    /// bytes of records after the header
+    uint64_t dataBytes;
+    /// stamps of the first and the last frame, ns since the epoch
+    uint64_t firstStampNs;
+    uint64_t lastStampNs;
+    /// offset of the sparse index from the start of the file, 0 if the segment was not closed
+    uint64_t indexOffset;
+    uint64_t indexCount;
+};
+
+struct FrameRecordHeader
+{
+    uint64_t stampNs;
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct FrameIndexEntry
+{
+    uint64_t stampNs;
+    /// record offset from the start of the file
+    uint64_t offset;
+};
+
+/**
+Appends every frame a ParserManager validated to a capture, then hands it on to the next delegate unchanged.
+
+demo code:
+```
+FrameRecorder recorder(&router);
+recorder.open("/var/log/robot/capture");
+ParserManager manager(&recorder);
+router.attach(manager);
+```
+*/
+class FrameRecorder : public ParserManagerDelegate
+{
+public:
+    explicit FrameRecorder(ParserManagerDelegate* next = NULL, size_t segmentBytes = 64 * 1024 * 1024);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /// starts a new capture, segments of an earlier capture under the same path are deleted
+    bool open(const std::string& path);
+    /// writes the index of the open segment and truncates it to its size
+    void close();
+    bool isOpen() const { return m_map != NULL; }
+
+    /// false if nothing is open, the frame is larger than a segment, or the next segment could not be created (the
+    /// capture is closed then)
+    bool append(const uint8_t* pack, size_t bytes, ros::Time time);
+
+    void ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                   size_t bytes) override;
+
+    size_t frameCount() const { return m_frames; }
+    size_t segmentCount() const { return m_segment; }
+
+private:
+    bool openSegment();
+    void closeSegment();
+
+private:
+    ParserManagerDelegate* m_next;
+    size_t m_segmentBytes;
+    std::string m_path;
+    uint32_t m_segment = 0;
+    size_t m_frames = 0;
+
+    int m_fd = -1;
+    uint8_t* m_map = NULL;
+    size_t m_used = 0;
+    std::vector<FrameIndexEntry> m_index;
+};
+
+enum ReplayMode
+{
+    ReplayMode_fastest = 0,
+    ReplayMode_originalTiming = 1
+};
+
+/**
+Reads a capture written by FrameRecorder, every segment memory mapped read only.
+
+demo code:
+```
+FrameReplayer replayer;
+replayer.open("/var/log/robot/capture");
+replayer.seek(ros::Time(1701769169, 0));
+replayer.replay(manager, ReplayMode_fastest);
+```
+*/
+class FrameReplayer
+{
+public:
+    FrameReplayer() = default;
+    ~FrameReplayer();
+
+    FrameReplayer(const FrameReplayer&) = delete;
+    FrameReplayer& operator=(const FrameReplayer&) = delete;
+
+    /// maps <path>.000000 and the segments after it, false if there is none
+    bool open(const std::string& path);
+    void close();
+
+    size_t frameCount() const { return m_frameCount; }
+    size_t segmentCount() const { return m_segments.size(); }
+    uint64_t firstStampNs() const;
+    uint64_t lastStampNs() const;
+
+    /// positions at the first frame stamped at or after time, binary search over segments and their index
+    bool seek(ros::Time time);
+    /// positions at the first frame
+    void rewind();
+
+    /// the frame at the position, then advances. false at the end
+    bool next(const uint8_t** pack, size_t* bytes, ros::Time* time);
+
+    /**
+    Feeds frames from the position through manager.feed, one call per frame. ReplayMode_originalTiming keeps the
+    gaps between stamps, divided by speed. Returns the number of frames fed.
+    */
+    size_t replay(ParserManager& manager, ReplayMode mode, double speed = 1.0, size_t maxFrames = SIZE_MAX);
+
+private:
+    struct Segment
+    {
+        int fd = -1;
+        const uint8_t* map = NULL;
+        size_t size = 0;
+        const FrameSegmentHeader* header = NULL;
+        std::vector<FrameIndexEntry> index;
+    };
+
+    bool openSegment(const std::string& name, Segment& segment);
+
+private:
+    std::vector<Segment> m_segments;
+    size_t m_frameCount = 0;
+
+    size_t m_segment = 0;
+    size_t m_offset = 0; // record offset in the current segment
+};
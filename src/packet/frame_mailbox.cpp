@@ -0,0 +1,79 @@
+#include "packet/frame_mailbox.h"
+#include <string.h>
+
+#define FRAME_MAILBOX_HEADER_WORDS 2
+
+FrameMailbox::FrameMailbox(size_t maxFrameSize) : m_maxFrameSize(maxFrameSize)
+{
+    m_wordCount = FRAME_MAILBOX_HEADER_WORDS + (maxFrameSize + 7) / 8;
+    m_words.reset(new std::atomic<uint64_t>[m_wordCount]);
+    for (size_t i = 0; i < m_wordCount; i++)
+        m_words[i].store(0, std::memory_order_relaxed);
+}
+
+bool FrameMailbox::store(const uint8_t* pack, size_t bytes, ros::Time time)
+{
+    if (bytes > m_maxFrameSize)
+    {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // odd while writing, the fence keeps the words from being written before readers can see that
+    uint64_t seq = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    m_words[0].store(bytes, std::memory_order_relaxed);
+    m_words[1].store((uint64_t)time.sec << 32 | time.nsec, std::memory_order_relaxed);
+    std::atomic<uint64_t>* words = &m_words[FRAME_MAILBOX_HEADER_WORDS];
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, pack + i, 8);
+        words[i / 8].store(word, std::memory_order_relaxed);
+    }
+    if (i < bytes)
+    {
+        uint64_t word = 0;
+        memcpy(&word, pack + i, bytes - i);
+        words[i / 8].store(word, std::memory_order_relaxed);
+    }
+
+    m_seq.store(seq + 2, std::memory_order_release);
+    return true;
+}
+
+size_t FrameMailbox::load(uint8_t* buffer, ros::Time* time, uint64_t* seen) const
+{
+    const std::atomic<uint64_t>* words = &m_words[FRAME_MAILBOX_HEADER_WORDS];
+    while (true)
+    {
+        uint64_t before = m_seq.load(std::memory_order_acquire);
+        if (before == 0 || (seen != NULL && before / 2 <= *seen))
+            return 0;
+        if (before & 1)
+            continue; // the writer is in the middle of it, it does not wait for anything
+
+        size_t bytes = (size_t)m_words[0].load(std::memory_order_relaxed);
+        uint64_t stamp = m_words[1].load(std::memory_order_relaxed);
+        if (bytes > m_maxFrameSize)
+            continue; // torn, the sequence check below would catch it too
+        for (size_t i = 0; i < bytes; i += 8)
+        {
+            uint64_t word = words[i / 8].load(std::memory_order_relaxed);
+            memcpy(buffer + i, &word, bytes - i < 8 ? bytes - i : 8);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_seq.load(std::memory_order_relaxed) != before)
+            continue;
+
+        if (time != NULL)
+            *time = ros::Time((uint32_t)(stamp >> 32), (uint32_t)stamp);
+        if (seen != NULL)
+            *seen = before / 2;
+        return bytes;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "packet/tcp_pack.h"
+#include "ros/message_wrapper.h"
+
+/**
+Holds the newest frame of one message type, older ones are overwritten. For state streams where consumers only want
+the latest sample: storing is a copy of the raw frame, deserialization happens only when a consumer reads.
+
+Frames can be stored before their crc is checked (MsgPackParser with verifyCrc false): read() checks it, so of a
+burst only the frame that is actually read gets validated.
+
+One writer (the receiving thread), any number of readers. The slot is a seqlock: the writer bumps a sequence number
+to odd, copies, bumps it to even; readers copy without locking and retry if the sequence moved meanwhile, so neither
+side ever waits on the other.
+
+demo code:
+```
+MsgPackParser odomParser({Odom::magic_header[0], Odom::magic_header[1]}, false);
+FrameMailbox* odom = reader.addMailbox(&odomParser);
+
+// consumer, at its own pace
+Odom msg;
+uint64_t seen = 0;
+if (odom->read(msg, &seen))
+    ... // newer than the last read
+```
+*/
+class FrameMailbox
+{
+public:
+    /// larger frames are not stored, see rejected()
+    explicit FrameMailbox(size_t maxFrameSize = 256);
+
+    FrameMailbox(const FrameMailbox&) = delete;
+    FrameMailbox& operator=(const FrameMailbox&) = delete;
+
+    /// writer side, replaces the stored frame
+    bool store(const uint8_t* pack, size_t bytes, ros::Time time);
+
+    /**
+    Copies the newest frame into buffer (at least maxFrameSize() bytes). Returns its size, 0 if there is none yet
+    or, when seen is given, none newer than *seen; *seen is then set to the version that was read.
+    */
+    size_t load(uint8_t* buffer, ros::Time* time = NULL, uint64_t* seen = NULL) const;
+
+    /**
+    Checks the crc and deserializes the newest frame, same rules as load(). Endian is the byte order of the peer, the
+    one its MsgPackParser was created for. false also for a frame whose crc matches but whose payload does not
+    deserialize as MessageType.
+    */
+    template <typename MessageType, typename Endian = ros::serialization::LittleEndian>
+    bool read(MessageType& msg, uint64_t* seen = NULL, ros::Time* time = NULL, Endian = Endian()) const
+    {
+        static thread_local std::vector<uint8_t> local;
+        if (local.size() < m_maxFrameSize)
+            local.resize(m_maxFrameSize);
+
+        size_t bytes = load(&local[0], time, seen);
+        if (bytes < sizeof(MsgPack) || local[0] != (uint8_t)MessageType::magic_header[0]
+            || local[1] != (uint8_t)MessageType::magic_header[1])
+            return false;
+
+        uint32_t length = (uint32_t)(bytes - sizeof(MsgPack));
+        if (calculateCRC16(&local[sizeof(MsgPack)], length) != ax::read_wrapper_header<Endian>(&local[0]).crc16)
+            return false;
+        try
+        {
+            ros::serialization::IStream<Endian> stream(&local[sizeof(MsgPack)], length);
+            ros::serialization::deserialize(stream, msg);
+        }
+        catch (const ros::serialization::StreamOverrunException&)
+        {
+            return false;
+        }
+        return true;
+    }
+
+    size_t maxFrameSize() const { return m_maxFrameSize; }
+    /// number of frames stored so far, the version of the newest one
+    uint64_t version() const { return m_seq.load(std::memory_order_acquire) / 2; }
+    /// frames larger than maxFrameSize
+    size_t rejected() const { return m_rejected.load(std::memory_order_relaxed); }
+
+private:
+    size_t m_maxFrameSize;
+    // frame length, time and the frame as 8 byte words, relaxed atomics so concurrent copies are well defined
+    size_t m_wordCount;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+
+    alignas(64) std::atomic<uint64_t> m_seq{0};
+    std::atomic<size_t> m_rejected{0};
+};
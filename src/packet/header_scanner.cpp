@@ -0,0 +1,151 @@
+#include "packet/header_scanner.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+#endif
+
+HeaderScanner::HeaderScanner() : m_pairs(65536 / 64, 0)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    m_useAvx2 = __builtin_cpu_supports("avx2");
+#endif
+}
+
+size_t HeaderScanner::add(const std::vector<uint8_t>& header)
+{
+    size_t index = m_headers.size();
+    m_headers.push_back(header);
+    if (header.size() > m_maxLength)
+        m_maxLength = header.size();
+
+    if (header.empty())
+    {
+        m_hasEmpty = true;
+        return index;
+    }
+
+    uint8_t bucket = (uint8_t)(1 << (index % 8));
+    uint8_t b0 = header[0];
+    m_lo0[b0 & 0x0f] |= bucket;
+    m_hi0[b0 >> 4] |= bucket;
+
+    if (header.size() == 1)
+    {
+        m_singles[b0 >> 6] |= 1ull << (b0 & 63);
+        for (int b1 = 0; b1 < 256; b1++)
+            m_pairs[(b0 << 8 | b1) >> 6] |= 1ull << (b1 & 63);
+        for (int nibble = 0; nibble < 16; nibble++)
+        {
+            m_lo1[nibble] |= bucket;
+            m_hi1[nibble] |= bucket;
+        }
+    }
+    else
+    {
+        uint8_t b1 = header[1];
+        m_pairs[(b0 << 8 | b1) >> 6] |= 1ull << (b1 & 63);
+        m_lo1[b1 & 0x0f] |= bucket;
+        m_hi1[b1 >> 4] |= bucket;
+    }
+    return index;
+}
+
+bool HeaderScanner::find(const uint8_t* bytes, size_t n, size_t* pos, size_t* index) const
+{
+    if (m_headers.empty())
+        return false;
+
+    if (m_hasEmpty)
+    {
+        // an empty header matches right away, but an earlier registered one may match at 0 as well
+        *pos = 0;
+        return matchAt(bytes, n, 0, index);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    if (m_useAvx2)
+        return findAvx2(bytes, n, pos, index);
+#endif
+    return findScalar(bytes, n, 0, pos, index);
+}
+
+bool HeaderScanner::matchAt(const uint8_t* bytes, size_t n, size_t i, size_t* index) const
+{
+    for (size_t k = 0; k < m_headers.size(); k++)
+    {
+        const std::vector<uint8_t>& h = m_headers[k];
+        if (i + h.size() <= n && memcmp(bytes + i, h.data(), h.size()) == 0)
+        {
+            *index = k;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HeaderScanner::findScalar(const uint8_t* bytes, size_t n, size_t from, size_t* pos, size_t* index) const
+{
+    if (n == 0)
+        return false;
+
+    for (size_t i = from; i + 1 < n; i++)
+    {
+        uint32_t pair = (uint32_t)bytes[i] << 8 | bytes[i + 1];
+        if ((m_pairs[pair >> 6] >> (pair & 63) & 1) && matchAt(bytes, n, i, index))
+        {
+            *pos = i;
+            return true;
+        }
+    }
+
+    // only a 1-byte header fits at the last position
+    uint8_t last = bytes[n - 1];
+    if (n - 1 >= from && (m_singles[last >> 6] >> (last & 63) & 1) && matchAt(bytes, n, n - 1, index))
+    {
+        *pos = n - 1;
+        return true;
+    }
+    return false;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) bool HeaderScanner::findAvx2(const uint8_t* bytes, size_t n, size_t* pos,
+                                                             size_t* index) const
+{
+    const __m256i lo0 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m_lo0));
+    const __m256i hi0 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m_hi0));
+    const __m256i lo1 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m_lo1));
+    const __m256i hi1 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i*)m_hi1));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+
+    size_t i = 0;
+    // the second byte is read one position ahead, keep both loads inside the buffer
+    for (; i + 33 <= n; i += 32)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i*)(bytes + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i*)(bytes + i + 1));
+
+        __m256i m0 = _mm256_and_si256(_mm256_shuffle_epi8(lo0, _mm256_and_si256(v0, nibble)),
+                                      _mm256_shuffle_epi8(hi0, _mm256_and_si256(_mm256_srli_epi16(v0, 4), nibble)));
+        __m256i m1 = _mm256_and_si256(_mm256_shuffle_epi8(lo1, _mm256_and_si256(v1, nibble)),
+                                      _mm256_shuffle_epi8(hi1, _mm256_and_si256(_mm256_srli_epi16(v1, 4), nibble)));
+        uint32_t candidates = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(m0, m1), zero));
+
+        while (candidates != 0)
+        {
+            size_t c = i + __builtin_ctz(candidates);
+            candidates &= candidates - 1;
+
+            uint32_t pair = (uint32_t)bytes[c] << 8 | bytes[c + 1];
+            if ((m_pairs[pair >> 6] >> (pair & 63) & 1) && matchAt(bytes, n, c, index))
+            {
+                *pos = c;
+                return true;
+            }
+        }
+    }
+    return findScalar(bytes, n, i, pos, index);
+}
+#endif
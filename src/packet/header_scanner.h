@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/**
+Finds the earliest occurrence of any registered header in a single pass.
+
+Candidates are filtered on the first two header bytes: with AVX2 a nibble lookup (pshufb) tests 32 positions
+at once against all headers, otherwise a 64K bit pair table is tested per position. Candidates are verified
+against the full headers in registration order, so on a tie the header added first wins, just like the old
+per-parser std::search loop.
+*/
+class HeaderScanner
+{
+public:
+    HeaderScanner();
+
+    /// returns the index reported by find()
+    size_t add(const std::vector<uint8_t>& header);
+    size_t count() const { return m_headers.size(); }
+    size_t maxHeaderLength() const { return m_maxLength; }
+
+    /// true if a complete header starts inside bytes[0, n)
+    bool find(const uint8_t* bytes, size_t n, size_t* pos, size_t* index) const;
+
+private:
+    bool matchAt(const uint8_t* bytes, size_t n, size_t i, size_t* index) const;
+    bool findScalar(const uint8_t* bytes, size_t n, size_t from, size_t* pos, size_t* index) const;
+#if defined(__x86_64__) || defined(__i386__)
+    bool findAvx2(const uint8_t* bytes, size_t n, size_t* pos, size_t* index) const;
+#endif
+
+private:
+    std::vector<std::vector<uint8_t>> m_headers;
+    size_t m_maxLength = 0;
+    bool m_hasEmpty = false;
+    bool m_useAvx2 = false;
+
+    // bit (b0 << 8 | b1) is set if some header starts with b0 b1 (1-byte headers set all b1)
+    std::vector<uint64_t> m_pairs;
+    // bit b0 is set for 1-byte headers, they are the only ones that can match at the last position
+    uint64_t m_singles[4] = {0, 0, 0, 0};
+
+    // nibble tables for the SIMD filter, bit (index % 8) per header
+    alignas(16) uint8_t m_lo0[16] = {};
+    alignas(16) uint8_t m_hi0[16] = {};
+    alignas(16) uint8_t m_lo1[16] = {};
+    alignas(16) uint8_t m_hi1[16] = {};
+};
@@ -0,0 +1,102 @@
+#include "packet/message_router.h"
+#include "../shared/crc.h"
+
+namespace
+{
+ax::WrapperHeader readHeader(const uint8_t* pack, bool bigEndian)
+{
+    return bigEndian ? ax::read_wrapper_header<ros::serialization::BigEndian>(pack)
+                     : ax::read_wrapper_header<ros::serialization::LittleEndian>(pack);
+}
+} // namespace
+
+MessageRouter::MessageRouter(bool bigEndian) : m_table(65536, 0), m_bigEndian(bigEndian) {}
+
+bool MessageRouter::addRoute(Route* route)
+{
+    std::unique_ptr<Route> owned(route);
+    uint16_t magic = route->magic();
+    uint8_t& entry = m_table[magic];
+    if (entry != 0)
+    {
+        // the route being replaced may be the one whose handler is running
+        if (m_dispatching > 0)
+            m_retired.push_back(std::move(m_routes[entry - 1]));
+        m_routes[entry - 1] = std::move(owned);
+        return true;
+    }
+
+    // indices are stored in one byte to keep the table at 64 KB
+    if (m_routes.size() >= 255)
+        return false;
+    m_routes.push_back(std::move(owned));
+    m_parsers.emplace_back(new MsgPackParser({(uint8_t)(magic >> 8), (uint8_t)magic}, true, m_bigEndian));
+    entry = (uint8_t)m_routes.size();
+    return true;
+}
+
+void MessageRouter::attach(ParserManager& manager)
+{
+    for (auto& parser : m_parsers)
+        manager.addParser(parser.get());
+}
+
+bool MessageRouter::route(const uint8_t* pack, size_t bytes, ros::Time time)
+{
+    if (bytes < sizeof(MsgPack) || m_table[pack[0] << 8 | pack[1]] == 0)
+    {
+        m_dropped++;
+        return false;
+    }
+
+    ax::WrapperHeader header = readHeader(pack, m_bigEndian);
+    if (bytes < sizeof(MsgPack) + (size_t)header.data_length
+        || calculateCRC16(pack + sizeof(MsgPack), header.data_length) != header.crc16)
+    {
+        m_dropped++;
+        return false;
+    }
+
+    size_t before = m_dropped;
+    dispatch(pack, time);
+    return m_dropped == before;
+}
+
+void MessageRouter::ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time time, const uint8_t* pack,
+                                              size_t)
+{
+    // MsgPackParser checked length and crc, the size it reported is header + length
+    dispatch(pack, time);
+}
+
+void MessageRouter::dispatch(const uint8_t* pack, ros::Time time)
+{
+    uint8_t index = m_table[pack[0] << 8 | pack[1]];
+    if (index == 0)
+    {
+        m_dropped++;
+        return;
+    }
+
+    uint32_t length = readHeader(pack, m_bigEndian).data_length;
+    m_dispatching++;
+    bool dispatched = false;
+    try
+    {
+        dispatched = m_routes[index - 1]->dispatch((uint8_t*)pack + sizeof(MsgPack), length, time, m_bigEndian);
+    }
+    catch (...)
+    {
+        retire();
+        throw;
+    }
+    retire();
+    if (!dispatched)
+        m_dropped++;
+}
+
+void MessageRouter::retire()
+{
+    if (--m_dispatching == 0)
+        m_retired.clear();
+}
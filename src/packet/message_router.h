@@ -0,0 +1,140 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "packet/packet_parser.h"
+#include "packet/tcp_pack.h"
+#include "ros/message_wrapper.h"
+
+/**
+Dispatches wrapped messages to typed handlers through a 65536 entry table indexed by the 2 byte magic header.
+
+Frames are validated once: packets coming from a ParserManager were already checked by MsgPackParser (length and
+crc) and are deserialized right away, route() checks a raw frame itself. Each message type keeps one message object
+that is reused for every packet, the handler gets it by reference and must copy what it wants to keep.
+
+A router reads one byte order, little endian unless it is constructed with another one: frames of a big endian peer
+go through MessageRouter router{ros::serialization::BigEndian()}, whose parsers are created for that order as well.
+
+demo code:
+```
+MessageRouter router;
+router.add<Odom>([](const Odom& odom, ros::Time time) { ... });
+router.add<DeviceState>([](const DeviceState& state, ros::Time time) { ... });
+
+Connection* c = loop.add(stream, &router);
+router.attach(c->parser());
+```
+*/
+class MessageRouter : public ParserManagerDelegate
+{
+public:
+    /// Endian is the byte order of the peer, see to_buffer
+    template <typename Endian = ros::serialization::LittleEndian>
+    explicit MessageRouter(Endian = Endian()) : MessageRouter(!Endian::little)
+    {
+    }
+
+    MessageRouter(const MessageRouter&) = delete;
+    MessageRouter& operator=(const MessageRouter&) = delete;
+
+    /**
+    handler is called as handler(const MessageType&, ros::Time). A second add for the same magic replaces only the
+    handler, the parser a ParserManager may already hold stays. A handler may replace itself, the old one is destroyed
+    once dispatch returns. false once 255 magics are registered
+    */
+    template <typename MessageType, typename Handler>
+    bool add(Handler handler)
+    {
+        return addRoute(new TypedRoute<MessageType, Handler>(handler));
+    }
+
+    /// adds one MsgPackParser per registered type, the manager must have been created with this router as delegate
+    void attach(ParserManager& manager);
+
+    /// checks magic, length and crc of a complete frame, then dispatches it. false if it was dropped
+    bool route(const uint8_t* pack, size_t bytes, ros::Time time);
+
+    /// a complete frame that was validated elsewhere, e.g. one popped from a ReaderThread channel
+    void dispatch(const uint8_t* pack, ros::Time time);
+
+    /// packets the manager found, already validated
+    void ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                   size_t bytes) override;
+
+    /// frames that had no handler, failed validation or did not deserialize
+    size_t droppedCount() const { return m_dropped; }
+
+private:
+    class Route
+    {
+    public:
+        Route(const char magic[2]) : m_magic((uint16_t)((uint8_t)magic[0] << 8 | (uint8_t)magic[1])) {}
+        virtual ~Route() {}
+
+        uint16_t magic() const { return m_magic; }
+
+        /// payload is the serialized message without the wrapper header
+        virtual bool dispatch(uint8_t* payload, uint32_t length, ros::Time time, bool bigEndian) = 0;
+
+    private:
+        uint16_t m_magic;
+    };
+
+    template <typename MessageType, typename Handler>
+    class TypedRoute : public Route
+    {
+    public:
+        TypedRoute(Handler handler) : Route(MessageType::magic_header), m_handler(handler) {}
+
+        bool dispatch(uint8_t* payload, uint32_t length, ros::Time time, bool bigEndian) override
+        {
+            // a fixed size message has exactly one valid length, anything else is not worth deserializing
+            if (ros::message_traits::IsFixedSize<MessageType>::value
+                && length != ros::serialization::serializationLength(m_msg))
+                return false;
+
+            try
+            {
+                if (bigEndian)
+                    deserialize<ros::serialization::BigEndian>(payload, length);
+                else
+                    deserialize<ros::serialization::LittleEndian>(payload, length);
+            }
+            catch (const ros::serialization::StreamOverrunException&)
+            {
+                return false;
+            }
+            pipelineMark(PipelineStage_deserialized);
+            m_handler((const MessageType&)m_msg, time);
+            return true;
+        }
+
+    private:
+        template <typename Endian>
+        void deserialize(uint8_t* payload, uint32_t length)
+        {
+            ros::serialization::IStream<Endian> stream(payload, length);
+            ros::serialization::deserialize(stream, m_msg);
+        }
+
+        Handler m_handler;
+        MessageType m_msg;
+    };
+
+    explicit MessageRouter(bool bigEndian);
+    bool addRoute(Route* route);
+    /// ends one dispatch, the outermost frees the routes replaced meanwhile
+    void retire();
+
+private:
+    std::vector<std::unique_ptr<Route>> m_routes;
+    // one per route, kept apart so that replacing a handler never frees a parser an attached manager points to
+    std::vector<std::unique_ptr<MsgPackParser>> m_parsers;
+    // routes replaced while a handler runs, freed when the outermost dispatch returns
+    std::vector<std::unique_ptr<Route>> m_retired;
+    int m_dispatching = 0;
+    // m_routes index + 1 per magic, 0 if nothing is registered
+    std::vector<uint8_t> m_table;
+    bool m_bigEndian;
+    size_t m_dropped = 0;
+};
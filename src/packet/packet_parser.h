@@ -5,6 +5,11 @@
 #include <vector>
 #include <climits>
 #include "ros/time.h"
+#include "ros/message_arena.h"
+#include "packet/ring_buffer.h"
+#include "packet/header_scanner.h"
+#include "packet/pipeline_metrics.h"
+#include "shared/clock.h"
 
 #define UART_BUFFER_MAX_SIZE 1024 * 1024
 
@@ -67,80 +72,198 @@ public:
 class ParserManager
 {
 public:
-    ParserManager(ParserManagerDelegate* d) { m_delegate = d; }
+    /// prefault: see RingBuffer
+    ParserManager(ParserManagerDelegate* d, size_t bufferSize = UART_BUFFER_MAX_SIZE, bool prefault = false)
+        : m_buffer(bufferSize, prefault)
+    {
+        m_delegate = d;
+    }
 
-    void addParser(Parser* parser) { m_parsers.push_back(parser); }
+    void addParser(Parser* parser)
+    {
+        m_parsers.push_back(parser);
+        m_scanner.add(parser->header());
+        if (m_metrics != NULL)
+            m_metricTypes.push_back(m_metrics->addType(parser->header(), m_recorder));
+    }
     void addParsersFromAnotherManager(const ParserManager& r)
     {
-        m_parsers.insert(m_parsers.end(), r.m_parsers.begin(), r.m_parsers.end());
+        for (auto parser : r.m_parsers)
+            addParser(parser);
+    }
+
+    /// the arena is reset after every packetFound callback, messages the delegate built from it must not outlive it
+    void setArena(ros::MessageArena* arena) { m_arena = arena; }
+
+    /// times every frame into metrics (NULL turns it off again), one histogram set per parser header. The manager
+    /// records into its own PipelineRecorder, setMetrics() is not meant to be called over and over
+    void setMetrics(PipelineMetrics* metrics)
+    {
+        m_metrics = metrics;
+        m_recorder = metrics != NULL ? metrics->addRecorder() : NULL;
+        m_metricTypes.clear();
+        if (m_metrics != NULL)
+        {
+            for (auto parser : m_parsers)
+                m_metricTypes.push_back(m_metrics->addType(parser->header(), m_recorder));
+        }
+    }
+
+    /// drops buffered bytes and a half parsed frame, for example when the stream they came from reconnected
+    void reset()
+    {
+        m_buffer.clear();
+        m_currentParser = NULL;
     }
 
+    /// frames are stamped with the time the bytes their header is in were fed, one clock read per call
     void feed(const uint8_t* bytes, size_t n)
     {
-        m_buffer.insert(m_buffer.end(), bytes, bytes + n);
+        m_feedNs = clockNowNs();
+        if (m_metrics != NULL)
+        {
+            m_feedTicks = tscRead();
+            m_metrics->countBytes(n);
+        }
+
+        while (n > 0)
+        {
+            size_t taken = m_buffer.append(bytes, n);
+            bytes += taken;
+            n -= taken;
+
+            parse();
 
+            // nothing could be consumed from a full buffer, the pending packet will never fit
+            if (m_buffer.space() == 0)
+            {
+                if (m_metrics != NULL)
+                {
+                    m_metrics->countGarbage(m_buffer.size());
+                    m_metrics->countResync();
+                }
+                m_buffer.clear();
+                m_currentParser = NULL;
+            }
+        }
+    }
+
+private:
+    void parse()
+    {
         while (true)
         {
             if (m_currentParser == NULL)
             {
-                // find header to determine parser
-                int minPos = INT_MAX;
-                for (auto parser : m_parsers)
+                // find the earliest header of any parser in one pass
+                size_t pos = 0, index = 0;
+                if (!m_scanner.find(m_buffer.data(), m_buffer.size(), &pos, &index))
                 {
-                    int pos = findHeader(parser, &m_buffer[0], m_buffer.size());
-                    if (pos != -1)
+                    // no header starts in what we have, keep only a possible partial header at the end
+                    size_t keep = m_scanner.maxHeaderLength() > 0 ? m_scanner.maxHeaderLength() - 1 : 0;
+                    if (m_buffer.size() > keep)
                     {
-                        if (pos < minPos)
-                        {
-                            m_time = ros::Time::now();
-                            minPos = pos;
-                            m_currentParser = parser;
-                        }
+                        if (m_metrics != NULL)
+                            m_metrics->countGarbage(m_buffer.size() - keep);
+                        m_buffer.consume(m_buffer.size() - keep);
                     }
+                    return;
                 }
 
-                if (minPos != INT_MAX) // found
-                    m_buffer.erase(m_buffer.begin(), m_buffer.begin() + minPos);
-                else
-                    return;
+                m_frameNs = m_feedNs;
+                m_currentParser = m_parsers[index];
+                m_buffer.consume(pos);
+                if (m_metrics != NULL)
+                    headerFound(index, pos);
             }
 
             if (m_currentParser != NULL)
             {
+                // the parser and the delegate find the frame being timed through pipelineTrace()
+                PipelineTrace* outerTrace = NULL;
+                if (m_metrics != NULL)
+                {
+                    outerTrace = pipeline_detail::g_trace;
+                    pipeline_detail::g_trace = &m_trace;
+                }
+
                 size_t bytesUsed = 0;
-                ParserResult result = m_currentParser->feed(&m_buffer[0], m_buffer.size(), &bytesUsed);
+                ParserResult result = m_currentParser->feed(m_buffer.data(), m_buffer.size(), &bytesUsed);
+                if (result == ParserResult_succ)
+                {
+                    if (m_metrics != NULL)
+                        parsed();
+                    m_delegate->ParserManager_packetFound(m_currentParser->header(), clockToRosTime(m_frameNs),
+                                                          m_buffer.data(), bytesUsed);
+                    if (m_metrics != NULL)
+                        callbackReturned();
+                    if (m_arena != NULL)
+                        m_arena->reset();
+                }
+                if (m_metrics != NULL)
+                    pipeline_detail::g_trace = outerTrace;
+
                 if (result == ParserResult_incomplete)
                     return;
-                else if (result == ParserResult_succ)
-                    m_delegate->ParserManager_packetFound(m_currentParser->header(), m_time, &m_buffer[0], bytesUsed);
+                if (result == ParserResult_failed)
+                {
+                    if (bytesUsed == 0)
+                        bytesUsed = 1; // skip the bad header, otherwise it is found again right away
+                    if (m_metrics != NULL)
+                    {
+                        m_metrics->countGarbage(bytesUsed);
+                        m_metrics->countResync();
+                    }
+                }
 
-                m_buffer.erase(m_buffer.begin(), m_buffer.begin() + bytesUsed);
+                m_buffer.consume(bytesUsed);
                 m_currentParser = NULL;
             }
         }
+    }
 
-        if (m_buffer.size() > UART_BUFFER_MAX_SIZE)
-            m_buffer.clear();
+    void headerFound(size_t index, size_t skipped)
+    {
+        m_headerTicks = tscRead();
+        m_frameFeedTicks = m_feedTicks;
+        m_trace.recorder = m_recorder;
+        m_trace.type = m_metricTypes[index];
+        m_recorder->record(m_trace.type, PipelineStage_headerFound, m_headerTicks - m_feedTicks);
+        if (skipped > 0)
+        {
+            m_metrics->countGarbage(skipped);
+            m_metrics->countResync();
+        }
     }
 
-private:
-    int findHeader(Parser* parser, const uint8_t* bytes, size_t n)
+    void parsed()
     {
-        if (n < parser->header().size())
-            return -1;
+        m_trace.parsedTicks = tscRead();
+        m_recorder->record(m_trace.type, PipelineStage_parsed, m_trace.parsedTicks - m_headerTicks);
+    }
 
-        const uint8_t* h = parser->header().data();
-        const uint8_t* pos = std::search(bytes, bytes + n, h, h + parser->header().size());
-        if (pos == bytes + n)
-            return -1;
-        else
-            return (int)(pos - bytes);
+    void callbackReturned()
+    {
+        uint64_t now = tscRead();
+        m_recorder->record(m_trace.type, PipelineStage_callback, now - m_trace.parsedTicks);
+        m_recorder->record(m_trace.type, PipelineStage_total, now - m_frameFeedTicks);
     }
 
 private:
     ParserManagerDelegate* m_delegate;
     Parser* m_currentParser = NULL;
     std::vector<Parser*> m_parsers;
-    std::vector<uint8_t> m_buffer;
-    ros::Time m_time;
+    HeaderScanner m_scanner;
+    RingBuffer m_buffer;
+    int64_t m_feedNs = 0;
+    int64_t m_frameNs = 0; // m_feedNs of the bytes the current header was found in
+    ros::MessageArena* m_arena = NULL;
+
+    PipelineMetrics* m_metrics = NULL;
+    PipelineRecorder* m_recorder = NULL; // this manager's histograms in m_metrics
+    std::vector<size_t> m_metricTypes; // PipelineMetrics type per parser
+    PipelineTrace m_trace;
+    uint64_t m_feedTicks = 0;      // when the bytes being parsed were handed to feed()
+    uint64_t m_frameFeedTicks = 0; // m_feedTicks of the bytes the current header was found in
+    uint64_t m_headerTicks = 0;
 };
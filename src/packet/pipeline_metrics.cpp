@@ -0,0 +1,283 @@
+#include "packet/pipeline_metrics.h"
+#include <algorithm>
+#include <chrono>
+
+HdrHistogram::HdrHistogram() : m_counts(new std::atomic<uint64_t>[kBucketCount])
+{
+    for (size_t i = 0; i < kBucketCount; i++)
+        m_counts[i].store(0, std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::bucketUpperBound(size_t index)
+{
+    if (index < 2 * kSubBuckets)
+        return index;
+    size_t group = (index - 2 * kSubBuckets) / kSubBuckets;
+    size_t sub = (index - 2 * kSubBuckets) % kSubBuckets;
+    size_t shift = group + 1; // exponent - kSubBucketBits
+    return ((uint64_t)(kSubBuckets + sub) << shift) + (((uint64_t)1 << shift) - 1);
+}
+
+void HdrHistogram::add(const HdrHistogram& other)
+{
+    for (size_t i = 0; i < kBucketCount; i++)
+    {
+        uint64_t c = other.m_counts[i].load(std::memory_order_relaxed);
+        if (c != 0)
+            m_counts[i].fetch_add(c, std::memory_order_relaxed);
+    }
+    uint64_t max = other.max();
+    if (max > m_max.load(std::memory_order_relaxed))
+        m_max.store(max, std::memory_order_relaxed);
+}
+
+uint64_t HdrHistogram::count() const
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; i++)
+        total += m_counts[i].load(std::memory_order_relaxed);
+    return total;
+}
+
+double HdrHistogram::mean() const
+{
+    uint64_t n = 0;
+    double sum = 0;
+    for (size_t i = 0; i < kBucketCount; i++)
+    {
+        uint64_t c = m_counts[i].load(std::memory_order_relaxed);
+        if (c == 0)
+            continue;
+        uint64_t lower = i > 0 ? bucketUpperBound(i - 1) + 1 : 0;
+        n += c;
+        sum += c * ((double)lower + (double)bucketUpperBound(i)) / 2;
+    }
+    return n > 0 ? sum / n : 0;
+}
+
+uint64_t HdrHistogram::valueAtPercentile(double percentile) const
+{
+    uint64_t n = count();
+    if (n == 0)
+        return 0;
+    uint64_t rank = (uint64_t)(percentile / 100.0 * n + 0.5);
+    if (rank < 1)
+        rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++)
+    {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(bucketUpperBound(i), max());
+    }
+    return max();
+}
+
+void HdrHistogram::reset()
+{
+    for (size_t i = 0; i < kBucketCount; i++)
+        m_counts[i].store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+const char* pipelineStageName(PipelineStage stage)
+{
+    switch (stage)
+    {
+    case PipelineStage_headerFound:
+        return "header found";
+    case PipelineStage_parsed:
+        return "parsed";
+    case PipelineStage_crc:
+        return "crc";
+    case PipelineStage_deserialized:
+        return "deserialized";
+    case PipelineStage_callback:
+        return "callback";
+    case PipelineStage_total:
+        return "total";
+    default:
+        return "?";
+    }
+}
+
+void PipelineSnapshot::print(FILE* out) const
+{
+    fprintf(out, "pipeline %.1f s: %.3f MB/s, %.0f frames/s, crc failures %llu, garbage %llu bytes, resyncs %llu\n",
+            seconds, bytesPerSecond() / 1e6, framesPerSecond(), (unsigned long long)crcFailures,
+            (unsigned long long)garbageBytes, (unsigned long long)resyncs);
+    for (const Type& type : types)
+    {
+        for (int s = 0; s < PipelineStage_count; s++)
+        {
+            const PipelineStageStats& stats = type.stages[s];
+            if (stats.count == 0)
+                continue;
+            fprintf(out,
+                    "  %-16s %-13s n=%-9llu mean=%.0fns p50=%.0fns p90=%.0fns p99=%.0fns p99.9=%.0fns "
+                    "max=%.0fns\n",
+                    type.name.c_str(), pipelineStageName((PipelineStage)s), (unsigned long long)stats.count,
+                    stats.meanNs, stats.p50Ns, stats.p90Ns, stats.p99Ns, stats.p999Ns, stats.maxNs);
+        }
+    }
+    fflush(out);
+}
+
+namespace
+{
+// printable headers as text, others in hex
+std::string headerName(const std::vector<uint8_t>& header)
+{
+    bool printable = !header.empty();
+    for (uint8_t b : header)
+        printable = printable && b >= 0x20 && b < 0x7f;
+    if (printable)
+        return std::string(header.begin(), header.end());
+
+    std::string name = "0x";
+    char hex[3];
+    for (uint8_t b : header)
+    {
+        snprintf(hex, sizeof(hex), "%02x", b);
+        name += hex;
+    }
+    return name;
+}
+} // namespace
+
+PipelineMetrics::PipelineMetrics() : m_startTicks(tscRead())
+{
+    m_types[0].reset(new TypeMetrics());
+    m_types[0]->name = "other";
+    m_typeCount.store(1, std::memory_order_release);
+}
+
+size_t PipelineMetrics::addType(const std::vector<uint8_t>& header, PipelineRecorder* recorder)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_typeCount.load(std::memory_order_relaxed);
+    size_t type = 0;
+    for (size_t i = 1; i < count && type == 0; i++)
+    {
+        if (m_types[i]->header == header)
+            type = i;
+    }
+    if (type == 0 && count < PIPELINE_METRICS_MAX_TYPES)
+    {
+        m_types[count].reset(new TypeMetrics());
+        m_types[count]->header = header;
+        m_types[count]->name = headerName(header);
+        m_typeCount.store(count + 1, std::memory_order_release);
+        type = count;
+    }
+
+    if (recorder != NULL && recorder->m_types[type] == nullptr)
+        recorder->m_types[type].reset(new HdrHistogram[PipelineStage_count]);
+    return type;
+}
+
+PipelineRecorder* PipelineMetrics::addRecorder()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_recorders.emplace_back(new PipelineRecorder(*this));
+    return m_recorders.back().get();
+}
+
+PipelineSnapshot PipelineMetrics::snapshot() const
+{
+    double nanosPerTick = tscNanosPerTick();
+
+    PipelineSnapshot snapshot;
+    snapshot.seconds = (tscRead() - m_startTicks.load(std::memory_order_relaxed)) * nanosPerTick * 1e-9;
+    snapshot.bytes = m_bytes.load(std::memory_order_relaxed);
+    snapshot.crcFailures = m_crcFailures.load(std::memory_order_relaxed);
+    snapshot.garbageBytes = m_garbageBytes.load(std::memory_order_relaxed);
+    snapshot.resyncs = m_resyncs.load(std::memory_order_relaxed);
+
+    // the recorders' histograms are merged into the shared ones of their type
+    std::lock_guard<std::mutex> lock(m_mutex);
+    HdrHistogram histogram;
+    size_t count = m_typeCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        const TypeMetrics& metrics = *m_types[i];
+        PipelineSnapshot::Type type;
+        type.name = metrics.name;
+        bool used = false;
+        for (int s = 0; s < PipelineStage_count; s++)
+        {
+            histogram.reset();
+            histogram.add(metrics.stages[s]);
+            for (auto& recorder : m_recorders)
+            {
+                if (recorder->m_types[i] != nullptr)
+                    histogram.add(recorder->m_types[i][s]);
+            }
+            PipelineStageStats& stats = type.stages[s];
+            stats.count = histogram.count();
+            if (stats.count == 0)
+                continue;
+            if (s == PipelineStage_total)
+                snapshot.frames += stats.count;
+            used = true;
+            stats.meanNs = histogram.mean() * nanosPerTick;
+            stats.p50Ns = histogram.valueAtPercentile(50) * nanosPerTick;
+            stats.p90Ns = histogram.valueAtPercentile(90) * nanosPerTick;
+            stats.p99Ns = histogram.valueAtPercentile(99) * nanosPerTick;
+            stats.p999Ns = histogram.valueAtPercentile(99.9) * nanosPerTick;
+            stats.maxNs = histogram.max() * nanosPerTick;
+        }
+        if (used || i > 0)
+            snapshot.types.push_back(type);
+    }
+    return snapshot;
+}
+
+void PipelineMetrics::reset()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = m_typeCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (auto& histogram : m_types[i]->stages)
+            histogram.reset();
+        for (auto& recorder : m_recorders)
+        {
+            if (recorder->m_types[i] != nullptr)
+            {
+                for (int s = 0; s < PipelineStage_count; s++)
+                    recorder->m_types[i][s].reset();
+            }
+        }
+    }
+    m_bytes.store(0, std::memory_order_relaxed);
+    m_crcFailures.store(0, std::memory_order_relaxed);
+    m_garbageBytes.store(0, std::memory_order_relaxed);
+    m_resyncs.store(0, std::memory_order_relaxed);
+    m_startTicks.store(tscRead(), std::memory_order_relaxed);
+}
+
+PipelineMetricsDumper::PipelineMetricsDumper(const PipelineMetrics& metrics, double intervalSeconds, FILE* out)
+    : m_metrics(metrics), m_intervalSeconds(intervalSeconds), m_out(out)
+{
+    m_thread = std::thread(&PipelineMetricsDumper::run, this);
+}
+
+PipelineMetricsDumper::~PipelineMetricsDumper()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+void PipelineMetricsDumper::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto interval = std::chrono::duration<double>(m_intervalSeconds);
+    while (!m_cond.wait_for(lock, interval, [this]() { return m_stop; }))
+        m_metrics.snapshot().print(m_out);
+}
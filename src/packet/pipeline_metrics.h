@@ -0,0 +1,266 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shared/tsc.h"
+
+#define PIPELINE_METRICS_MAX_TYPES 32
+
+/**
+Log-linear histogram over the whole uint64 range with about 3 % resolution (32 sub buckets per power of two,
+exact below 64), like HdrHistogram with 1.5 significant digits. record() is one relaxed fetch_add, so any number
+of threads can record while another one reads. A histogram that only one thread records into can use
+recordSingleWriter(), plain loads and stores that readers on other threads still see.
+*/
+class HdrHistogram
+{
+public:
+    static const size_t kSubBucketBits = 5;
+    static const size_t kSubBuckets = 1 << kSubBucketBits;
+    static const size_t kBucketCount = 2 * kSubBuckets + (64 - kSubBucketBits - 1) * kSubBuckets;
+
+    HdrHistogram();
+
+    void record(uint64_t value)
+    {
+        m_counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    void recordSingleWriter(uint64_t value)
+    {
+        std::atomic<uint64_t>& count = m_counts[bucketIndex(value)];
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (value > m_max.load(std::memory_order_relaxed))
+            m_max.store(value, std::memory_order_relaxed);
+    }
+
+    /// adds the counts of other, to merge histograms recorded on different threads
+    void add(const HdrHistogram& other);
+
+    uint64_t count() const;
+    uint64_t max() const { return m_max.load(std::memory_order_relaxed); }
+    /// from the bucket midpoints, as exact as the percentiles
+    double mean() const;
+    /// highest value of the bucket the percentile (0..100) falls into, never above max()
+    uint64_t valueAtPercentile(double percentile) const;
+    void reset();
+
+    static size_t bucketIndex(uint64_t value)
+    {
+        if (value < 2 * kSubBuckets)
+            return (size_t)value;
+        size_t exponent = 63 - __builtin_clzll(value);
+        size_t sub = (size_t)(value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+        return 2 * kSubBuckets + (exponent - kSubBucketBits - 1) * kSubBuckets + sub;
+    }
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+    std::atomic<uint64_t> m_max{0};
+};
+
+/// receive pipeline stages, each one timed per frame
+enum PipelineStage
+{
+    PipelineStage_headerFound = 0,  // bytes handed to ParserManager::feed -> header found
+    PipelineStage_parsed = 1,       // header found -> parser reported the frame complete, crc included
+    PipelineStage_crc = 2,          // the crc check alone, inside MsgPackParser
+    PipelineStage_deserialized = 3, // parser complete -> message deserialized, recorded by MessageRouter
+    PipelineStage_callback = 4,     // parser complete -> packetFound callback returned
+    PipelineStage_total = 5,        // bytes handed to feed -> callback returned
+    PipelineStage_count
+};
+
+const char* pipelineStageName(PipelineStage stage);
+
+struct PipelineStageStats
+{
+    uint64_t count = 0;
+    double meanNs = 0;
+    double p50Ns = 0;
+    double p90Ns = 0;
+    double p99Ns = 0;
+    double p999Ns = 0;
+    double maxNs = 0;
+};
+
+struct PipelineSnapshot
+{
+    struct Type
+    {
+        std::string name;
+        PipelineStageStats stages[PipelineStage_count];
+    };
+
+    /// since the metrics were created or reset
+    double seconds = 0;
+    uint64_t bytes = 0;
+    /// frames delivered to the delegate, the count of the total stage over all types
+    uint64_t frames = 0;
+    uint64_t crcFailures = 0;
+    /// bytes dropped outside of a valid frame, and the times the parser had to search for the next header
+    uint64_t garbageBytes = 0;
+    uint64_t resyncs = 0;
+    std::vector<Type> types;
+
+    double bytesPerSecond() const { return seconds > 0 ? bytes / seconds : 0; }
+    double framesPerSecond() const { return seconds > 0 ? frames / seconds : 0; }
+    void print(FILE* out) const;
+};
+
+class PipelineMetrics;
+
+/**
+The histograms one ParserManager records into. Only the thread feeding that manager writes them, so recording is a
+plain load and store per bucket instead of atomic read-modify-writes on histograms shared with other managers.
+Created and owned by PipelineMetrics, snapshot() merges them.
+*/
+class PipelineRecorder
+{
+public:
+    explicit PipelineRecorder(PipelineMetrics& metrics) : m_metrics(metrics) {}
+
+    PipelineRecorder(const PipelineRecorder&) = delete;
+    PipelineRecorder& operator=(const PipelineRecorder&) = delete;
+
+    PipelineMetrics& metrics() { return m_metrics; }
+    /// type must have been added through PipelineMetrics::addType with this recorder
+    void record(size_t type, PipelineStage stage, uint64_t ticks)
+    {
+        m_types[type][stage].recordSingleWriter(ticks);
+    }
+
+private:
+    friend class PipelineMetrics;
+
+    PipelineMetrics& m_metrics;
+    // PipelineStage_count histograms per type, allocated for the types the manager has
+    std::unique_ptr<HdrHistogram[]> m_types[PIPELINE_METRICS_MAX_TYPES];
+};
+
+/**
+Always-on timing of the receive pipeline: per message type an HdrHistogram per PipelineStage, in tsc ticks, plus
+byte, frame, crc failure and garbage counters. Recording is lock free, one or more ParserManagers can feed the same
+metrics from different threads while snapshot() is taken from another one. Each ParserManager records into its
+own PipelineRecorder, record() is for anything else.
+
+demo code:
+```
+PipelineMetrics metrics;
+connection->parser().setMetrics(&metrics); // after the parsers were added
+PipelineMetricsDumper dumper(metrics, 10); // optional, prints a snapshot every 10 s
+...
+PipelineSnapshot snapshot = metrics.snapshot();
+```
+*/
+class PipelineMetrics
+{
+public:
+    PipelineMetrics();
+
+    PipelineMetrics(const PipelineMetrics&) = delete;
+    PipelineMetrics& operator=(const PipelineMetrics&) = delete;
+
+    /// returns the index for a parser header, the same one for a header added before. Type 0 takes everything
+    /// beyond PIPELINE_METRICS_MAX_TYPES. recorder gets histograms for the type. Not meant for the hot path, it takes
+    /// a lock.
+    size_t addType(const std::vector<uint8_t>& header, PipelineRecorder* recorder = NULL);
+    /// histograms for a single recording thread, they live as long as the metrics
+    PipelineRecorder* addRecorder();
+
+    /// from any thread
+    void record(size_t type, PipelineStage stage, uint64_t ticks) { m_types[type]->stages[stage].record(ticks); }
+    void countBytes(size_t n) { m_bytes.fetch_add(n, std::memory_order_relaxed); }
+    void countCrcFailure() { m_crcFailures.fetch_add(1, std::memory_order_relaxed); }
+    void countGarbage(size_t n) { m_garbageBytes.fetch_add(n, std::memory_order_relaxed); }
+    void countResync() { m_resyncs.fetch_add(1, std::memory_order_relaxed); }
+
+    PipelineSnapshot snapshot() const;
+    /// clears histograms and counters, records that race with it may land on either side and a single writer
+    /// recording into the bucket being cleared may put back its old count
+    void reset();
+
+private:
+    struct TypeMetrics
+    {
+        std::vector<uint8_t> header;
+        std::string name;
+        HdrHistogram stages[PipelineStage_count];
+    };
+
+    mutable std::mutex m_mutex;
+    std::unique_ptr<TypeMetrics> m_types[PIPELINE_METRICS_MAX_TYPES];
+    std::vector<std::unique_ptr<PipelineRecorder>> m_recorders;
+    std::atomic<size_t> m_typeCount{0};
+    std::atomic<uint64_t> m_startTicks;
+
+    alignas(64) std::atomic<uint64_t> m_bytes{0};
+    std::atomic<uint64_t> m_crcFailures{0};
+    std::atomic<uint64_t> m_garbageBytes{0};
+    std::atomic<uint64_t> m_resyncs{0};
+};
+
+/**
+The frame an instrumented ParserManager is working on, visible to code it calls on the same thread (the parser
+checking the crc, the delegate deserializing) without threading a context through the Parser and delegate
+interfaces. NULL when the calling ParserManager has no metrics.
+*/
+struct PipelineTrace
+{
+    PipelineRecorder* recorder = NULL;
+    size_t type = 0;
+    uint64_t parsedTicks = 0;
+};
+
+namespace pipeline_detail
+{
+inline thread_local PipelineTrace* g_trace = NULL;
+}
+
+inline PipelineTrace* pipelineTrace()
+{
+    return pipeline_detail::g_trace;
+}
+
+/// records the time since the current frame was parsed under stage, nothing outside an instrumented ParserManager
+inline void pipelineMark(PipelineStage stage)
+{
+    PipelineTrace* trace = pipelineTrace();
+    if (trace != NULL)
+        trace->recorder->record(trace->type, stage, tscRead() - trace->parsedTicks);
+}
+
+/// prints a snapshot of metrics every intervalSeconds from its own thread, until destroyed
+class PipelineMetricsDumper
+{
+public:
+    PipelineMetricsDumper(const PipelineMetrics& metrics, double intervalSeconds, FILE* out = stdout);
+    ~PipelineMetricsDumper();
+
+    PipelineMetricsDumper(const PipelineMetricsDumper&) = delete;
+    PipelineMetricsDumper& operator=(const PipelineMetricsDumper&) = delete;
+
+private:
+    void run();
+
+private:
+    const PipelineMetrics& m_metrics;
+    double m_intervalSeconds;
+    FILE* m_out;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,163 @@
+#include "packet/reader_thread.h"
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define READER_THREAD_READ_SIZE 64 * 1024
+#define READER_THREAD_BLOCK_POLL_MS 100
+
+void FrameChannel::offer(ReceivedFrame&& frame, const std::atomic<bool>& running)
+{
+    // a failed push leaves frame untouched, so it can be tried again
+    switch (m_policy)
+    {
+    case OverflowPolicy_dropOldest:
+        while (!m_queue.tryPush(std::move(frame)))
+        {
+            if (m_queue.dropOldest())
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+    case OverflowPolicy_dropNewest:
+        if (!m_queue.tryPush(std::move(frame)))
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        break;
+    case OverflowPolicy_block:
+        while (!m_queue.push(std::move(frame), READER_THREAD_BLOCK_POLL_MS))
+        {
+            if (!running.load(std::memory_order_acquire))
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        break;
+    }
+
+    m_pushed.fetch_add(1, std::memory_order_relaxed);
+    size_t depth = m_queue.size();
+    if (depth > m_maxDepth.load(std::memory_order_relaxed))
+        m_maxDepth.store(depth, std::memory_order_relaxed);
+}
+
+ReaderThread::ReaderThread(std::shared_ptr<TcpStream> stream, size_t bufferSize)
+    : m_stream(stream), m_parser(this, bufferSize), m_readBuffer(READER_THREAD_READ_SIZE)
+{
+    m_wakefd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+}
+
+ReaderThread::~ReaderThread()
+{
+    stop();
+    if (m_wakefd != -1)
+        ::close(m_wakefd);
+}
+
+FrameChannel* ReaderThread::addChannel(Parser* parser, OverflowPolicy policy, size_t capacity)
+{
+    m_channels.emplace_back(new FrameChannel(policy, capacity));
+    addParser(parser, m_channels.back().get());
+    return m_channels.back().get();
+}
+
+void ReaderThread::addParser(Parser* parser, FrameChannel* channel)
+{
+    m_parser.addParser(parser);
+    m_routes.push_back(Route{parser, channel, NULL});
+}
+
+FrameMailbox* ReaderThread::addMailbox(Parser* parser, size_t maxFrameSize)
+{
+    m_mailboxes.emplace_back(new FrameMailbox(maxFrameSize));
+    m_parser.addParser(parser);
+    m_routes.push_back(Route{parser, NULL, m_mailboxes.back().get()});
+    return m_mailboxes.back().get();
+}
+
+bool ReaderThread::start()
+{
+    if (m_thread.joinable() || m_wakefd == -1 || !m_stream || !m_stream->isConnected())
+        return false;
+
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread(&ReaderThread::run, this);
+    return true;
+}
+
+void ReaderThread::stop()
+{
+    m_running.store(false, std::memory_order_release);
+    if (m_wakefd != -1)
+    {
+        uint64_t one = 1;
+        ssize_t r = ::write(m_wakefd, &one, sizeof(one));
+        (void)r;
+    }
+    // the reader may be waiting on a full OverflowPolicy_block channel, consumers on empty ones
+    for (auto& channel : m_channels)
+        channel->m_queue.interrupt();
+
+    if (m_thread.joinable())
+        m_thread.join();
+}
+
+void ReaderThread::run()
+{
+    struct pollfd fds[2];
+    fds[0].fd = m_stream->fd();
+    fds[0].events = POLLIN;
+    fds[1].fd = m_wakefd;
+    fds[1].events = POLLIN;
+
+    while (m_running.load(std::memory_order_acquire))
+    {
+        if (poll(fds, 2, -1) < 0 || (fds[1].revents & POLLIN))
+            break;
+
+        // the stream is non blocking, drain what is there before polling again
+        int n;
+        while ((n = m_stream->read(&m_readBuffer[0], m_readBuffer.size())) > 0)
+            m_parser.feed(&m_readBuffer[0], n);
+
+        if (!m_stream->isConnected())
+            break;
+    }
+
+    m_running.store(false, std::memory_order_release);
+    for (auto& channel : m_channels)
+        channel->m_queue.interrupt();
+}
+
+void ReaderThread::ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                             size_t bytes)
+{
+    const Route* found = NULL;
+    for (const Route& route : m_routes)
+    {
+        if (&route.parser->header() == &header || route.parser->header() == header)
+        {
+            found = &route;
+            break;
+        }
+    }
+    if (found == NULL)
+        return;
+
+    // conflated: overwrite in place, nothing is queued
+    if (found->mailbox != NULL)
+    {
+        found->mailbox->store(pack, bytes, time);
+        return;
+    }
+
+    ReceivedFrame frame;
+    frame.bytes = BufferPool::acquire(bytes);
+    frame.bytes.resize(bytes);
+    memcpy(frame.bytes.data(), pack, bytes);
+    frame.time = time;
+    found->channel->offer(std::move(frame), m_running);
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "packet/buffer_pool.h"
+#include "packet/frame_mailbox.h"
+#include "packet/packet_parser.h"
+#include "packet/spsc_queue.h"
+#include "packet/tcp_stream.h"
+
+enum OverflowPolicy
+{
+    OverflowPolicy_dropOldest = 0, // state streams, the consumer only misses samples that are stale anyway
+    OverflowPolicy_dropNewest = 1,
+    OverflowPolicy_block = 2 // control, the reader waits and the socket pushes back on the sender
+};
+
+/// a complete validated frame, wrapper header included
+struct ReceivedFrame
+{
+    PooledBuffer bytes;
+    /// when its header was found
+    ros::Time time;
+};
+
+/**
+Frames of one or more types, handed from a ReaderThread to one consumer thread.
+*/
+class FrameChannel
+{
+public:
+    FrameChannel(OverflowPolicy policy, size_t capacity) : m_policy(policy), m_queue(capacity) {}
+
+    /// consumer side, waits up to timeoutMs (-1 forever). Returns false early when the reader stops
+    bool pop(ReceivedFrame& frame, int timeoutMs = -1) { return m_queue.pop(frame, timeoutMs); }
+    bool tryPop(ReceivedFrame& frame) { return m_queue.tryPop(frame); }
+
+    OverflowPolicy policy() const { return m_policy; }
+    size_t capacity() const { return m_queue.capacity(); }
+    /// frames waiting right now
+    size_t depth() const { return m_queue.size(); }
+    /// the most frames that were ever waiting at once
+    size_t maxDepth() const { return m_maxDepth.load(std::memory_order_relaxed); }
+    /// frames the reader queued, including the ones dropped later by OverflowPolicy_dropOldest
+    size_t pushed() const { return m_pushed.load(std::memory_order_relaxed); }
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    friend class ReaderThread;
+
+    void offer(ReceivedFrame&& frame, const std::atomic<bool>& running);
+
+    OverflowPolicy m_policy;
+    SpscQueue<ReceivedFrame> m_queue;
+    std::atomic<size_t> m_maxDepth{0};
+    std::atomic<size_t> m_pushed{0};
+    std::atomic<size_t> m_dropped{0};
+};
+
+/**
+Reads and frames a TcpStream on a thread of its own, so a slow consumer does not hold up the socket or other
+message types. Every validated frame is copied into a pooled buffer and queued on the channel of its parser;
+consumers pop frames on their own threads and deserialize them, for example with MessageRouter::dispatch.
+Parsers added with addMailbox() only keep the newest frame, consumers read it whenever they want.
+
+demo code:
+```
+ReaderThread reader(stream);
+FrameChannel* odom = reader.addChannel(&odomParser, OverflowPolicy_dropOldest, 64);
+FrameChannel* control = reader.addChannel(&controlParser, OverflowPolicy_block, 16);
+reader.start();
+
+// consumer thread
+ReceivedFrame frame;
+while (reader.isRunning())
+    if (control->pop(frame))
+        router.dispatch(frame.bytes.data(), frame.time);
+```
+*/
+class ReaderThread : private ParserManagerDelegate
+{
+public:
+    ReaderThread(std::shared_ptr<TcpStream> stream, size_t bufferSize = UART_BUFFER_MAX_SIZE);
+    ~ReaderThread();
+
+    ReaderThread(const ReaderThread&) = delete;
+    ReaderThread& operator=(const ReaderThread&) = delete;
+
+    /// frames the parser accepts go into a new channel, call before start()
+    FrameChannel* addChannel(Parser* parser, OverflowPolicy policy, size_t capacity = 1024);
+    /// frames of another parser into an existing channel, call before start()
+    void addParser(Parser* parser, FrameChannel* channel);
+    /// conflation: only the newest frame the parser accepts is kept, call before start()
+    FrameMailbox* addMailbox(Parser* parser, size_t maxFrameSize = 256);
+
+    bool start();
+    /// stops and joins the thread, waiting consumers are woken
+    void stop();
+    /// false once stopped or the connection is gone
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+private:
+    void run();
+    void ParserManager_packetFound(const std::vector<uint8_t>& header, ros::Time time, const uint8_t* pack,
+                                   size_t bytes) override;
+
+private:
+    struct Route
+    {
+        Parser* parser;
+        FrameChannel* channel;
+        FrameMailbox* mailbox;
+    };
+
+    std::shared_ptr<TcpStream> m_stream;
+    ParserManager m_parser;
+    std::vector<std::unique_ptr<FrameChannel>> m_channels;
+    std::vector<std::unique_ptr<FrameMailbox>> m_mailboxes;
+    std::vector<Route> m_routes;
+    std::vector<uint8_t> m_readBuffer;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    int m_wakefd = -1;
+};
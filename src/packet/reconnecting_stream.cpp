@@ -0,0 +1,277 @@
+#include "packet/reconnecting_stream.h"
+#include <poll.h>
+#include <time.h>
+#include <algorithm>
+#include <cmath>
+
+#define RECONNECT_READ_SIZE 64 * 1024
+
+ReconnectingStream::ReconnectingStream(const ReconnectConfig& config, ParserManager* parser,
+                                       ReconnectingStreamDelegate* delegate, std::shared_ptr<TcpStream> stream)
+    : m_config(config), m_parser(parser), m_delegate(delegate), m_stream(stream),
+      m_random((unsigned)nowMs() ^ (unsigned)(uintptr_t)this), m_readBuffer(RECONNECT_READ_SIZE)
+{
+}
+
+ReconnectingStream::~ReconnectingStream()
+{
+    stop();
+}
+
+int64_t ReconnectingStream::nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void ReconnectingStream::start()
+{
+    if (m_state != ReconnectState_idle)
+        return;
+    m_attempts = 0;
+    attempt();
+}
+
+void ReconnectingStream::stop()
+{
+    m_stream->close();
+    if (m_frontSent > 0)
+        dropFront();
+    m_state = ReconnectState_idle;
+}
+
+void ReconnectingStream::attempt()
+{
+    if (!m_stream->openAsync(m_config.ip, m_config.port))
+    {
+        attemptFailed();
+        return;
+    }
+    if (m_stream->isConnected())
+    {
+        connected();
+        return;
+    }
+    m_state = ReconnectState_connecting;
+    m_deadlineMs = nowMs() + m_config.connectTimeoutMs;
+}
+
+void ReconnectingStream::attemptFailed()
+{
+    m_stream->close();
+    m_attempts++;
+    m_failedTotal++;
+
+    double base = m_config.backoffInitialMs * std::pow(m_config.backoffMultiplier, m_attempts - 1);
+    base = std::min(base, (double)m_config.backoffMaxMs);
+    double jitter = std::uniform_real_distribution<double>(0, m_config.backoffJitter)(m_random);
+    m_backoffMs = (int)(base * (1 - jitter));
+    m_deadlineMs = nowMs() + m_backoffMs;
+    m_state = ReconnectState_backoff;
+    if (m_delegate != NULL)
+        m_delegate->ReconnectingStream_attemptFailed(m_attempts, m_backoffMs);
+}
+
+void ReconnectingStream::connected()
+{
+    m_state = ReconnectState_connected;
+    m_attempts = 0;
+    m_backoffMs = 0;
+    m_connects++;
+    if (m_config.keepAliveIdleSeconds > 0)
+        m_stream->setKeepAlive(m_config.keepAliveIdleSeconds, m_config.keepAliveIntervalSeconds,
+                               m_config.keepAliveCount, m_config.userTimeoutMs);
+
+    m_parser->reset();
+    if (m_delegate != NULL)
+        m_delegate->ReconnectingStream_connected();
+    flush();
+}
+
+void ReconnectingStream::disconnected()
+{
+    m_stream->close();
+    if (m_frontSent > 0)
+        dropFront(); // the peer got its head, the rest would be garbage to the next connection
+
+    // retry on the next poll without waiting, a short drop is over by then. Not right here: this may run from
+    // inside a packet callback, where the parser must not be reset
+    m_state = ReconnectState_backoff;
+    m_deadlineMs = nowMs();
+    if (m_delegate != NULL)
+        m_delegate->ReconnectingStream_disconnected();
+}
+
+bool ReconnectingStream::poll(int timeoutMs)
+{
+    int64_t endMs = timeoutMs < 0 ? -1 : nowMs() + timeoutMs;
+    while (true)
+    {
+        int64_t now = nowMs();
+        int remaining = endMs < 0 ? -1 : (int)std::max<int64_t>(0, endMs - now);
+        switch (m_state)
+        {
+        case ReconnectState_idle:
+            return false;
+
+        case ReconnectState_backoff:
+        {
+            if (now >= m_deadlineMs)
+            {
+                attempt();
+                break;
+            }
+            int wait = (int)(m_deadlineMs - now);
+            if (remaining >= 0 && remaining < wait)
+            {
+                ::poll(NULL, 0, remaining);
+                return false;
+            }
+            ::poll(NULL, 0, wait);
+            break;
+        }
+
+        case ReconnectState_connecting:
+        {
+            int wait = (int)std::max<int64_t>(0, m_deadlineMs - now);
+            int result = m_stream->pollConnect(remaining >= 0 ? std::min(wait, remaining) : wait);
+            if (result == 1)
+            {
+                connected();
+                return isConnected();
+            }
+            if (result == -1 || nowMs() >= m_deadlineMs)
+            {
+                attemptFailed();
+                break;
+            }
+            return false;
+        }
+
+        case ReconnectState_connected:
+        {
+            struct pollfd pfd;
+            pfd.fd = m_stream->fd();
+            pfd.events = POLLIN | (queuedBytes() > 0 ? POLLOUT : 0);
+            pfd.revents = 0;
+            if (::poll(&pfd, 1, remaining) > 0)
+            {
+                if (pfd.revents & (POLLIN | POLLHUP | POLLERR))
+                    readAll();
+                if (isConnected() && (pfd.revents & POLLOUT))
+                    flush();
+            }
+            return isConnected();
+        }
+        }
+    }
+}
+
+void ReconnectingStream::readAll()
+{
+    while (isConnected())
+    {
+        int n = m_stream->read(&m_readBuffer[0], m_readBuffer.size());
+        if (n > 0)
+        {
+            m_parser->feed(&m_readBuffer[0], n);
+            continue;
+        }
+        if (!m_stream->isConnected())
+            disconnected();
+        return;
+    }
+}
+
+bool ReconnectingStream::send(const uint8_t* bytes, size_t n)
+{
+    if (n > m_config.maxQueuedBytes)
+    {
+        m_droppedMessages++;
+        return false;
+    }
+
+    // keep ordering, nothing goes out directly while older messages are queued
+    size_t sent = 0;
+    if (isConnected() && queuedBytes() == 0)
+    {
+        while (sent < n)
+        {
+            int written = m_stream->write(bytes + sent, n - sent);
+            if (written <= 0)
+                break;
+            sent += written;
+        }
+        if (sent == n)
+            return true;
+        if (!m_stream->isConnected())
+        {
+            disconnected();
+            if (sent > 0)
+            {
+                m_droppedMessages++;
+                return false;
+            }
+        }
+    }
+
+    while (queuedBytes() + n > m_config.maxQueuedBytes)
+    {
+        // the head of a message the socket took in part can not be taken back
+        if (m_config.overflowPolicy != OverflowPolicy_dropOldest || (isConnected() && m_frontSent > 0)
+            || m_lengths.empty())
+        {
+            m_droppedMessages++;
+            return false;
+        }
+        dropFront();
+    }
+
+    if (m_lengths.empty())
+        m_frontSent = sent;
+    m_queue.insert(m_queue.end(), bytes, bytes + n);
+    m_lengths.push_back(n);
+    return true;
+}
+
+bool ReconnectingStream::flush()
+{
+    while (queuedBytes() > m_frontSent)
+    {
+        int written = m_stream->write(&m_queue[m_queueOffset + m_frontSent], queuedBytes() - m_frontSent);
+        if (written <= 0)
+            break;
+        m_frontSent += written;
+        while (!m_lengths.empty() && m_frontSent >= m_lengths.front())
+        {
+            m_frontSent -= m_lengths.front();
+            m_queueOffset += m_lengths.front();
+            m_lengths.pop_front();
+        }
+    }
+
+    // drop what has been sent so the queue does not grow while the peer is slow
+    m_queue.erase(m_queue.begin(), m_queue.begin() + m_queueOffset);
+    m_queueOffset = 0;
+
+    if (!m_stream->isConnected())
+    {
+        disconnected();
+        return false;
+    }
+    return true;
+}
+
+void ReconnectingStream::dropFront()
+{
+    m_queueOffset += m_lengths.front();
+    m_lengths.pop_front();
+    m_frontSent = 0;
+    m_droppedMessages++;
+    if (m_lengths.empty())
+    {
+        m_queue.clear();
+        m_queueOffset = 0;
+    }
+}
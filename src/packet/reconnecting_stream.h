@@ -0,0 +1,152 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "packet/packet_parser.h"
+#include "packet/reader_thread.h"
+#include "packet/tcp_stream.h"
+
+struct ReconnectConfig
+{
+    std::string ip = "127.0.0.1";
+    int port = 8091;
+    /// a connect attempt that did not complete in this time counts as failed
+    int connectTimeoutMs = 1000;
+
+    /// waits between attempts: initial, multiplied per failure up to max, randomly shortened by up to jitter
+    /// (0..1) so that many clients dropped at once do not come back in lockstep
+    int backoffInitialMs = 20;
+    int backoffMaxMs = 2000;
+    double backoffMultiplier = 2.0;
+    double backoffJitter = 0.5;
+
+    /// dead peer detection on a connection that went silent, see TcpStream::setKeepAlive. keepAliveIdleSeconds 0
+    /// leaves the kernel defaults
+    int keepAliveIdleSeconds = 1;
+    int keepAliveIntervalSeconds = 1;
+    int keepAliveCount = 3;
+    unsigned userTimeoutMs = 3000;
+
+    /// messages sent while disconnected wait here, whole messages are dropped by policy beyond it
+    size_t maxQueuedBytes = 64 * 1024;
+    OverflowPolicy overflowPolicy = OverflowPolicy_dropOldest;
+};
+
+enum ReconnectState
+{
+    ReconnectState_idle = 0,       // start() was not called yet, or stop()
+    ReconnectState_connecting = 1, // a non-blocking connect is in progress
+    ReconnectState_connected = 2,
+    ReconnectState_backoff = 3 // waiting for the next attempt
+};
+
+class ReconnectingStreamDelegate
+{
+public:
+    /// the parser was reset, nothing of the previous connection is left in it
+    virtual void ReconnectingStream_connected() {}
+    virtual void ReconnectingStream_disconnected() {}
+    /// attempts failed in a row since the connection was lost, the next one follows in backoffMs
+    virtual void ReconnectingStream_attemptFailed(int /*attempts*/, int /*backoffMs*/) {}
+};
+
+/**
+Keeps a TcpStream connected to a robot across link drops, without blocking: connects are non-blocking with a
+timeout, failures are retried with jittered exponential backoff, and keepalive plus TCP_USER_TIMEOUT notice a
+dead peer within seconds instead of minutes.
+
+Received bytes go into parser, which is reset on every new connection so a frame cut off by the drop is not
+completed with bytes of the next one. Messages sent while disconnected wait in a bounded queue and go out right
+after the connect; a message the socket took only part of when the link dropped is not resent.
+
+Single threaded: send() and poll() must be called from the same thread.
+
+demo code:
+```
+ReconnectConfig config;
+config.ip = "192.168.10.10";
+ReconnectingStream connection(config, &parser);
+connection.start();
+while (true)
+{
+    connection.poll(10);
+    connection.send(bytes, n);
+}
+```
+*/
+class ReconnectingStream
+{
+public:
+    ReconnectingStream(const ReconnectConfig& config, ParserManager* parser,
+                       ReconnectingStreamDelegate* delegate = NULL,
+                       std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>());
+    ~ReconnectingStream();
+
+    ReconnectingStream(const ReconnectingStream&) = delete;
+    ReconnectingStream& operator=(const ReconnectingStream&) = delete;
+
+    /// starts the first connect attempt right away
+    void start();
+    /// closes the connection, queued messages are kept for the next start()
+    void stop();
+
+    /**
+    Waits up to timeoutMs (-1 forever) for the socket or the next attempt and does what is due: completes or
+    retries the connect, feeds received bytes to the parser, flushes the queue. Returns false if still not
+    connected afterwards.
+    */
+    bool poll(int timeoutMs);
+
+    /// sends one whole framed message now, or queues it while disconnected or the socket is full. false if it was
+    /// dropped, by OverflowPolicy_dropNewest or because it is larger than the queue
+    bool send(const uint8_t* bytes, size_t n);
+
+    ReconnectState state() const { return m_state; }
+    bool isConnected() const { return m_state == ReconnectState_connected; }
+    TcpStream& stream() { return *m_stream; }
+
+    size_t queuedBytes() const { return m_queue.size() - m_queueOffset; }
+    size_t queuedMessages() const { return m_lengths.size(); }
+    size_t connectCount() const { return m_connects; }
+    size_t failedAttempts() const { return m_failedTotal; }
+    size_t droppedMessages() const { return m_droppedMessages; }
+    /// the wait before the next attempt, ms
+    int backoffMs() const { return m_backoffMs; }
+
+private:
+    void attempt();
+    void connected();
+    void disconnected();
+    void attemptFailed();
+    void readAll();
+    bool flush();
+    void dropFront();
+
+    static int64_t nowMs();
+
+private:
+    ReconnectConfig m_config;
+    ParserManager* m_parser;
+    ReconnectingStreamDelegate* m_delegate;
+    std::shared_ptr<TcpStream> m_stream;
+    ReconnectState m_state = ReconnectState_idle;
+
+    int m_attempts = 0; // failed since the last connection
+    int m_backoffMs = 0;
+    int64_t m_deadlineMs = 0; // connect timeout, or the end of the backoff
+    std::minstd_rand m_random;
+
+    std::vector<uint8_t> m_queue;
+    size_t m_queueOffset = 0;
+    std::deque<size_t> m_lengths; // of the queued messages, oldest first
+    size_t m_frontSent = 0;       // bytes of the oldest queued message already taken by the socket
+    std::vector<uint8_t> m_readBuffer;
+
+    size_t m_connects = 0;
+    size_t m_failedTotal = 0;
+    size_t m_droppedMessages = 0;
+};
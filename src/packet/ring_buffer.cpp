@@ -0,0 +1,112 @@
+#include "packet/ring_buffer.h"
+#include <new>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace
+{
+size_t roundToPage(size_t n)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (n + page - 1) / page * page;
+}
+} // namespace
+
+RingBuffer::RingBuffer(size_t capacity, bool prefault)
+{
+    m_capacity = roundToPage(capacity > 0 ? capacity : 1);
+    m_mirrored = mapMirrored(prefault);
+    if (!m_mirrored)
+    {
+        m_base = (uint8_t*)malloc(m_capacity);
+        if (m_base == nullptr)
+            throw std::bad_alloc();
+    }
+}
+
+RingBuffer::~RingBuffer()
+{
+    if (m_mirrored)
+        munmap(m_base, m_capacity * 2);
+    else
+        free(m_base);
+}
+
+bool RingBuffer::mapMirrored(bool prefault)
+{
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    int fd = memfd_create("ring_buffer", MFD_CLOEXEC);
+    if (fd == -1)
+        return false;
+
+    if (ftruncate(fd, (off_t)m_capacity) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // reserve 2x address space, then map the same pages into both halves
+    void* base = mmap(NULL, m_capacity * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // pages are faulted in on first use unless asked for, a connection that only sees small frames never
+    // touches most of them
+    uint8_t* p = (uint8_t*)base;
+    int flags = MAP_SHARED | MAP_FIXED | (prefault ? MAP_POPULATE : 0);
+    if (mmap(p, m_capacity, PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED
+        || mmap(p + m_capacity, m_capacity, PROT_READ | PROT_WRITE, flags, fd, 0) == MAP_FAILED)
+    {
+        munmap(base, m_capacity * 2);
+        ::close(fd);
+        return false;
+    }
+
+    // the mappings keep the memory alive
+    ::close(fd);
+    m_base = p;
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t RingBuffer::append(const uint8_t* bytes, size_t n)
+{
+    if (n > space())
+        n = space();
+    if (n == 0)
+        return 0;
+
+    if (!m_mirrored && (size_t)(m_write - m_offset) + n > m_capacity)
+    {
+        memmove(m_base, data(), size());
+        m_offset = m_read;
+    }
+
+    memcpy(m_base + (m_write - m_offset), bytes, n);
+    m_write += n;
+    return n;
+}
+
+void RingBuffer::consume(size_t n)
+{
+    if (n > size())
+        n = size();
+    m_read += n;
+
+    // keep the read position inside the first mapping, the mirror covers the rest
+    if (m_mirrored && m_read - m_offset >= m_capacity)
+        m_offset += m_capacity;
+}
+
+void RingBuffer::clear()
+{
+    m_read = m_write;
+    m_offset = m_read;
+}
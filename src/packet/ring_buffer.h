@@ -0,0 +1,48 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+Fixed-capacity byte FIFO whose readable bytes are always contiguous.
+
+On Linux the storage is one memfd mapped twice back to back, so a read that runs past the end of the first
+mapping continues in the mirror and no packet ever wraps. Consuming bytes only moves the read index.
+If the mirror can not be set up the buffer falls back to a plain allocation that compacts on append.
+*/
+class RingBuffer
+{
+public:
+    /// capacity is rounded up to the page size. prefault maps the pages in up front so the first pass over the
+    /// buffer takes no page faults, at the price of committing the whole capacity right away
+    explicit RingBuffer(size_t capacity, bool prefault = false);
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    uint8_t* data() { return m_base + (m_read - m_offset); }
+    const uint8_t* data() const { return m_base + (m_read - m_offset); }
+    size_t size() const { return (size_t)(m_write - m_read); }
+    size_t capacity() const { return m_capacity; }
+    size_t space() const { return m_capacity - size(); }
+    bool empty() const { return m_write == m_read; }
+    bool isMirrored() const { return m_mirrored; }
+
+    /// appends at most space() bytes, returns the number of bytes taken
+    size_t append(const uint8_t* bytes, size_t n);
+    void consume(size_t n);
+    void clear();
+
+private:
+    bool mapMirrored(bool prefault);
+
+private:
+    uint8_t* m_base = nullptr;
+    size_t m_capacity = 0;
+    bool m_mirrored = false;
+
+    // absolute stream positions, m_offset is the position that maps to m_base
+    uint64_t m_read = 0;
+    uint64_t m_write = 0;
+    uint64_t m_offset = 0;
+};
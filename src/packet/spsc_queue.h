@@ -0,0 +1,182 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <atomic>
+#include <memory>
+
+/**
+Bounded single producer / single consumer queue.
+
+Every slot carries a sequence number that says whether it holds an item for the consumer or is free for the
+producer, so push and pop are wait-free and never touch the other side's index. dropOldest() lets the producer
+take the oldest item itself when the consumer falls behind; it claims it with a compare exchange on the head, the
+same way pop does, so the two can not both take it.
+
+pop and push block through a futex only when asked to wait, the fast paths are plain atomics.
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+    /// capacity is rounded up to a power of two, at least 2
+    explicit SpscQueue(size_t capacity)
+    {
+        m_capacity = 2;
+        while (m_capacity < capacity)
+            m_capacity <<= 1;
+        m_mask = m_capacity - 1;
+        m_slots.reset(new Slot[m_capacity]);
+        for (size_t i = 0; i < m_capacity; i++)
+            m_slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    size_t capacity() const { return m_capacity; }
+    /// approximate while the other side is running
+    size_t size() const
+    {
+        size_t tail = m_tail.load(std::memory_order_acquire);
+        size_t head = m_head.load(std::memory_order_acquire);
+        return tail >= head ? tail - head : 0;
+    }
+
+    /// producer only, false if the queue is full
+    bool tryPush(T&& item)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & m_mask];
+        if (slot.seq.load(std::memory_order_acquire) != pos)
+            return false;
+        slot.item = std::move(item);
+        slot.seq.store(pos + 1, std::memory_order_release);
+        m_tail.store(pos + 1, std::memory_order_release);
+        wake(m_pushes, m_consumerWaiting);
+        return true;
+    }
+
+    /// producer only, waits up to timeoutMs (-1 forever) for the consumer to make room. May give up early when
+    /// interrupted
+    bool push(T&& item, int timeoutMs)
+    {
+        uint32_t seen = m_pops.load(std::memory_order_acquire);
+        if (tryPush(std::move(item)))
+            return true;
+        if (timeoutMs == 0)
+            return false;
+        m_producerWaiting.store(1, std::memory_order_seq_cst);
+        // a pop that raced with announcing the wait moved m_pops, the futex then returns right away
+        if (!tryPush(std::move(item)))
+        {
+            sleep(m_pops, seen, timeoutMs);
+            m_producerWaiting.store(0, std::memory_order_relaxed);
+            return tryPush(std::move(item));
+        }
+        m_producerWaiting.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// producer only, removes the oldest item to make room, false if the consumer emptied the queue meanwhile
+    bool dropOldest() { return take(NULL); }
+
+    /// consumer only, false if the queue is empty
+    bool tryPop(T& item) { return take(&item); }
+
+    /// consumer only, waits up to timeoutMs (-1 forever) for an item. May give up early when interrupted
+    bool pop(T& item, int timeoutMs)
+    {
+        uint32_t seen = m_pushes.load(std::memory_order_acquire);
+        if (tryPop(item))
+            return true;
+        if (timeoutMs == 0)
+            return false;
+        m_consumerWaiting.store(1, std::memory_order_seq_cst);
+        if (!tryPop(item))
+        {
+            sleep(m_pushes, seen, timeoutMs);
+            m_consumerWaiting.store(0, std::memory_order_relaxed);
+            return tryPop(item);
+        }
+        m_consumerWaiting.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// wakes a waiting consumer or producer, so it can look at a stop flag
+    void interrupt()
+    {
+        m_pushes.fetch_add(1, std::memory_order_acq_rel);
+        m_pops.fetch_add(1, std::memory_order_acq_rel);
+        futex(&m_pushes, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL);
+        futex(&m_pops, FUTEX_WAKE_PRIVATE, INT32_MAX, NULL);
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> seq;
+        T item;
+    };
+
+    bool take(T* item)
+    {
+        size_t pos = m_head.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot& slot = m_slots[pos & m_mask];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq != pos + 1)
+            {
+                if (seq <= pos)
+                    return false; // empty
+                pos = m_head.load(std::memory_order_relaxed); // taken by the other side, look again
+                continue;
+            }
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+            {
+                if (item != NULL)
+                    *item = std::move(slot.item);
+                else
+                    slot.item = T();
+                slot.seq.store(pos + m_capacity, std::memory_order_release);
+                wake(m_pops, m_producerWaiting);
+                return true;
+            }
+        }
+    }
+
+    static long futex(std::atomic<uint32_t>* word, int op, uint32_t value, const struct timespec* timeout)
+    {
+        return syscall(SYS_futex, (uint32_t*)word, op, value, timeout, NULL, 0);
+    }
+
+    static void wake(std::atomic<uint32_t>& counter, std::atomic<uint32_t>& waiting)
+    {
+        counter.fetch_add(1, std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_seq_cst) != 0)
+            futex(&counter, FUTEX_WAKE_PRIVATE, 1, NULL);
+    }
+
+    // returns when counter is no longer seen, on a wake or after timeoutMs
+    static void sleep(std::atomic<uint32_t>& counter, uint32_t seen, int timeoutMs)
+    {
+        struct timespec timeout = {timeoutMs / 1000, (long)(timeoutMs % 1000) * 1000000};
+        futex(&counter, FUTEX_WAIT_PRIVATE, seen, timeoutMs < 0 ? NULL : &timeout);
+    }
+
+private:
+    size_t m_capacity;
+    size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::atomic<uint32_t> m_pushes{0};
+    std::atomic<uint32_t> m_consumerWaiting{0};
+    alignas(64) std::atomic<uint32_t> m_pops{0};
+    std::atomic<uint32_t> m_producerWaiting{0};
+};
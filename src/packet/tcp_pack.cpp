@@ -1,22 +1,45 @@
 #include "packet/tcp_pack.h"
 #include "../shared/crc.h"
+#include "ros/message_wrapper.h"
 #include <cstdio>
 
+namespace
+{
+ax::WrapperHeader readHeader(const uint8_t* bytes, bool bigEndian)
+{
+    return bigEndian ? ax::read_wrapper_header<ros::serialization::BigEndian>(bytes)
+                     : ax::read_wrapper_header<ros::serialization::LittleEndian>(bytes);
+}
+} // namespace
+
 ParserResult MsgPackParser::feed(const uint8_t* bytes, size_t n, size_t* bytesUsed)
 {
     // header(2) + length(4) + crc(2) + body
     if (n < sizeof(MsgPack))
         return ParserResult_incomplete;
 
-    uint32_t payloadLength = *(uint32_t*)(bytes + sizeof(MsgPack::header));
+    ax::WrapperHeader header = readHeader(bytes, m_bigEndian);
+    uint32_t payloadLength = header.data_length;
     size_t completeLength = payloadLength + sizeof(MsgPack);
     if (n < completeLength)
         return ParserResult_incomplete;
 
     *bytesUsed = completeLength;
+    if (!m_verifyCrc)
+        return ParserResult_succ;
 
-    uint16_t referCrc = *(uint16_t*)(bytes + sizeof(MsgPack::header) + sizeof(MsgPack::length));
+    PipelineTrace* trace = pipelineTrace();
+    uint64_t begin = trace != NULL ? tscRead() : 0;
+
+    uint16_t referCrc = header.crc16;
     uint16_t calcCrc = calculateCRC16(bytes + sizeof(MsgPack), payloadLength);
+
+    if (trace != NULL)
+    {
+        trace->recorder->record(trace->type, PipelineStage_crc, tscRead() - begin);
+        if (referCrc != calcCrc)
+            trace->recorder->metrics().countCrcFailure();
+    }
     if (referCrc != calcCrc)
     {
         printf("check sum failed\n");
@@ -14,11 +14,18 @@ struct __attribute__((packed)) MsgPack
 class MsgPackParser : public Parser
 {
 public:
-    MsgPackParser(std::vector<uint8_t> header) : m_header(header) {}
+    /// verifyCrc false leaves the crc to the consumer, see FrameMailbox. bigEndian for frames of a big endian peer,
+    /// whose length and crc are stored that way, see to_buffer
+    MsgPackParser(std::vector<uint8_t> header, bool verifyCrc = true, bool bigEndian = false)
+        : m_header(header), m_verifyCrc(verifyCrc), m_bigEndian(bigEndian)
+    {
+    }
 
     const std::vector<uint8_t>& header() override { return m_header; }
 
     ParserResult feed(const uint8_t* bytes, size_t n, size_t* bytesUsed) override;
 
     const std::vector<uint8_t> m_header;
+    const bool m_verifyCrc;
+    const bool m_bigEndian;
 };
@@ -1,19 +1,71 @@
 #include "tcp_stream.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netinet/ip.h>
+#include <poll.h>
+#include <errno.h>
+#include <linux/errqueue.h>
+#include <limits.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <string.h>
 #include <iostream>
+#include <algorithm>
+
+const char* socketProfileName(SocketProfile profile)
+{
+    switch (profile)
+    {
+    case SocketProfile_default:
+        return "default";
+    case SocketProfile_lowLatency:
+        return "low_latency";
+    case SocketProfile_throughput:
+        return "throughput";
+    default:
+        return "?";
+    }
+}
+
+SocketTuning SocketTuning::forProfile(SocketProfile profile, int cpu)
+{
+    SocketTuning tuning;
+    tuning.incomingCpu = cpu;
+    if (profile == SocketProfile_lowLatency)
+    {
+        tuning.noDelay = true;
+        tuning.quickAck = true;
+        tuning.busyPollUs = 50;
+        tuning.priority = 6;
+        tuning.tos = IPTOS_LOWDELAY;
+    }
+    else if (profile == SocketProfile_throughput)
+    {
+        tuning.recvBufferBytes = 4 * 1024 * 1024;
+        tuning.sendBufferBytes = 4 * 1024 * 1024;
+        tuning.notSentLowatBytes = 256 * 1024;
+    }
+    return tuning;
+}
 
 bool TcpStream::open(std::string ip, int port = 8091)
 {
-    // 创建 socket
-    m_sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (m_sockfd == -1)
+    if (!openAsync(ip, port))
+        return false;
+    if (pollConnect(m_connectTimeoutMs) != 1)
     {
+        close();
         return false;
     }
+    return true;
+}
+
+bool TcpStream::openAsync(std::string ip, int port)
+{
+    close();
 
     // 设置服务器地址和端口
     struct sockaddr_in server_addr
@@ -27,20 +79,107 @@ bool TcpStream::open(std::string ip, int port = 8091)
         return false;
     }
 
+    // 创建非阻塞 socket, connect 不再卡住调用线程
+    m_sockfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_sockfd == -1)
+    {
+        return false;
+    }
+
+    applyTuning();
+
     // 连接服务器
-    if (connect(m_sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+    if (connect(m_sockfd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == 0)
+    {
+        m_connected = true;
+        return true;
+    }
+    if (errno != EINPROGRESS)
     {
+        close();
         return false;
     }
+    m_connecting = true;
+    return true;
+}
+
+int TcpStream::pollConnect(int timeoutMs)
+{
+    if (m_connected)
+        return 1;
+    if (!m_connecting)
+        return -1;
+
+    struct pollfd pfd;
+    pfd.fd = m_sockfd;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+    int ready;
+    while ((ready = poll(&pfd, 1, timeoutMs)) < 0 && errno == EINTR)
+    {
+    }
+    if (ready == 0)
+        return 0;
+
+    int error = 0;
+    socklen_t len = sizeof(error);
+    if (ready < 0 || getsockopt(m_sockfd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0)
+    {
+        close();
+        return -1;
+    }
+    m_connecting = false;
+    m_connected = true;
+    return 1;
+}
+
+bool TcpStream::setKeepAlive(int idleSeconds, int intervalSeconds, int count, unsigned userTimeoutMs)
+{
+    if (m_sockfd == -1)
+        return false;
 
-    // 设置套接字非阻塞模式
+    int on = 1;
+    bool ok = setsockopt(m_sockfd, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)) == 0;
+    ok = ok && setsockopt(m_sockfd, IPPROTO_TCP, TCP_KEEPIDLE, &idleSeconds, sizeof(idleSeconds)) == 0;
+    ok = ok && setsockopt(m_sockfd, IPPROTO_TCP, TCP_KEEPINTVL, &intervalSeconds, sizeof(intervalSeconds)) == 0;
+    ok = ok && setsockopt(m_sockfd, IPPROTO_TCP, TCP_KEEPCNT, &count, sizeof(count)) == 0;
+    ok = ok && setsockopt(m_sockfd, IPPROTO_TCP, TCP_USER_TIMEOUT, &userTimeoutMs, sizeof(userTimeoutMs)) == 0;
+    return ok;
+}
+
+bool TcpStream::attach(int fd)
+{
+    close();
+    if (fd == -1)
+        return false;
+
+    m_sockfd = fd;
     int flags = fcntl(m_sockfd, F_GETFL, 0);
     fcntl(m_sockfd, F_SETFL, flags | O_NONBLOCK);
-
+    applyTuning();
     m_connected = true;
     return true;
 }
 
+void TcpStream::applyTuning()
+{
+    auto set = [this](int level, int name, int value) {
+        if (value >= 0 && setsockopt(m_sockfd, level, name, &value, sizeof(value)) != 0)
+            m_tuningRejected++;
+    };
+
+    m_tuningRejected = 0;
+    set(IPPROTO_TCP, TCP_NODELAY, m_tuning.noDelay ? 1 : -1);
+    set(IPPROTO_TCP, TCP_QUICKACK, m_tuning.quickAck ? 1 : -1);
+    set(SOL_SOCKET, SO_BUSY_POLL, m_tuning.busyPollUs);
+    set(SOL_SOCKET, SO_PRIORITY, m_tuning.priority);
+    set(IPPROTO_IP, IP_TOS, m_tuning.tos);
+    set(SOL_SOCKET, SO_INCOMING_CPU, m_tuning.incomingCpu);
+    set(SOL_SOCKET, SO_RCVBUF, m_tuning.recvBufferBytes);
+    set(SOL_SOCKET, SO_SNDBUF, m_tuning.sendBufferBytes);
+    set(IPPROTO_TCP, TCP_NOTSENT_LOWAT, m_tuning.notSentLowatBytes);
+}
+
 bool TcpStream::close()
 {
     if (m_sockfd != -1)
@@ -48,6 +187,9 @@ bool TcpStream::close()
         ::close(m_sockfd);
         m_sockfd = -1;
         m_connected = false;
+        m_connecting = false;
+        m_zeroCopyThreshold = 0;
+        m_zeroCopyPending = 0;
         return true;
     }
     return false;
@@ -64,21 +206,101 @@ int TcpStream::read(uint8_t* buffer, size_t size)
         return -1;
 
     int numBytes = (int)recv(m_sockfd, buffer, size, 0);
-    if (numBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+    if (numBytes == 0 || (numBytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
     {
+        // 0 means the peer closed the connection
         m_connected = false;
         return 0;
     }
+    if (numBytes > 0 && m_tuning.quickAck)
+    {
+        int one = 1;
+        setsockopt(m_sockfd, IPPROTO_TCP, TCP_QUICKACK, &one, sizeof(one));
+    }
     return numBytes;
 }
 
 int TcpStream::write(const uint8_t* buffer, size_t size)
 {
-    ssize_t numBytes = ::send(m_sockfd, buffer, size, 0);
+    if (!m_connected)
+        return 0;
+
+    ssize_t numBytes = ::send(m_sockfd, buffer, size, MSG_NOSIGNAL);
     if (numBytes < 0)
     {
-        m_connected = false;
+        // a full send buffer is not an error on a non-blocking socket
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            m_connected = false;
         return 0;
     }
     return static_cast<size_t>(numBytes);
-}
\ No newline at end of file
+}
+
+int TcpStream::writev(const struct iovec* iov, int count)
+{
+    if (!m_connected)
+        return 0;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = (struct iovec*)iov;
+    msg.msg_iovlen = std::min(count, IOV_MAX);
+
+    int flags = MSG_NOSIGNAL;
+    if (m_zeroCopyThreshold > 0)
+    {
+        size_t total = 0;
+        for (size_t i = 0; i < msg.msg_iovlen; i++)
+            total += iov[i].iov_len;
+        if (total >= m_zeroCopyThreshold)
+            flags |= MSG_ZEROCOPY;
+    }
+
+    ssize_t numBytes = ::sendmsg(m_sockfd, &msg, flags);
+    if (numBytes < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+            m_connected = false;
+        return 0;
+    }
+    if (flags & MSG_ZEROCOPY)
+        m_zeroCopyPending++;
+    return static_cast<int>(numBytes);
+}
+
+bool TcpStream::setZeroCopy(size_t threshold)
+{
+    if (m_sockfd == -1)
+        return false;
+
+    int on = threshold > 0 ? 1 : 0;
+    if (setsockopt(m_sockfd, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) != 0)
+        return false;
+    m_zeroCopyThreshold = threshold;
+    return true;
+}
+
+int TcpStream::zeroCopyPending()
+{
+    while (m_zeroCopyPending > 0)
+    {
+        char control[128];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (recvmsg(m_sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+            break;
+
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            struct sock_extended_err err;
+            memcpy(&err, CMSG_DATA(cm), sizeof(err));
+            if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+            // one notification covers the range of sends [ee_info, ee_data]
+            m_zeroCopyPending -= (int)(err.ee_data - err.ee_info + 1);
+        }
+    }
+    return m_zeroCopyPending;
+}
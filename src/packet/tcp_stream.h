@@ -2,18 +2,124 @@
 #include <cstdio>
 #include <stdint.h>
 #include <string>
+#include "packet/buffer_pool.h"
+
+struct iovec;
+
+enum SocketProfile
+{
+    SocketProfile_default = 0,    // kernel defaults, Nagle on
+    SocketProfile_lowLatency = 1, // control link: no Nagle, quick acks, busy poll, high priority
+    SocketProfile_throughput = 2, // bulk streams: large buffers, bounded unsent data
+    SocketProfile_count
+};
+
+const char* socketProfileName(SocketProfile profile);
+
+/**
+Socket options TcpStream applies to every socket it opens or attaches, before connect so that the buffer sizes
+shape the window scale. -1 and false leave the kernel default.
+
+busyPollUs only helps on NICs with NAPI busy polling, loopback ignores it, and raising it above
+net.core.busy_read needs CAP_NET_ADMIN. incomingCpu is a hint the kernel uses to pick among SO_REUSEPORT
+listeners; steering the receive path of a client socket to a CPU still takes RFS or IRQ affinity.
+*/
+struct SocketTuning
+{
+    bool noDelay = false;
+    /// TCP_QUICKACK, re-armed after every read since the kernel falls back to delayed acks on its own
+    bool quickAck = false;
+    int busyPollUs = -1;
+    /// SO_PRIORITY 0..6 without CAP_NET_ADMIN, and the IP TOS byte (DSCP << 2)
+    int priority = -1;
+    int tos = -1;
+    int incomingCpu = -1;
+    /// SO_RCVBUF / SO_SNDBUF, capped by net.core.rmem_max / wmem_max
+    int recvBufferBytes = -1;
+    int sendBufferBytes = -1;
+    /// TCP_NOTSENT_LOWAT, the socket reports writable only while less than this is queued and unsent
+    int notSentLowatBytes = -1;
+
+    /// cpu -1 leaves incomingCpu unset
+    static SocketTuning forProfile(SocketProfile profile, int cpu = -1);
+};
 
 class TcpStream
 {
 public:
-    bool open(std::string ip, int port);
-    bool close();
+    virtual ~TcpStream() { TcpStream::close(); }
+
+    /// connects within connectTimeoutMs(), the socket is non-blocking afterwards. Nothing is left open on failure
+    virtual bool open(std::string ip, int port);
+    /**
+    Starts a non-blocking connect and returns right away, true if it is in progress or already done. Wait for it
+    with pollConnect(), or watch fd() for writability and call pollConnect(0).
+    */
+    bool openAsync(std::string ip, int port);
+    /// waits up to timeoutMs (-1 forever) for openAsync(): 1 connected, 0 still connecting, -1 failed and closed
+    int pollConnect(int timeoutMs);
+    bool isConnecting() const { return m_connecting; }
+    /// -1 (default) waits as long as the kernel keeps retrying the SYN
+    void setConnectTimeout(int timeoutMs) { m_connectTimeoutMs = timeoutMs; }
+    int connectTimeout() const { return m_connectTimeoutMs; }
+
+    /**
+    Keepalive probes after idleSeconds of silence, every intervalSeconds, count of them unanswered drop the
+    connection. userTimeoutMs (TCP_USER_TIMEOUT) drops it when sent data stays unacknowledged that long, which
+    keepalive alone does not catch while the send queue is not empty. Call it on an open socket.
+    */
+    bool setKeepAlive(int idleSeconds, int intervalSeconds, int count, unsigned userTimeoutMs);
+
+    /**
+    Options for the next open() or attach(), see SocketTuning. Options the kernel refuses are skipped and counted
+    in tuningRejected(), the socket works without them.
+
+    demo code:
+    ```
+    TcpStream stream;
+    stream.setTuning(SocketTuning::forProfile(SocketProfile_lowLatency));
+    stream.open("192.168.10.10", 8091);
+    ```
+    */
+    void setTuning(const SocketTuning& tuning) { m_tuning = tuning; }
+    const SocketTuning& tuning() const { return m_tuning; }
+    int tuningRejected() const { return m_tuningRejected; }
+
+    /// takes over an already connected socket, for example one from accept(), and makes it non-blocking
+    bool attach(int fd);
+    virtual bool close();
     bool isConnected();
 
-    int read(uint8_t* buffer, size_t size);
-    int write(const uint8_t* buffer, size_t size);
+    /// returns -1 if nothing is available yet, 0 if the connection is gone
+    virtual int read(uint8_t* buffer, size_t size);
+    /// returns the number of bytes the socket took, 0 if it is full or the connection is gone
+    virtual int write(const uint8_t* buffer, size_t size);
+    int write(const PooledBuffer& buffer) { return write(buffer.data(), buffer.size()); }
+
+    /// gathers iov into one sendmsg, returns the number of bytes taken like write()
+    virtual int writev(const struct iovec* iov, int count);
+
+    /**
+    Sends of at least threshold bytes through writev use MSG_ZEROCOPY: the kernel keeps referencing the memory
+    after writev returns, it must stay unchanged until zeroCopyPending() drops back to 0. threshold 0 turns it off.
+    Returns false if the kernel does not support it.
+    */
+    bool setZeroCopy(size_t threshold);
+    /// collects completion notifications, returns the number of zero copy sends still referencing their memory
+    int zeroCopyPending();
+
+    int fd() const { return m_sockfd; }
+
+protected:
+    void applyTuning();
 
-private:
-    bool m_connected;
-    int m_sockfd;
-};
\ No newline at end of file
+protected:
+    bool m_connected = false;
+    bool m_connecting = false;
+    int m_sockfd = -1;
+    int m_connectTimeoutMs = -1;
+    SocketTuning m_tuning;
+    int m_tuningRejected = 0;
+    size_t m_zeroCopyThreshold = 0;
+    int m_zeroCopyPending = 0;
+};
@@ -0,0 +1,617 @@
+#include "packet/uring_tcp_stream.h"
+#include <string.h>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#        include <linux/io_uring.h>
+#        if defined(IORING_RECV_MULTISHOT) && defined(IORING_RECVSEND_FIXED_BUF) && defined(IORING_CQE_F_NOTIF)
+#            define HAS_URING 1
+#        endif
+#    endif
+#endif
+#ifndef HAS_URING
+#    define HAS_URING 0
+#endif
+
+#define URING_ENTRIES 64
+#define URING_TAG_RECV 1
+#define URING_TAG_SEND 2
+
+UringTcpStream::UringTcpStream(unsigned recvBufferCount, size_t recvBufferSize, size_t sendBufferSize,
+                               size_t submitBatchBytes)
+    : m_recvBufferSize(recvBufferSize), m_sendBufferSize(sendBufferSize), m_submitBatchBytes(submitBatchBytes)
+{
+    // buffer rings must be a power of two
+    m_recvBufferCount = 1;
+    while (m_recvBufferCount < recvBufferCount && m_recvBufferCount < 32768)
+        m_recvBufferCount <<= 1;
+}
+
+UringTcpStream::~UringTcpStream()
+{
+    close();
+}
+
+#if HAS_URING
+namespace
+{
+int uringSetup(unsigned entries, struct io_uring_params* p)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize)
+{
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+int uringRegister(int fd, unsigned opcode, void* arg, unsigned count)
+{
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+size_t pageAlign(size_t n)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    return (n + page - 1) / page * page;
+}
+} // namespace
+
+bool UringTcpStream::isSupported()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = uringSetup(4, &p);
+    if (fd < 0)
+        return false;
+
+    // provided buffer rings (5.19) are the newest feature we need besides multishot recv
+    bool ok = (p.features & IORING_FEAT_EXT_ARG) != 0;
+    if (ok)
+    {
+        size_t size = pageAlign(sizeof(struct io_uring_buf));
+        void* ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        struct io_uring_buf_reg reg;
+        memset(&reg, 0, sizeof(reg));
+        reg.ring_addr = (uint64_t)(uintptr_t)ring;
+        reg.ring_entries = 1;
+        ok = ring != MAP_FAILED && uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) == 0;
+        if (ring != MAP_FAILED)
+            munmap(ring, size);
+    }
+    ::close(fd);
+    return ok;
+}
+
+bool UringTcpStream::setupRing()
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = uringSetup(URING_ENTRIES, &p);
+    if (fd < 0)
+        return false;
+    m_ringfd = fd;
+
+    if (!(p.features & IORING_FEAT_EXT_ARG))
+        return false;
+
+    m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+    {
+        m_sqRing = nullptr;
+        return false;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        m_cqRing = m_sqRing;
+    }
+    else
+    {
+        m_cqRing =
+            mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+        {
+            m_cqRing = nullptr;
+            return false;
+        }
+    }
+    m_sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+    m_sqes = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED)
+    {
+        m_sqes = nullptr;
+        return false;
+    }
+
+    uint8_t* sq = (uint8_t*)m_sqRing;
+    m_sqHead = (unsigned*)(sq + p.sq_off.head);
+    m_sqTail = (unsigned*)(sq + p.sq_off.tail);
+    m_sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    m_sqArray = (unsigned*)(sq + p.sq_off.array);
+    uint8_t* cq = (uint8_t*)m_cqRing;
+    m_cqHead = (unsigned*)(cq + p.cq_off.head);
+    m_cqTail = (unsigned*)(cq + p.cq_off.tail);
+    m_cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    m_cqes = cq + p.cq_off.cqes;
+
+    // provided receive buffers, group 0
+    m_recvBuffers.resize(m_recvBufferCount * m_recvBufferSize);
+    m_bufRingSize = pageAlign(m_recvBufferCount * sizeof(struct io_uring_buf));
+    m_bufRing = mmap(NULL, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m_bufRing == MAP_FAILED)
+    {
+        m_bufRing = nullptr;
+        return false;
+    }
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)m_bufRing;
+    reg.ring_entries = m_recvBufferCount;
+    reg.bgid = 0;
+    if (uringRegister(fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+        return false;
+    for (unsigned i = 0; i < m_recvBufferCount; i++)
+        recycle((uint16_t)i);
+
+    // fixed send buffers, index 0 and 1
+    struct iovec iov[2];
+    for (int i = 0; i < 2; i++)
+    {
+        m_sendBuffers[i].resize(m_sendBufferSize);
+        iov[i].iov_base = &m_sendBuffers[i][0];
+        iov[i].iov_len = m_sendBufferSize;
+    }
+    if (uringRegister(fd, IORING_REGISTER_BUFFERS, iov, 2) != 0)
+        return false;
+
+    return true;
+}
+
+void UringTcpStream::teardownRing()
+{
+    if (m_sqes != nullptr)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing != nullptr && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing != nullptr)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_ringfd != -1)
+        ::close(m_ringfd);
+    if (m_bufRing != nullptr)
+        munmap(m_bufRing, m_bufRingSize);
+
+    m_sqes = m_sqRing = m_cqRing = m_bufRing = nullptr;
+    m_ringfd = -1;
+    m_toSubmit = 0;
+    m_received.clear();
+    m_recvArmed = false;
+    m_eof = false;
+    m_fillLength = 0;
+    m_sendInFlight = false;
+    m_sendCopied = false;
+    m_notifsPending = 0;
+}
+
+void UringTcpStream::recycle(uint16_t bid)
+{
+    struct io_uring_buf_ring* ring = (struct io_uring_buf_ring*)m_bufRing;
+    uint16_t tail = ring->tail;
+    // the entries start at the ring itself, in C++ the header's flex array member lands at offset 8
+    struct io_uring_buf* buf = (struct io_uring_buf*)m_bufRing + (tail & (m_recvBufferCount - 1));
+    buf->addr = (uint64_t)(uintptr_t)&m_recvBuffers[bid * m_recvBufferSize];
+    buf->len = (uint32_t)m_recvBufferSize;
+    buf->bid = bid;
+    __atomic_store_n(&ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+namespace
+{
+struct io_uring_sqe* nextSqe(void* sqes, unsigned* sqTail, unsigned sqMask, unsigned* sqArray)
+{
+    unsigned tail = *sqTail;
+    struct io_uring_sqe* sqe = &((struct io_uring_sqe*)sqes)[tail & sqMask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[tail & sqMask] = tail & sqMask;
+    return sqe;
+}
+} // namespace
+
+bool UringTcpStream::armRecv()
+{
+    struct io_uring_sqe* sqe = nextSqe(m_sqes, m_sqTail, m_sqMask, m_sqArray);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = m_sockfd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+    sqe->user_data = URING_TAG_RECV;
+    __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+    m_recvArmed = true;
+    return enter(m_toSubmit, 0, 0);
+}
+
+bool UringTcpStream::submitSend()
+{
+    // the buffer being filled goes out, writes continue into the other one
+    int index = m_fillIndex;
+    if (!m_sendInFlight)
+    {
+        if (m_fillLength == 0)
+            return true;
+        m_inFlightOffset = 0;
+        m_inFlightLength = m_fillLength;
+        m_sendInFlight = true;
+        // the other buffer is pinned until the peer ACKs its zero-copy send, which a delayed ACK holds back for
+        // ~40 ms. Rather than waiting, let the kernel copy this buffer and keep filling it once that completed
+        m_sendCopied = m_notifsPending > 0;
+        if (!m_sendCopied)
+        {
+            m_fillIndex ^= 1;
+            m_fillLength = 0;
+        }
+    }
+    else if (!m_sendCopied)
+    {
+        index = m_fillIndex ^ 1; // remainder of a short send
+    }
+
+    struct io_uring_sqe* sqe = nextSqe(m_sqes, m_sqTail, m_sqMask, m_sqArray);
+    sqe->opcode = m_sendCopied ? IORING_OP_SEND : IORING_OP_SEND_ZC;
+    sqe->fd = m_sockfd;
+    sqe->addr = (uint64_t)(uintptr_t)&m_sendBuffers[index][m_inFlightOffset];
+    sqe->len = (uint32_t)(m_inFlightLength - m_inFlightOffset);
+    sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+    if (!m_sendCopied)
+    {
+        sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+        sqe->buf_index = (uint16_t)index;
+    }
+    sqe->user_data = URING_TAG_SEND;
+    __atomic_store_n(m_sqTail, *m_sqTail + 1, __ATOMIC_RELEASE);
+    m_toSubmit++;
+    return enter(m_toSubmit, 0, 0);
+}
+
+bool UringTcpStream::enter(unsigned toSubmit, unsigned minComplete, int timeoutMs)
+{
+    unsigned flags = IORING_ENTER_GETEVENTS;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    void* argp = NULL;
+    size_t argSize = 0;
+    if (minComplete > 0 && timeoutMs >= 0)
+    {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (long long)(timeoutMs % 1000) * 1000000;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+        flags |= IORING_ENTER_EXT_ARG;
+        argp = &arg;
+        argSize = sizeof(arg);
+    }
+
+    int ret = uringEnter(m_ringfd, toSubmit, minComplete, flags, argp, argSize);
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY)
+        return false;
+    if (ret > 0)
+        m_toSubmit -= std::min((unsigned)ret, m_toSubmit);
+    return true;
+}
+
+void UringTcpStream::reap(bool enterIfEmpty)
+{
+    unsigned head = *m_cqHead;
+    // completions of socket requests are delivered as task work, entering the kernel runs it
+    if (enterIfEmpty && head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+        enter(m_toSubmit, 0, 0);
+
+    bool resend = false;
+    while (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+    {
+        struct io_uring_cqe* cqe = &((struct io_uring_cqe*)m_cqes)[head & m_cqMask];
+        head++;
+
+        if (cqe->user_data == URING_TAG_RECV)
+        {
+            if (!(cqe->flags & IORING_CQE_F_MORE))
+                m_recvArmed = false;
+
+            if (cqe->res > 0 && (cqe->flags & IORING_CQE_F_BUFFER))
+            {
+                uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+                m_received.push_back(RecvChunk{bid, 0, (uint32_t)cqe->res});
+            }
+            else
+            {
+                if (cqe->flags & IORING_CQE_F_BUFFER)
+                    recycle((uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT));
+                // on -ENOBUFS read() rearms once it hands buffers back
+                if (cqe->res == -EINVAL)
+                    m_multishotUnsupported = true;
+                else if (cqe->res != -ENOBUFS)
+                    m_eof = true; // 0 is an orderly close, anything else an error
+            }
+        }
+        else if (cqe->user_data == URING_TAG_SEND)
+        {
+            if (cqe->flags & IORING_CQE_F_NOTIF)
+            {
+                m_notifsPending--;
+            }
+            else
+            {
+                if (cqe->flags & IORING_CQE_F_MORE)
+                    m_notifsPending++;
+                if (cqe->res < 0)
+                {
+                    m_connected = false;
+                    m_sendInFlight = false;
+                }
+                else
+                {
+                    m_inFlightOffset += cqe->res;
+                    if (m_inFlightOffset < m_inFlightLength)
+                    {
+                        resend = true;
+                    }
+                    else
+                    {
+                        m_sendInFlight = false;
+                        if (m_sendCopied)
+                            m_fillLength = 0;
+                    }
+                }
+            }
+        }
+    }
+    __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+    if (resend && m_connected)
+        submitSend();
+    else if (!m_sendInFlight && m_connected && m_fillLength > 0 && m_fillLength >= m_submitBatchBytes)
+        submitSend();
+}
+#else
+bool UringTcpStream::isSupported()
+{
+    return false;
+}
+bool UringTcpStream::setupRing()
+{
+    return false;
+}
+void UringTcpStream::teardownRing()
+{
+}
+void UringTcpStream::recycle(uint16_t)
+{
+}
+bool UringTcpStream::armRecv()
+{
+    return false;
+}
+bool UringTcpStream::submitSend()
+{
+    return false;
+}
+bool UringTcpStream::enter(unsigned, unsigned, int)
+{
+    return false;
+}
+void UringTcpStream::reap(bool)
+{
+}
+#endif
+
+void UringTcpStream::fallback()
+{
+    teardownRing();
+    if (m_sockfd != -1)
+    {
+        int flags = fcntl(m_sockfd, F_GETFL, 0);
+        fcntl(m_sockfd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+bool UringTcpStream::open(std::string ip, int port)
+{
+    if (!TcpStream::open(ip, port))
+        return false;
+
+    if (!setupRing())
+    {
+        fallback();
+        return true;
+    }
+
+    // io_uring polls the socket itself, a non-blocking socket would just complete with EAGAIN
+    int flags = fcntl(m_sockfd, F_GETFL, 0);
+    fcntl(m_sockfd, F_SETFL, flags & ~O_NONBLOCK);
+
+    if (!armRecv())
+        fallback();
+    return true;
+}
+
+bool UringTcpStream::close()
+{
+    teardownRing();
+    return TcpStream::close();
+}
+
+int UringTcpStream::read(uint8_t* buffer, size_t size)
+{
+    if (!isUringActive())
+        return TcpStream::read(buffer, size);
+    if (!m_connected)
+        return -1;
+
+    if (m_received.empty())
+        reap();
+
+    if (m_multishotUnsupported && m_received.empty())
+    {
+        // nothing was received through the ring yet, plain recv takes over from here
+        fallback();
+        return TcpStream::read(buffer, size);
+    }
+
+    size_t copied = 0;
+    while (copied < size && !m_received.empty())
+    {
+        RecvChunk& chunk = m_received.front();
+        size_t n = std::min(size - copied, (size_t)(chunk.length - chunk.offset));
+        memcpy(buffer + copied, &m_recvBuffers[chunk.bid * m_recvBufferSize + chunk.offset], n);
+        copied += n;
+        chunk.offset += (uint32_t)n;
+        if (chunk.offset == chunk.length)
+        {
+            recycle(chunk.bid);
+            m_received.pop_front();
+        }
+    }
+
+    if (!m_recvArmed && !m_eof && m_connected)
+        armRecv();
+
+    if (copied > 0)
+        return (int)copied;
+    if (m_eof)
+    {
+        m_connected = false;
+        return 0;
+    }
+    return -1;
+}
+
+int UringTcpStream::write(const uint8_t* buffer, size_t size)
+{
+    if (!isUringActive())
+        return TcpStream::write(buffer, size);
+    if (!m_connected)
+        return 0;
+
+    // a finished send is only noticed here, without it everything after the first send would wait for the fill
+    // buffer to run full. The task work that posts completions runs on any return from the kernel, a look at the
+    // completion queue is enough and saves a syscall per write
+    if (m_sendInFlight || m_notifsPending > 0)
+        reap(false);
+    if (!m_connected)
+        return 0;
+
+    size_t n = std::min(size, freeSendSpace());
+    if (n < size)
+    {
+        // both buffers busy, see if the one in flight is done
+        reap();
+        n = std::min(size, freeSendSpace());
+    }
+    while (n == 0 && m_connected)
+    {
+        // still full: wait for the send like a blocking send() waits for socket space, a caller retrying right away
+        // would only spin on io_uring_enter and keep the peer from reading
+        if (!enter(m_toSubmit, 1, -1))
+            m_connected = false;
+        reap(false);
+        n = std::min(size, freeSendSpace());
+    }
+    if (!m_connected)
+        return 0;
+
+    memcpy(&m_sendBuffers[m_fillIndex][m_fillLength], buffer, n);
+    m_fillLength += n;
+
+    if (!m_sendInFlight && m_fillLength >= std::max(m_submitBatchBytes, (size_t)1))
+    {
+        if (!submitSend())
+            m_connected = false;
+    }
+    return (int)n;
+}
+
+size_t UringTcpStream::freeSendSpace() const
+{
+    // a copied send goes out of the fill buffer itself
+    if (m_sendInFlight && m_sendCopied)
+        return 0;
+    return m_sendBufferSize - m_fillLength;
+}
+
+int UringTcpStream::writev(const struct iovec* iov, int count)
+{
+    if (!isUringActive())
+        return TcpStream::writev(iov, count);
+
+    size_t total = 0;
+    for (int i = 0; i < count; i++)
+    {
+        int n = write((const uint8_t*)iov[i].iov_base, iov[i].iov_len);
+        total += n;
+        if (n < (int)iov[i].iov_len)
+            break;
+    }
+    return (int)total;
+}
+
+bool UringTcpStream::flush(int timeoutMs)
+{
+    if (!isUringActive())
+        return m_connected;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t deadlineMs = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 + timeoutMs;
+    while (m_connected)
+    {
+        reap();
+        if (!m_connected)
+            break;
+        if (!m_sendInFlight)
+        {
+            if (m_fillLength == 0)
+                return true;
+            if (!submitSend())
+            {
+                m_connected = false;
+                break;
+            }
+            continue;
+        }
+
+        int waitMs = -1;
+        if (timeoutMs >= 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            waitMs = (int)(deadlineMs - ((int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000));
+            if (waitMs <= 0)
+                return false;
+        }
+        if (!enter(m_toSubmit, 1, waitMs))
+            m_connected = false;
+    }
+    return false;
+}
+
+bool UringTcpStream::wait(int timeoutMs)
+{
+    if (!isUringActive())
+        return false;
+    if (!m_received.empty())
+        return true;
+    return enter(m_toSubmit, 1, timeoutMs);
+}
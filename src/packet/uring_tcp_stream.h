@@ -0,0 +1,110 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include "packet/tcp_stream.h"
+
+/**
+TcpStream that moves data through io_uring instead of one recv/send syscall per call.
+
+Receiving uses a single multishot recv into a ring of provided buffers, read() copies out of completed buffers
+and hands them back to the kernel. Sending copies into one of two registered (fixed) buffers; while one is in
+flight the next write()s coalesce into the other, so a burst of small messages goes out as one submission. They
+are submitted by the next write(), read() or flush() after the send in flight completed; flush() to be sure the
+last of a burst went out.
+
+If the kernel lacks io_uring, provided buffer rings or multishot recv, the stream silently behaves like a plain
+TcpStream.
+*/
+class UringTcpStream : public TcpStream
+{
+public:
+    /// submitBatchBytes: an idle stream submits once this many bytes are queued, 0 submits every write
+    UringTcpStream(unsigned recvBufferCount = 64, size_t recvBufferSize = 16 * 1024,
+                   size_t sendBufferSize = 256 * 1024, size_t submitBatchBytes = 0);
+    ~UringTcpStream() override;
+
+    bool open(std::string ip, int port) override;
+    bool close() override;
+
+    using TcpStream::write;
+    int read(uint8_t* buffer, size_t size) override;
+    /// copies into the fill buffer, when both buffers are busy it blocks until the send in flight completed
+    int write(const uint8_t* buffer, size_t size) override;
+    /// copies the pieces into the send buffer like write(), MSG_ZEROCOPY is not used while io_uring is active
+    int writev(const struct iovec* iov, int count) override;
+
+    /// submits whatever write() has queued and waits up to timeoutMs (-1 forever) until the kernel took all of it.
+    /// false on timeout or if the connection broke
+    bool flush(int timeoutMs = -1);
+    /// blocks until a completion arrives or timeoutMs passes
+    bool wait(int timeoutMs);
+
+    bool isUringActive() const { return m_ringfd != -1; }
+    static bool isSupported();
+
+private:
+    struct RecvChunk
+    {
+        uint16_t bid;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    bool setupRing();
+    void teardownRing();
+    void fallback();
+
+    bool armRecv();
+    void recycle(uint16_t bid);
+    bool submitSend();
+    size_t freeSendSpace() const;
+    bool enter(unsigned toSubmit, unsigned minComplete, int timeoutMs);
+    /// enterIfEmpty: enter the kernel to run pending task work when no completion is queued
+    void reap(bool enterIfEmpty = true);
+
+private:
+    unsigned m_recvBufferCount;
+    size_t m_recvBufferSize;
+    size_t m_sendBufferSize;
+    size_t m_submitBatchBytes;
+
+    int m_ringfd = -1;
+    unsigned m_toSubmit = 0;
+
+    // mapped rings
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    void* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned* m_sqArray = nullptr;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    void* m_cqes = nullptr;
+
+    // provided receive buffers
+    void* m_bufRing = nullptr;
+    size_t m_bufRingSize = 0;
+    std::vector<uint8_t> m_recvBuffers;
+    std::deque<RecvChunk> m_received;
+    bool m_recvArmed = false;
+    bool m_eof = false;
+    bool m_multishotUnsupported = false;
+
+    // double buffered fixed send buffers
+    std::vector<uint8_t> m_sendBuffers[2];
+    size_t m_fillLength = 0;
+    int m_fillIndex = 0;
+    bool m_sendInFlight = false;
+    size_t m_inFlightOffset = 0;
+    size_t m_inFlightLength = 0;
+    // zero-copy sends keep referencing the buffer until their notification arrives
+    int m_notifsPending = 0;
+    // the send in flight is a copying one straight out of the fill buffer
+    bool m_sendCopied = false;
+};
@@ -1,42 +1,94 @@
 #pragma once
 
 #include "../ros/ros_serialization.h"
+#include <array>
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <vector>
 
 namespace ax
 {
-class CustomMsg
+/**
+Strings and vectors take their memory from ContainerAllocator. CustomMsg uses std::allocator, pmr::CustomMsg one
+that is passed in, so a MessageArena can hold everything deserialized from a packet.
+*/
+template <class ContainerAllocator>
+class CustomMsg_
 {
 public:
-    CustomMsg() = default;
+    typedef ContainerAllocator allocator_type;
+    typedef std::basic_string<char, std::char_traits<char>,
+                              typename std::allocator_traits<ContainerAllocator>::template rebind_alloc<char>>
+        StringType;
 
-    CustomMsg(const std::string& name, float linear_velocity_x, float linear_velocity_y, float angular_velocity)
+    CustomMsg_() = default;
+    CustomMsg_(const CustomMsg_&) = default;
+    CustomMsg_(CustomMsg_&&) = default;
+    CustomMsg_& operator=(const CustomMsg_&) = default;
+    CustomMsg_& operator=(CustomMsg_&&) = default;
+
+    explicit CustomMsg_(const ContainerAllocator& alloc) : name(alloc) {}
+
+    // used by containers with a scoped allocator (std::pmr) to hand theirs down
+    CustomMsg_(const CustomMsg_& other, const ContainerAllocator& alloc)
+        : name(other.name, alloc), linear_velocity_x(other.linear_velocity_x),
+          linear_velocity_y(other.linear_velocity_y), angular_velocity(other.angular_velocity)
+    {
+    }
+    CustomMsg_(CustomMsg_&& other, const ContainerAllocator& alloc)
+        : name(std::move(other.name), alloc), linear_velocity_x(other.linear_velocity_x),
+          linear_velocity_y(other.linear_velocity_y), angular_velocity(other.angular_velocity)
+    {
+    }
+
+    CustomMsg_(const StringType& name, float linear_velocity_x, float linear_velocity_y, float angular_velocity)
         : name(name), linear_velocity_x(linear_velocity_x), linear_velocity_y(linear_velocity_y),
           angular_velocity(angular_velocity)
     {
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const CustomMsg& obj)
+    friend std::ostream& operator<<(std::ostream& os, const CustomMsg_& obj)
     {
         os << obj.name << " " << obj.linear_velocity_x << " " << obj.linear_velocity_y << " " << obj.angular_velocity;
         return os;
     }
 
-    std::string name;
+    StringType name;
     float linear_velocity_x = 0;
     float linear_velocity_y = 0;
     float angular_velocity = 0;
 };
 
-class CustomMsgArray
+template <class ContainerAllocator>
+class CustomMsgArray_
 {
 public:
     constexpr static char magic_header[2] = {'B', '2'};
 
-    std::array<CustomMsg, 2> msgs;
-    std::vector<CustomMsg> msgs_vector;
+    typedef ContainerAllocator allocator_type;
+    typedef CustomMsg_<ContainerAllocator> ItemType;
+
+    CustomMsgArray_() = default;
+    explicit CustomMsgArray_(const ContainerAllocator& alloc)
+        : msgs{{ItemType(alloc), ItemType(alloc)}}, msgs_vector(alloc)
+    {
+    }
+
+    std::array<ItemType, 2> msgs;
+    std::vector<ItemType, typename std::allocator_traits<ContainerAllocator>::template rebind_alloc<ItemType>>
+        msgs_vector;
 };
 
+typedef CustomMsg_<std::allocator<void>> CustomMsg;
+typedef CustomMsgArray_<std::allocator<void>> CustomMsgArray;
+
+namespace pmr
+{
+typedef CustomMsg_<std::pmr::polymorphic_allocator<char>> CustomMsg;
+typedef CustomMsgArray_<std::pmr::polymorphic_allocator<char>> CustomMsgArray;
+} // namespace pmr
+
 } // namespace ax
 
 //////////////////////////////////////////////////////////////////////////////
@@ -44,18 +96,18 @@ namespace ros
 {
 namespace message_traits
 {
-template <>
-struct IsFixedSize<ax::CustomMsg> : public FalseType
+template <class ContainerAllocator>
+struct IsFixedSize<ax::CustomMsg_<ContainerAllocator>> : public FalseType
 {
 };
 } // namespace message_traits
 namespace serialization
 {
-template <>
-struct Serializer<ax::CustomMsg>
+template <class ContainerAllocator>
+struct Serializer<ax::CustomMsg_<ContainerAllocator>>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.name);
         stream.next(m.linear_velocity_x);
@@ -66,11 +118,11 @@ struct Serializer<ax::CustomMsg>
     ROS_DECLARE_ALLINONE_SERIALIZER
 };
 
-template <>
-struct Serializer<ax::CustomMsgArray>
+template <class ContainerAllocator>
+struct Serializer<ax::CustomMsgArray_<ContainerAllocator>>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.msgs);
         stream.next(m.msgs_vector);
@@ -30,6 +30,12 @@ template <>
 struct IsFixedSize<ax::DeviceState> : public TrueType
 {
 };
+
+// members are declared in serialization order without padding
+template <>
+struct IsSimple<ax::DeviceState> : public TrueType
+{
+};
 } // namespace message_traits
 
 namespace serialization
@@ -38,7 +44,7 @@ template <>
 struct Serializer<ax::DeviceState>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.left_voltage);
         stream.next(m.left_current);
@@ -23,7 +23,7 @@ template <>
 struct Serializer<ax::Header>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.seq);
         stream.next(m.stamp);
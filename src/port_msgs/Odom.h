@@ -26,6 +26,12 @@ template <>
 struct IsFixedSize<ax::Odom> : public TrueType
 {
 };
+
+// members are declared in serialization order without padding
+template <>
+struct IsSimple<ax::Odom> : public TrueType
+{
+};
 } // namespace message_traits
 
 namespace serialization
@@ -34,7 +40,7 @@ template <>
 struct Serializer<ax::Odom>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.stamp);
         stream.next(m.twist_linear_x);
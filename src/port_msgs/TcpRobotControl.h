@@ -29,7 +29,7 @@ template <>
 struct Serializer<ax::TcpRobotControl>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.enable_wheels);
     }
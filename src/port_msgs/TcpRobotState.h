@@ -31,7 +31,7 @@ template <>
 struct Serializer<ax::TcpRobotState>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.wheels_enabled);
         stream.next(m.battery_percent);
@@ -21,6 +21,12 @@ template <>
 struct IsFixedSize<ax::Vector3> : public TrueType
 {
 };
+
+// members are declared in serialization order without padding
+template <>
+struct IsSimple<ax::Vector3> : public TrueType
+{
+};
 } // namespace message_traits
 
 namespace serialization
@@ -29,7 +35,7 @@ template <>
 struct Serializer<ax::Vector3>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.x);
         stream.next(m.y);
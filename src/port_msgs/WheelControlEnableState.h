@@ -32,15 +32,14 @@ struct Serializer<ax::WheelControlEnableState>
     template <typename Stream>
     inline static void write(Stream& stream, const ax::WheelControlEnableState v)
     {
-        int32_t b = static_cast<int32_t>(v);
-        memcpy(stream.advance(4), &b, 4);
+        storeValue<Stream>(stream.advance(4), static_cast<int32_t>(v));
     }
 
     template <typename Stream>
     inline static void read(Stream& stream, ax::WheelControlEnableState& v)
     {
         int32_t b;
-        memcpy(&b, stream.advance(4), 4);
+        loadValue<Stream>(b, stream.advance(4));
         v = (ax::WheelControlEnableState)(b);
     }
 
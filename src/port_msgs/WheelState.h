@@ -21,8 +21,9 @@ namespace ros
 {
 namespace message_traits
 {
+// wheel_error_msg is a string
 template <>
-struct IsFixedSize<ax::WheelState> : public TrueType
+struct IsFixedSize<ax::WheelState> : public FalseType
 {
 };
 } // namespace message_traits
@@ -33,7 +34,7 @@ template <>
 struct Serializer<ax::WheelState>
 {
     template <typename Stream, typename T>
-    inline static void allInOne(Stream& stream, T m)
+    constexpr static void allInOne(Stream& stream, T&& m)
     {
         stream.next(m.enable_state);
         stream.next(m.wheel_error_msg);
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <sys/uio.h>
+#include <algorithm>
+#include <vector>
+
+#include "ros_serialization.h"
+
+namespace ros
+{
+namespace serialization
+{
+
+/**
+ * \brief Output stream that builds an iovec list instead of one contiguous buffer
+ *
+ * Small fields are copied into a scratch buffer owned by the stream.  Blocks of at least referenceThreshold bytes
+ * that serializers pass to writeBytes (strings, vectors and arrays of simple types) are referenced where they are,
+ * so the iovec list is only valid while the serialized objects are alive and unchanged.  With an Endian that is not
+ * the host's, arrays of numbers are swapped into the scratch buffer instead.
+ */
+template <typename Endian = LittleEndian>
+struct GatherStream
+{
+    static const StreamType stream_type = stream_types::Output;
+    typedef Endian endian_type;
+
+    GatherStream(uint32_t referenceThreshold = 1024) : threshold_(referenceThreshold), length_(0), scratchLength_(0) {}
+
+    /**
+     * \brief Serialize an item to this gather stream
+     */
+    template <typename T>
+    ROS_FORCE_INLINE void next(const T& t)
+    {
+        serialize(*this, t);
+    }
+
+    template <typename T>
+    ROS_FORCE_INLINE GatherStream& operator<<(const T& t)
+    {
+        serialize(*this, t);
+        return *this;
+    }
+
+    /**
+     * \brief Reserves len bytes in the scratch buffer, the pointer is valid until the next advance
+     */
+    inline uint8_t* advance(uint32_t len)
+    {
+        size_t offset = scratchLength_;
+        scratchLength_ += len;
+        // grows only, clear() keeps the memory and nothing is zeroed on the way
+        if (scratchLength_ > scratch_.size())
+            scratch_.resize(std::max(scratchLength_, scratch_.size() * 2));
+        if (segments_.empty() || segments_.back().data != NULL)
+            segments_.push_back(Segment{NULL, offset, len});
+        else
+            segments_.back().length += len;
+        length_ += len;
+        return &scratch_[offset];
+    }
+
+    /**
+     * \brief Appends a block by reference, nothing is copied
+     */
+    inline void reference(const void* data, uint32_t len)
+    {
+        if (len == 0)
+            return;
+        segments_.push_back(Segment{(const uint8_t*)data, 0, len});
+        length_ += len;
+    }
+
+    inline uint32_t getThreshold() const { return threshold_; }
+
+    /**
+     * \brief Total number of bytes written so far
+     */
+    inline size_t size() const { return length_; }
+
+    /**
+     * \brief Offset of the next advance in the scratch buffer, see scratch()
+     */
+    inline size_t scratchSize() const { return scratchLength_; }
+    inline uint8_t* scratch(size_t offset) { return &scratch_[offset]; }
+
+    /**
+     * \brief Calls f(const uint8_t* data, size_t len) for every piece of the bytes from offset on
+     */
+    template <typename F>
+    void visit(size_t offset, F f) const
+    {
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            const Segment& segment = segments_[i];
+            if (offset >= segment.length)
+            {
+                offset -= segment.length;
+                continue;
+            }
+            const uint8_t* data = segment.data != NULL ? segment.data : &scratch_[segment.offset];
+            f(data + offset, segment.length - offset);
+            offset = 0;
+        }
+    }
+
+    /**
+     * \brief The gathered bytes, valid until the stream is written to again
+     */
+    inline const std::vector<struct iovec>& iov()
+    {
+        iov_.resize(segments_.size());
+        for (size_t i = 0; i < segments_.size(); i++)
+        {
+            const Segment& segment = segments_[i];
+            iov_[i].iov_base = (void*)(segment.data != NULL ? segment.data : &scratch_[segment.offset]);
+            iov_[i].iov_len = segment.length;
+        }
+        return iov_;
+    }
+
+    /**
+     * \brief Forgets everything, the memory is kept for the next message
+     */
+    inline void clear()
+    {
+        segments_.clear();
+        length_ = 0;
+        scratchLength_ = 0;
+    }
+
+private:
+    struct Segment
+    {
+        // NULL: the bytes live in scratch_ at offset, it may still move while the stream grows
+        const uint8_t* data;
+        size_t offset;
+        size_t length;
+    };
+
+    uint32_t threshold_;
+    size_t length_;
+    size_t scratchLength_;
+    std::vector<uint8_t> scratch_;
+    std::vector<Segment> segments_;
+    std::vector<struct iovec> iov_;
+};
+
+/**
+ * \brief Large blocks are referenced, small ones copied so the iovec list stays short
+ */
+template <typename Endian>
+inline void writeBytes(GatherStream<Endian>& stream, const void* data, uint32_t len)
+{
+    if (len >= stream.getThreshold())
+        stream.reference(data, len);
+    else
+        memcpy(stream.advance(len), data, len);
+}
+
+} // namespace serialization
+} // namespace ros
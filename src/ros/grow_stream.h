@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "ros_serialization.h"
+
+namespace ros
+{
+namespace serialization
+{
+
+template <typename Endian = LittleEndian>
+struct GrowStream;
+
+/**
+ * \brief Memory for GrowStream, kept across messages
+ *
+ * It is never zeroed and only grows, a buffer reused for every message serializes without allocating once it has
+ * seen the largest one.
+ */
+struct GrowBuffer
+{
+    GrowBuffer(size_t capacity = 4096) : data_(NULL), size_(0), capacity_(0) { reserve(capacity); }
+    ~GrowBuffer() { free(data_); }
+
+    GrowBuffer(const GrowBuffer&) = delete;
+    GrowBuffer& operator=(const GrowBuffer&) = delete;
+
+    inline void reserve(size_t capacity)
+    {
+        if (capacity <= capacity_)
+            return;
+        uint8_t* data = (uint8_t*)realloc(data_, capacity);
+        if (data == NULL)
+            throw std::bad_alloc();
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    inline uint8_t* getData() { return data_; }
+    inline const uint8_t* getData() const { return data_; }
+    inline size_t size() const { return size_; }
+    inline size_t capacity() const { return capacity_; }
+
+    /**
+     * \brief Forgets the content, the memory is kept
+     */
+    inline void clear() { size_ = 0; }
+
+    /**
+     * \brief Drops the first n bytes, the rest moves to the front
+     */
+    inline void erase(size_t n)
+    {
+        n = std::min(n, size_);
+        memmove(data_, data_ + n, size_ - n);
+        size_ -= n;
+    }
+
+private:
+    template <typename Endian>
+    friend struct GrowStream;
+
+    uint8_t* data_;
+    size_t size_;
+    size_t capacity_;
+};
+
+/**
+ * \brief Output stream appending to a GrowBuffer, so nothing has to be measured before serializing
+ *
+ * Meant to live on the stack for one message: the compiler then keeps the write position in registers like it does
+ * for a local OStream.  What was written is committed to the buffer when the stream goes away.  Numbers are written
+ * in the byte order Endian.
+ */
+template <typename Endian>
+struct GrowStream
+{
+    static const StreamType stream_type = stream_types::Output;
+    typedef Endian endian_type;
+
+    GrowStream(GrowBuffer& buffer)
+        : buffer_(buffer), begin_(buffer.data_), data_(buffer.data_ + buffer.size_), end_(buffer.data_ + buffer.capacity_)
+    {
+    }
+    ~GrowStream() { buffer_.size_ = size(); }
+
+    GrowStream(const GrowStream&) = delete;
+    GrowStream& operator=(const GrowStream&) = delete;
+
+    /**
+     * \brief Serialize an item to this stream
+     */
+    template <typename T>
+    ROS_FORCE_INLINE void next(const T& t)
+    {
+        serialize(*this, t);
+    }
+
+    template <typename T>
+    ROS_FORCE_INLINE GrowStream& operator<<(const T& t)
+    {
+        serialize(*this, t);
+        return *this;
+    }
+
+    /**
+     * \brief Appends len bytes and returns a pointer to them, valid until the stream grows again
+     */
+    ROS_FORCE_INLINE uint8_t* advance(uint32_t len)
+    {
+        uint8_t* old_data = data_;
+        data_ += len;
+        if (data_ > end_)
+        {
+            size_t size = static_cast<size_t>(old_data - begin_);
+            begin_ = grow(buffer_, size + len);
+            end_ = begin_ + buffer_.capacity();
+            old_data = begin_ + size;
+            data_ = old_data + len;
+        }
+        return old_data;
+    }
+
+    /**
+     * \brief Start of the buffer, including what was in it before this stream
+     */
+    inline uint8_t* getData() { return begin_; }
+    inline size_t size() const { return static_cast<size_t>(data_ - begin_); }
+
+private:
+    // out of line and without this, so the stream's address does not escape and the fast path stays in registers
+    __attribute__((noinline, cold)) static uint8_t* grow(GrowBuffer& buffer, size_t needed)
+    {
+        buffer.reserve(std::max(needed, buffer.capacity() * 2));
+        return buffer.getData();
+    }
+
+    GrowBuffer& buffer_;
+    uint8_t* begin_;
+    uint8_t* data_;
+    uint8_t* end_;
+};
+
+} // namespace serialization
+} // namespace ros
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <memory_resource>
+#include <new>
+
+namespace ros
+{
+
+/**
+ * \brief Memory for the strings and vectors of messages deserialized from one packet, released all at once
+ *
+ * Messages instantiated with MessageArena::Allocator (see ax::pmr::CustomMsgArray) and constructed with allocator()
+ * take their memory from one block by bumping a pointer, nothing is freed per string or vector.  reset() drops
+ * everything, so every message using the arena must be gone by then.  When a packet did not fit, the block grows
+ * to the size it needed on the next reset, after that packets of the same size do not allocate at all.
+ *
+ * demo code:
+ * ```
+ * ros::MessageArena arena;
+ * connection->parser().setArena(&arena); // reset after every ParserManager_packetFound
+ *
+ * void ParserManager_packetFound(...)
+ * {
+ *     ax::pmr::CustomMsgArray msg(arena.allocator());
+ *     from_buffer(msg, (const char*)pack, bytes);
+ * }
+ * ```
+ */
+class MessageArena
+{
+public:
+    typedef std::pmr::polymorphic_allocator<char> Allocator;
+
+    explicit MessageArena(size_t capacity = 64 * 1024)
+        : capacity_(capacity > 0 ? capacity : 1), buffer_(::operator new(capacity_)),
+          resource_(buffer_, capacity_, &upstream_)
+    {
+    }
+    ~MessageArena() { ::operator delete(buffer_); }
+
+    MessageArena(const MessageArena&) = delete;
+    MessageArena& operator=(const MessageArena&) = delete;
+
+    inline Allocator allocator() { return Allocator(&resource_); }
+    inline std::pmr::memory_resource* resource() { return &resource_; }
+    inline size_t capacity() const { return capacity_; }
+
+    /**
+     * \brief Releases everything allocated since the last reset
+     */
+    inline void reset()
+    {
+        resource_.release();
+        if (upstream_.bytes_ > 0)
+            grow(capacity_ + upstream_.bytes_);
+    }
+
+private:
+    // the overflow of a packet that did not fit into the block, counted so the block can grow to cover it
+    struct Upstream : public std::pmr::memory_resource
+    {
+        size_t bytes_ = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            bytes_ += bytes;
+            return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+        }
+
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override
+        {
+            std::pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+    };
+
+    // rebuilt in place so allocators handed out before stay valid
+    __attribute__((noinline, cold)) void grow(size_t capacity)
+    {
+        resource_.~monotonic_buffer_resource();
+        ::operator delete(buffer_);
+        capacity_ = capacity;
+        buffer_ = ::operator new(capacity_);
+        upstream_.bytes_ = 0;
+        new (&resource_) std::pmr::monotonic_buffer_resource(buffer_, capacity_, &upstream_);
+    }
+
+    size_t capacity_;
+    void* buffer_;
+    Upstream upstream_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
+
+} // namespace ros
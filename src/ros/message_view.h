@@ -0,0 +1,455 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "message_wrapper.h"
+
+namespace ros
+{
+namespace serialization
+{
+
+/**
+ * \brief Walks serialized data without storing anything, used to check bounds and find where fields start
+ *
+ * Unlike IStream it does not throw, ok() turns false on the first overrun and the walk stops advancing.
+ */
+struct SkipStream
+{
+    SkipStream(const uint8_t* data, uint32_t count) : data_(data), end_(data + count), ok_(true) {}
+
+    template <typename T>
+    ROS_FORCE_INLINE void next(const T& t);
+
+    ROS_FORCE_INLINE const uint8_t* advance(uint32_t len)
+    {
+        if (!ok_ || len > static_cast<size_t>(end_ - data_))
+        {
+            ok_ = false;
+            return NULL;
+        }
+        const uint8_t* old_data = data_;
+        data_ += len;
+        return old_data;
+    }
+
+    inline uint32_t readLength()
+    {
+        uint32_t len = 0;
+        const uint8_t* p = advance(4);
+        if (p != NULL)
+            memcpy(&len, p, 4);
+        return len;
+    }
+
+    inline bool ok() const { return ok_; }
+    inline const uint8_t* getData() const { return data_; }
+    inline uint32_t getLength() const { return static_cast<uint32_t>(end_ - data_); }
+
+private:
+    const uint8_t* data_;
+    const uint8_t* end_;
+    bool ok_;
+};
+
+/**
+ * \brief allInOne walks the fields of an object, the skip functions only need one to get at the field types
+ */
+template <typename T>
+inline const T& prototype()
+{
+    static const T t{};
+    return t;
+}
+
+template <typename T, class Enabled = void>
+struct HasAllInOne : public std::false_type
+{
+};
+
+template <typename T>
+struct HasAllInOne<T, decltype(Serializer<T>::template allInOne<SkipStream, const T&>(std::declval<SkipStream&>(),
+                                                                                     std::declval<const T&>()))>
+    : public std::true_type
+{
+};
+
+/**
+ * \brief Messages: skip every field
+ */
+template <typename T>
+inline typename std::enable_if<HasAllInOne<T>::value>::type skip(SkipStream& stream, const T& t)
+{
+    Serializer<T>::template allInOne<SkipStream, const T&>(stream, t);
+}
+
+/**
+ * \brief Everything else without a variable length: numbers, bool, enums, Time, Duration
+ */
+template <typename T>
+inline typename std::enable_if<!HasAllInOne<T>::value>::type skip(SkipStream& stream, const T& t)
+{
+    stream.advance(Serializer<T>::serializedLength(t));
+}
+
+template <class ContainerAllocator>
+inline void skip(SkipStream& stream, const std::basic_string<char, std::char_traits<char>, ContainerAllocator>&)
+{
+    stream.advance(stream.readLength());
+}
+
+template <typename T, class ContainerAllocator>
+inline void skip(SkipStream& stream, const std::vector<T, ContainerAllocator>&)
+{
+    uint32_t len = stream.readLength();
+    if (std::is_pod<T>::value || mt::IsFixedSize<T>::value)
+    {
+        uint64_t each = std::is_pod<T>::value ? sizeof(T) : serializationLength(prototype<T>());
+        uint64_t data_len = static_cast<uint64_t>(len) * each;
+        stream.advance(data_len > stream.getLength() ? stream.getLength() + 1 : static_cast<uint32_t>(data_len));
+        return;
+    }
+    for (uint32_t i = 0; i < len && stream.ok(); i++)
+        skip(stream, prototype<T>());
+}
+
+template <typename T, size_t N>
+inline void skip(SkipStream& stream, const std::array<T, N>& v)
+{
+    if (std::is_pod<T>::value || mt::IsFixedSize<T>::value)
+    {
+        stream.advance(std::is_pod<T>::value || N == 0 ? N * sizeof(T) : serializationLength(v));
+        return;
+    }
+    for (size_t i = 0; i < N && stream.ok(); i++)
+        skip(stream, v[i]);
+}
+
+template <typename T>
+ROS_FORCE_INLINE void SkipStream::next(const T& t)
+{
+    skip(*this, t);
+}
+
+/**
+ * \brief Identifies the type of a field, the address of each instantiation is unique
+ */
+typedef void (*FieldTag)();
+template <typename T>
+void fieldTag()
+{
+}
+
+/**
+ * \brief SkipStream that also records where each top level field starts and what type it has
+ */
+struct FieldStream : public SkipStream
+{
+    FieldStream(const uint8_t* data, uint32_t count, uint32_t* offsets, FieldTag* tags, size_t maxFields)
+        : SkipStream(data, count), begin_(data), offsets_(offsets), tags_(tags), maxFields_(maxFields), count_(0)
+    {
+    }
+
+    template <typename T>
+    ROS_FORCE_INLINE void next(const T& t)
+    {
+        if (count_ < maxFields_)
+        {
+            offsets_[count_] = static_cast<uint32_t>(getData() - begin_);
+            tags_[count_] = &fieldTag<T>;
+        }
+        count_++;
+        skip(static_cast<SkipStream&>(*this), t);
+    }
+
+    inline size_t getFieldCount() const { return count_; }
+
+private:
+    const uint8_t* begin_;
+    uint32_t* offsets_;
+    FieldTag* tags_;
+    size_t maxFields_;
+    size_t count_;
+};
+
+} // namespace serialization
+} // namespace ros
+
+namespace ax
+{
+
+#define MESSAGE_VIEW_MAX_FIELDS 32
+
+template <typename T>
+class MessageView;
+template <typename T>
+class ListView;
+
+/**
+Array of simple types inside a received buffer. The bytes are not aligned, elements are copied out one by one.
+*/
+template <typename T>
+class ArrayView
+{
+public:
+    ArrayView() : m_data(NULL), m_size(0) {}
+    ArrayView(const uint8_t* data, uint32_t size) : m_data(data), m_size(size) {}
+
+    uint32_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    const uint8_t* data() const { return m_data; }
+
+    T operator[](size_t i) const
+    {
+        T v;
+        memcpy(&v, m_data + i * sizeof(T), sizeof(T));
+        return v;
+    }
+
+private:
+    const uint8_t* m_data;
+    uint32_t m_size;
+};
+
+/// what MessageView::get returns for a field of type T
+template <typename T, class Enabled = void>
+struct FieldView
+{
+    // numbers, enums, Time and other fixed-size values are small enough to copy
+    typedef T type;
+    static type make(const uint8_t* bytes, uint32_t len)
+    {
+        T v;
+        ros::serialization::IStream stream(const_cast<uint8_t*>(bytes), len);
+        ros::serialization::deserialize(stream, v);
+        return v;
+    }
+};
+
+template <typename T>
+struct FieldView<T, typename std::enable_if<ros::serialization::HasAllInOne<T>::value>::type>
+{
+    typedef MessageView<T> type;
+    static type make(const uint8_t* bytes, uint32_t len)
+    {
+        type view;
+        view.parsePayload(bytes, len);
+        return view;
+    }
+};
+
+template <class ContainerAllocator>
+struct FieldView<std::basic_string<char, std::char_traits<char>, ContainerAllocator>>
+{
+    typedef std::string_view type;
+    static type make(const uint8_t* bytes, uint32_t len) { return type((const char*)bytes + 4, len - 4); }
+};
+
+template <typename T, class ContainerAllocator>
+struct FieldView<std::vector<T, ContainerAllocator>, typename std::enable_if<std::is_pod<T>::value>::type>
+{
+    typedef ArrayView<T> type;
+    static type make(const uint8_t* bytes, uint32_t)
+    {
+        uint32_t count;
+        memcpy(&count, bytes, 4);
+        return type(bytes + 4, count);
+    }
+};
+
+template <typename T, class ContainerAllocator>
+struct FieldView<std::vector<T, ContainerAllocator>, typename std::enable_if<!std::is_pod<T>::value>::type>
+{
+    typedef ListView<T> type;
+    static type make(const uint8_t* bytes, uint32_t len)
+    {
+        uint32_t count;
+        memcpy(&count, bytes, 4);
+        return type(bytes + 4, len - 4, count);
+    }
+};
+
+template <typename T, size_t N>
+struct FieldView<std::array<T, N>, typename std::enable_if<std::is_pod<T>::value>::type>
+{
+    typedef ArrayView<T> type;
+    static type make(const uint8_t* bytes, uint32_t) { return type(bytes, N); }
+};
+
+template <typename T, size_t N>
+struct FieldView<std::array<T, N>, typename std::enable_if<!std::is_pod<T>::value>::type>
+{
+    typedef ListView<T> type;
+    static type make(const uint8_t* bytes, uint32_t len) { return type(bytes, len, N); }
+};
+
+/**
+Read-only access to a serialized message where it lies, e.g. the pack handed to ParserManager_packetFound.
+parse() checks the wrapper and walks the payload once; after that fields are read without allocating: strings
+come back as std::string_view, vectors of simple types as ArrayView, vectors of messages as ListView and nested
+messages as MessageView. Fields are numbered in the order allInOne lists them, the type passed to get() must be
+the field's declared type.
+
+Nothing is copied, the view is only valid as long as the buffer it points into.
+
+demo code:
+```
+MessageView<CustomMsgArray> view;
+if (view.parse((const char*)pack, bytes))
+{
+    for (const MessageView<CustomMsg>& item : view.get<std::vector<CustomMsg>>(1))
+        printf("%.*s\n", (int)item.get<std::string>(0).size(), item.get<std::string>(0).data());
+}
+```
+*/
+template <typename T>
+class MessageView
+{
+public:
+    MessageView() = default;
+
+    /// checks magic header, length and crc like from_buffer, then the payload
+    bool parse(const char* buffer, size_t buffer_size)
+    {
+        m_fieldCount = 0;
+        m_data = NULL;
+        if (buffer_size < sizeof(WrapperHeader) || buffer[0] != T::magic_header[0] || buffer[1] != T::magic_header[1])
+            return false;
+
+        WrapperHeader wrapper_header = read_wrapper_header<ros::serialization::LittleEndian>((const uint8_t*)buffer);
+        if (buffer_size - sizeof(WrapperHeader) < wrapper_header.data_length)
+            return false;
+
+        const uint8_t* payload = (const uint8_t*)buffer + sizeof(WrapperHeader);
+        if (calculateCRC16(payload, wrapper_header.data_length) != wrapper_header.crc16)
+            return false;
+        return parsePayload(payload, wrapper_header.data_length);
+    }
+
+    /// a serialized T without WrapperHeader, bytes after the message are ignored
+    bool parsePayload(const uint8_t* data, uint32_t size)
+    {
+        uint32_t used;
+        return walk(data, size, &used);
+    }
+
+    bool isValid() const { return m_data != NULL; }
+    size_t fieldCount() const { return m_fieldCount; }
+    /// serialized size of the message
+    uint32_t size() const { return m_offsets[m_fieldCount]; }
+    const uint8_t* data() const { return m_data; }
+
+    template <typename F>
+    typename FieldView<F>::type get(size_t index) const
+    {
+        if (index >= m_fieldCount || m_tags[index] != &ros::serialization::fieldTag<F>)
+        {
+            assert(!"MessageView::get: no such field or wrong type");
+            return typename FieldView<F>::type();
+        }
+        return FieldView<F>::make(m_data + m_offsets[index], m_offsets[index + 1] - m_offsets[index]);
+    }
+
+    /// owning copy, for when a message has to outlive the buffer
+    bool toMessage(T& msg) const
+    {
+        if (!isValid())
+            return false;
+        ros::serialization::IStream stream(const_cast<uint8_t*>(m_data), size());
+        ros::serialization::deserialize(stream, msg);
+        return true;
+    }
+
+private:
+    friend class ListView<T>;
+
+    bool walk(const uint8_t* data, uint32_t size, uint32_t* used)
+    {
+        m_data = NULL;
+        m_fieldCount = 0;
+        ros::serialization::FieldStream stream(data, size, m_offsets, m_tags, MESSAGE_VIEW_MAX_FIELDS);
+        const T& prototype = ros::serialization::prototype<T>();
+        ros::serialization::Serializer<T>::template allInOne<ros::serialization::FieldStream, const T&>(stream,
+                                                                                                       prototype);
+        if (!stream.ok() || stream.getFieldCount() > MESSAGE_VIEW_MAX_FIELDS)
+            return false;
+
+        m_fieldCount = stream.getFieldCount();
+        *used = size - stream.getLength();
+        m_offsets[m_fieldCount] = *used;
+        m_data = data;
+        return true;
+    }
+
+private:
+    const uint8_t* m_data = NULL;
+    size_t m_fieldCount = 0;
+    // field i is [m_offsets[i], m_offsets[i + 1]) of m_data
+    uint32_t m_offsets[MESSAGE_VIEW_MAX_FIELDS + 1] = {0};
+    ros::serialization::FieldTag m_tags[MESSAGE_VIEW_MAX_FIELDS] = {};
+};
+
+/**
+Sequence of messages inside a received buffer. Elements have no fixed size, iterating walks them front to back.
+*/
+template <typename T>
+class ListView
+{
+public:
+    class iterator
+    {
+    public:
+        iterator(const uint8_t* data, uint32_t bytes, uint32_t left) : m_data(data), m_bytes(bytes), m_left(left)
+        {
+            load();
+        }
+
+        const MessageView<T>& operator*() const { return m_current; }
+        const MessageView<T>* operator->() const { return &m_current; }
+        bool operator!=(const iterator& other) const { return m_left != other.m_left; }
+        iterator& operator++()
+        {
+            m_data += m_used;
+            m_bytes -= m_used;
+            m_left--;
+            load();
+            return *this;
+        }
+
+    private:
+        void load()
+        {
+            m_used = 0;
+            // the parent's walk already checked the bounds, this only finds the fields again
+            if (m_left > 0 && !m_current.walk(m_data, m_bytes, &m_used))
+                m_left = 0;
+        }
+
+        const uint8_t* m_data;
+        uint32_t m_bytes;
+        uint32_t m_left;
+        uint32_t m_used = 0;
+        MessageView<T> m_current;
+    };
+
+    ListView() : m_data(NULL), m_bytes(0), m_size(0) {}
+    ListView(const uint8_t* data, uint32_t bytes, uint32_t size) : m_data(data), m_bytes(bytes), m_size(size) {}
+
+    uint32_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() const { return iterator(m_data, m_bytes, m_size); }
+    iterator end() const { return iterator(NULL, 0, 0); }
+
+private:
+    const uint8_t* m_data;
+    uint32_t m_bytes;
+    uint32_t m_size;
+};
+
+} // namespace ax
@@ -1,9 +1,12 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
 #include "ros_serialization.h"
+#include "gather_stream.h"
+#include "grow_stream.h"
 #include "../shared/crc.h"
 
 namespace ax
@@ -16,8 +19,49 @@ struct __attribute__((packed)) WrapperHeader
     uint16_t crc16;
 };
 
-template <typename MessageType>
-void to_buffer(const MessageType& msg, std::vector<char>& buffer)
+/**
+Writes the header at data with data_length and crc16 in the byte order Endian, the one of the payload behind it.
+*/
+template <typename Endian>
+inline void write_wrapper_header(uint8_t* data, const char* magic, uint32_t data_length, uint16_t crc16)
+{
+    typedef ros::serialization::RawOStream<Endian> Stream;
+    data[0] = (uint8_t)magic[0];
+    data[1] = (uint8_t)magic[1];
+    ros::serialization::storeValue<Stream>(data + offsetof(WrapperHeader, data_length), data_length);
+    ros::serialization::storeValue<Stream>(data + offsetof(WrapperHeader, crc16), crc16);
+}
+
+/// the header at data with its numbers in host order
+template <typename Endian>
+inline WrapperHeader read_wrapper_header(const uint8_t* data)
+{
+    typedef ros::serialization::RawIStream<Endian> Stream;
+    uint32_t data_length;
+    uint16_t crc16;
+    ros::serialization::loadValue<Stream>(data_length, data + offsetof(WrapperHeader, data_length));
+    ros::serialization::loadValue<Stream>(crc16, data + offsetof(WrapperHeader, crc16));
+
+    WrapperHeader wrapper_header;
+    wrapper_header.magic[0] = (char)data[0];
+    wrapper_header.magic[1] = (char)data[1];
+    wrapper_header.data_length = data_length;
+    wrapper_header.crc16 = crc16;
+    return wrapper_header;
+}
+
+/**
+Appends the wrapped message to buffer. Buffer is a std::vector<char> or anything with the same size(), resize() and
+operator[], like PooledBuffer which takes a send buffer from BufferPool instead of the heap.
+
+The payload and the header's numbers are little endian. For a big endian peer pass the byte order, the read side
+passes the same to from_buffer:
+```
+to_buffer(msg, buffer, ros::serialization::BigEndian());
+```
+*/
+template <typename MessageType, typename Buffer = std::vector<char>, typename Endian = ros::serialization::LittleEndian>
+void to_buffer(const MessageType& msg, Buffer& buffer, Endian = Endian())
 {
     // buffer: old data + (WrapperHeader + new msg data)
     size_t header_size = sizeof(WrapperHeader);
@@ -25,20 +69,76 @@ void to_buffer(const MessageType& msg, std::vector<char>& buffer)
     size_t old_size = buffer.size();
     buffer.resize(old_size + sizeof(WrapperHeader) + msg_length);
 
-    WrapperHeader wrapper_header;
-    wrapper_header.magic[0] = MessageType::magic_header[0];
-    wrapper_header.magic[1] = MessageType::magic_header[1];
-    wrapper_header.data_length = msg_length;
+    ros::serialization::OStream<Endian> stream((uint8_t*)&buffer[old_size + header_size], msg_length);
+    ros::serialization::serialize(stream, msg);
 
-    ros::serialization::OStream stream((uint8_t*)&buffer[old_size + header_size], msg_length);
+    uint16_t crc16 = calculateCRC16(&buffer[old_size + header_size], msg_length);
+    write_wrapper_header<Endian>((uint8_t*)&buffer[old_size], MessageType::magic_header, msg_length, crc16);
+}
+
+/**
+Like to_buffer, in one pass: the message is serialized straight into the buffer, which grows as needed, and the
+length and crc are patched into the header afterwards. Reuse the buffer and nothing is allocated or measured.
+
+demo code:
+```
+ros::serialization::GrowBuffer buffer;
+buffer.clear();
+to_stream(msg, buffer);
+tcpStream.write(buffer.getData(), buffer.size());
+```
+*/
+template <typename MessageType, typename Endian = ros::serialization::LittleEndian>
+void to_stream(const MessageType& msg, ros::serialization::GrowBuffer& buffer, Endian = Endian())
+{
+    // buffer: old data + (WrapperHeader + new msg data)
+    ros::serialization::GrowStream<Endian> stream(buffer);
+    size_t header_offset = stream.size();
+    stream.advance(sizeof(WrapperHeader));
     ros::serialization::serialize(stream, msg);
 
-    wrapper_header.crc16 = calculateCRC16(&buffer[old_size + header_size], msg_length);
-    memcpy(&buffer[old_size], &wrapper_header, sizeof(wrapper_header));
+    uint32_t data_length = (uint32_t)(stream.size() - header_offset - sizeof(WrapperHeader));
+
+    // the payload was just written and is still in cache, one pass over it beats a crc update per field
+    const uint8_t* payload = stream.getData() + header_offset + sizeof(WrapperHeader);
+    uint16_t crc16 = calculateCRC16(payload, data_length);
+    write_wrapper_header<Endian>(stream.getData() + header_offset, MessageType::magic_header, data_length, crc16);
+}
+
+/**
+Like to_buffer, but without copying large strings and vectors: the wrapper header and small fields go into the
+stream's scratch buffer, the rest is referenced in place. Send stream.iov() with TcpStream::writev while msg is
+still alive and unchanged.
+
+demo code:
+```
+ros::serialization::GatherStream stream;
+to_iovec(msg, stream);
+tcpStream.writev(&stream.iov()[0], (int)stream.iov().size());
+```
+*/
+template <typename MessageType, typename Endian>
+void to_iovec(const MessageType& msg, ros::serialization::GatherStream<Endian>& stream)
+{
+    // stream: old data + (WrapperHeader + new msg data)
+    size_t header_offset = stream.scratchSize();
+    stream.advance(sizeof(WrapperHeader));
+    size_t msg_offset = stream.size();
+    ros::serialization::serialize(stream, msg);
+
+    uint32_t data_length = (uint32_t)(stream.size() - msg_offset);
+
+    uint16_t crc = CRC16_INIT;
+    stream.visit(msg_offset, [&crc](const uint8_t* data, size_t len) { crc = updateCRC16(crc, data, len); });
+    write_wrapper_header<Endian>(stream.scratch(header_offset), MessageType::magic_header, data_length, crc);
 }
 
-template <typename MessageType>
-bool from_buffer(MessageType& msg, const char* buffer, size_t buffer_size)
+/**
+Checks magic header, length and crc and deserializes the payload. Endian is the byte order the sender used, see
+to_buffer.
+*/
+template <typename MessageType, typename Endian = ros::serialization::LittleEndian>
+bool from_buffer(MessageType& msg, const char* buffer, size_t buffer_size, Endian = Endian())
 {
     if (buffer[0] != MessageType::magic_header[0] || buffer[1] != MessageType::magic_header[1])
     {
@@ -50,8 +150,8 @@ bool from_buffer(MessageType& msg, const char* buffer, size_t buffer_size)
         return false;
     }
 
-    WrapperHeader* wrapper_header = (WrapperHeader*)buffer;
-    if (buffer_size < sizeof(WrapperHeader) + wrapper_header->data_length)
+    WrapperHeader wrapper_header = read_wrapper_header<Endian>((const uint8_t*)buffer);
+    if (buffer_size < sizeof(WrapperHeader) + wrapper_header.data_length)
     {
         return false;
     }
@@ -61,13 +161,13 @@ bool from_buffer(MessageType& msg, const char* buffer, size_t buffer_size)
         return false;
     }
 
-    uint16_t crc16 = calculateCRC16(buffer + sizeof(WrapperHeader), wrapper_header->data_length);
-    if (crc16 != wrapper_header->crc16)
+    uint16_t crc16 = calculateCRC16(buffer + sizeof(WrapperHeader), wrapper_header.data_length);
+    if (crc16 != wrapper_header.crc16)
     {
         return false;
     }
 
-    ros::serialization::IStream istream((uint8_t*)(buffer + sizeof(WrapperHeader)), wrapper_header->data_length);
+    ros::serialization::IStream<Endian> istream((uint8_t*)(buffer + sizeof(WrapperHeader)), wrapper_header.data_length);
     ros::serialization::deserialize(istream, msg);
 
     return true;
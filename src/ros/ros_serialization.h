@@ -29,8 +29,11 @@
 #ifndef AXCPP_SERIALIZATION_H
 #define AXCPP_SERIALIZATION_H
 
+#include <array>
 #include <vector>
 #include <map>
+#include <memory>
+#include <cstdint>
 #include <cstring>
 #include <type_traits>
 #include <ostream>
@@ -41,6 +44,7 @@
 #include <boost/mpl/not.hpp>
 
 #include "time.h"
+#include "../shared/byte_swap.h"
 
 #define ROS_FORCE_INLINE inline
 
@@ -77,6 +81,16 @@ struct IsFixedSize : public FalseType
 {
 };
 
+/**
+ * \brief A simple datatype is a fixed-size one whose memory layout is its serialized form, so it is memcpy'd as a
+ * whole.  Its members must be declared in the order allInOne lists them; padding is caught at compile time, a
+ * different order is not.
+ */
+template <typename M>
+struct IsSimple : public FalseType
+{
+};
+
 #define ROSLIB_CREATE_SIMPLE_TRAITS(Type)                                                                              \
     template <>                                                                                                        \
     struct IsFixedSize<Type> : public TrueType                                                                         \
@@ -112,7 +126,7 @@ struct IsFixedSize<bool> : public TrueType
  * The allinone method has the form:
 \verbatim
 template<typename Stream, typename T>
-inline static void allInOne(Stream& stream, T t)
+constexpr static void allInOne(Stream& stream, T&& t)
 {
   stream.next(t.a);
   stream.next(t.b);
@@ -121,26 +135,30 @@ inline static void allInOne(Stream& stream, T t)
 \endverbatim
  *
  * The only guarantee given is that Stream::next(T) is defined.
+ *
+ * Take t as T&&: write and serializedLength pass const T&, read passes T& so the caller's object is filled, and a
+ * call with a deduced type binds to the object instead of copying it.
+ *
+ * Declare it constexpr: for types marked IsFixedSize the length is computed at compile time by walking a
+ * value-initialized T (see FixedLength).
  */
 #define ROS_DECLARE_ALLINONE_SERIALIZER                                                                                \
     template <typename Stream, typename T>                                                                             \
     inline static void write(Stream& stream, const T& t)                                                               \
     {                                                                                                                  \
-        allInOne<Stream, const T&>(stream, t);                                                                         \
+        AllInOne<T>::template write<Serializer>(stream, t);                                                            \
     }                                                                                                                  \
                                                                                                                        \
     template <typename Stream, typename T>                                                                             \
     inline static void read(Stream& stream, T& t)                                                                      \
     {                                                                                                                  \
-        allInOne<Stream, T&>(stream, t);                                                                               \
+        AllInOne<T>::template read<Serializer>(stream, t);                                                             \
     }                                                                                                                  \
                                                                                                                        \
     template <typename T>                                                                                              \
     inline static uint32_t serializedLength(const T& t)                                                                \
     {                                                                                                                  \
-        LStream stream;                                                                                                \
-        allInOne<LStream, const T&>(stream, t);                                                                        \
-        return stream.getLength();                                                                                     \
+        return AllInOne<T>::template serializedLength<Serializer>(t);                                                  \
     }
 
 namespace ros
@@ -225,6 +243,122 @@ inline uint32_t serializationLength(const T& t)
     return Serializer<T>::serializedLength(t);
 }
 
+/**
+ * \brief Byte order policies for the streams.  The wire is little endian unless a stream is given BigEndian; when
+ * the order matches the host's the swaps are compiled out and the stream is the same as without a policy.
+ */
+struct LittleEndian
+{
+    static const bool little = true;
+};
+
+struct BigEndian
+{
+    static const bool little = false;
+};
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+typedef BigEndian HostEndian;
+#else
+typedef LittleEndian HostEndian;
+#endif
+
+/**
+ * \brief Byte order of a stream: its endian_type, little endian for streams that do not declare one
+ */
+template <typename Stream, class Enabled = void>
+struct StreamEndian
+{
+    typedef LittleEndian type;
+};
+
+template <typename Stream>
+struct StreamEndian<Stream, std::void_t<typename Stream::endian_type>>
+{
+    typedef typename Stream::endian_type type;
+};
+
+/**
+ * \brief True if the bytes of every word written to or read from Stream are reversed
+ */
+template <typename Stream>
+struct SwapsBytes : public std::integral_constant<bool, StreamEndian<Stream>::type::little != HostEndian::little>
+{
+};
+
+/**
+ * \brief Unsigned integer of the same size as a number, which __builtin_bswap works on
+ */
+template <size_t Size>
+struct WireWord;
+
+template <>
+struct WireWord<1>
+{
+    typedef uint8_t type;
+    static type swap(type w) { return w; }
+};
+
+template <>
+struct WireWord<2>
+{
+    typedef uint16_t type;
+    static type swap(type w) { return __builtin_bswap16(w); }
+};
+
+template <>
+struct WireWord<4>
+{
+    typedef uint32_t type;
+    static type swap(type w) { return __builtin_bswap32(w); }
+};
+
+template <>
+struct WireWord<8>
+{
+    typedef uint64_t type;
+    static type swap(type w) { return __builtin_bswap64(w); }
+};
+
+/**
+ * \brief Stores a number at data in the byte order of Stream.  Swapped as an integer, so a float whose swapped
+ * bytes read as a signaling NaN is never loaded as one.
+ */
+template <typename Stream, typename T>
+ROS_FORCE_INLINE void storeValue(uint8_t* data, const T v)
+{
+    typedef WireWord<sizeof(T)> Word;
+    typename Word::type w;
+    memcpy(&w, &v, sizeof(v));
+    if (SwapsBytes<Stream>::value)
+        w = Word::swap(w);
+    memcpy(data, &w, sizeof(w));
+}
+
+/**
+ * \brief Loads a number stored in the byte order of Stream from data
+ */
+template <typename Stream, typename T>
+ROS_FORCE_INLINE void loadValue(T& v, const uint8_t* data)
+{
+    typedef WireWord<sizeof(T)> Word;
+    typename Word::type w;
+    memcpy(&w, data, sizeof(w));
+    if (SwapsBytes<Stream>::value)
+        w = Word::swap(w);
+    memcpy(&v, &w, sizeof(v));
+}
+
+/**
+ * \brief Write a block of raw bytes.  Streams that can reference memory instead of copying it (GatherStream)
+ * overload this.
+ */
+template <typename Stream>
+inline void writeBytes(Stream& stream, const void* data, uint32_t len)
+{
+    memcpy(stream.advance(len), data, len);
+}
+
 #define ROS_CREATE_SIMPLE_SERIALIZER(Type)                                                                             \
     template <>                                                                                                        \
     struct Serializer<Type>                                                                                            \
@@ -232,13 +366,13 @@ inline uint32_t serializationLength(const T& t)
         template <typename Stream>                                                                                     \
         inline static void write(Stream& stream, const Type v)                                                         \
         {                                                                                                              \
-            memcpy(stream.advance(sizeof(v)), &v, sizeof(v));                                                          \
+            storeValue<Stream>(stream.advance(sizeof(v)), v);                                                          \
         }                                                                                                              \
                                                                                                                        \
         template <typename Stream>                                                                                     \
         inline static void read(Stream& stream, Type& v)                                                               \
         {                                                                                                              \
-            memcpy(&v, stream.advance(sizeof(v)), sizeof(v));                                                          \
+            loadValue<Stream>(v, stream.advance(sizeof(v)));                                                           \
         }                                                                                                              \
                                                                                                                        \
         inline static uint32_t serializedLength(const Type&)                                                           \
@@ -298,7 +432,7 @@ struct Serializer<std::basic_string<char, std::char_traits<char>, ContainerAlloc
 
         if (len > 0)
         {
-            memcpy(stream.advance(static_cast<uint32_t>(len)), str.data(), len);
+            writeBytes(stream, str.data(), static_cast<uint32_t>(len));
         }
     }
 
@@ -309,7 +443,8 @@ struct Serializer<std::basic_string<char, std::char_traits<char>, ContainerAlloc
         stream.next(len);
         if (len > 0)
         {
-            str = StringType(reinterpret_cast<char*>(stream.advance(len)), len);
+            // assign keeps the string's memory when a message object is reused
+            str.assign(reinterpret_cast<char*>(stream.advance(len)), len);
         }
         else
         {
@@ -366,6 +501,11 @@ struct Serializer<ros::Duration>
     inline static uint32_t serializedLength(const ros::Duration&) { return 8; }
 };
 
+template <typename T>
+struct FixedArray;
+template <typename T>
+struct WireWords;
+
 /**
  * \brief Vector serializer.  Default implementation does nothing
  */
@@ -380,7 +520,7 @@ struct VectorSerializer
 template <typename T, class ContainerAllocator>
 struct VectorSerializer<T, ContainerAllocator, typename std::enable_if<!mt::IsFixedSize<T>::value>::type>
 {
-    typedef std::vector<T, typename ContainerAllocator::template rebind<T>::other> VecType;
+    typedef std::vector<T, typename std::allocator_traits<ContainerAllocator>::template rebind_alloc<T>> VecType;
     typedef typename VecType::iterator IteratorType;
     typedef typename VecType::const_iterator ConstIteratorType;
 
@@ -430,7 +570,7 @@ struct VectorSerializer<T, ContainerAllocator, typename std::enable_if<!mt::IsFi
 template <typename T, class ContainerAllocator>
 struct VectorSerializer<T, ContainerAllocator, typename std::enable_if<std::is_pod<T>::value>::type>
 {
-    typedef std::vector<T, typename ContainerAllocator::template rebind<T>::other> VecType;
+    typedef std::vector<T, typename std::allocator_traits<ContainerAllocator>::template rebind_alloc<T>> VecType;
     typedef typename VecType::iterator IteratorType;
     typedef typename VecType::const_iterator ConstIteratorType;
 
@@ -441,8 +581,7 @@ struct VectorSerializer<T, ContainerAllocator, typename std::enable_if<std::is_p
         stream.next(len);
         if (!v.empty())
         {
-            const uint32_t data_len = len * static_cast<uint32_t>(sizeof(T));
-            memcpy(stream.advance(data_len), &v.front(), data_len);
+            FixedArray<T>::write(stream, &v.front(), len);
         }
     }
 
@@ -451,18 +590,19 @@ struct VectorSerializer<T, ContainerAllocator, typename std::enable_if<std::is_p
     {
         uint32_t len;
         stream.next(len);
-        v.resize(len);
 
+        // bounds checked before the resize, a corrupt length throws instead of allocating
+        uint8_t* data = stream.advance(FixedArray<T>::byteLength(len));
+        v.resize(len);
         if (len > 0)
         {
-            const uint32_t data_len = static_cast<uint32_t>(sizeof(T)) * len;
-            memcpy(static_cast<void*>(&v.front()), stream.advance(data_len), data_len);
+            FixedArray<T>::template read<Stream>(data, &v.front(), len);
         }
     }
 
     inline static uint32_t serializedLength(const VecType& v)
     {
-        return 4 + v.size() * static_cast<uint32_t>(sizeof(T));
+        return 4 + static_cast<uint32_t>(v.size()) * FixedArray<T>::elementLength();
     }
 };
 
@@ -473,19 +613,18 @@ template <typename T, class ContainerAllocator>
 struct VectorSerializer<T, ContainerAllocator,
                         typename std::enable_if<mpl::and_<mt::IsFixedSize<T>, mpl::not_<std::is_pod<T>>>::value>::type>
 {
-    typedef std::vector<T, typename ContainerAllocator::template rebind<T>::other> VecType;
+    typedef std::vector<T, typename std::allocator_traits<ContainerAllocator>::template rebind_alloc<T>> VecType;
     typedef typename VecType::iterator IteratorType;
     typedef typename VecType::const_iterator ConstIteratorType;
 
     template <typename Stream>
     inline static void write(Stream& stream, const VecType& v)
     {
-        stream.next(static_cast<uint32_t>(v.size()));
-        ConstIteratorType it = v.begin();
-        ConstIteratorType end = v.end();
-        for (; it != end; ++it)
+        uint32_t len = static_cast<uint32_t>(v.size());
+        stream.next(len);
+        if (len > 0)
         {
-            stream.next(*it);
+            FixedArray<T>::write(stream, &v.front(), len);
         }
     }
 
@@ -494,12 +633,11 @@ struct VectorSerializer<T, ContainerAllocator,
     {
         uint32_t len;
         stream.next(len);
+        uint8_t* data = stream.advance(FixedArray<T>::byteLength(len));
         v.resize(len);
-        IteratorType it = v.begin();
-        IteratorType end = v.end();
-        for (; it != end; ++it)
+        if (len > 0)
         {
-            stream.next(*it);
+            FixedArray<T>::template read<Stream>(data, &v.front(), len);
         }
     }
 
@@ -610,18 +748,22 @@ struct ArraySerializer<T, N, typename std::enable_if<std::is_pod<T>::value>::typ
     template <typename Stream>
     inline static void write(Stream& stream, const ArrayType& v)
     {
-        const uint32_t data_len = N * sizeof(T);
-        memcpy(stream.advance(data_len), &v.front(), data_len);
+        if (N > 0)
+        {
+            FixedArray<T>::write(stream, v.data(), N);
+        }
     }
 
     template <typename Stream>
     inline static void read(Stream& stream, ArrayType& v)
     {
-        const uint32_t data_len = N * sizeof(T);
-        memcpy(&v.front(), stream.advance(data_len), data_len);
+        if (N > 0)
+        {
+            FixedArray<T>::template read<Stream>(stream.advance(FixedArray<T>::byteLength(N)), v.data(), N);
+        }
     }
 
-    inline static uint32_t serializedLength(const ArrayType&) { return N * sizeof(T); }
+    inline static uint32_t serializedLength(const ArrayType&) { return N * FixedArray<T>::elementLength(); }
 };
 
 /**
@@ -638,22 +780,18 @@ struct ArraySerializer<T, N,
     template <typename Stream>
     inline static void write(Stream& stream, const ArrayType& v)
     {
-        ConstIteratorType it = v.begin();
-        ConstIteratorType end = v.end();
-        for (; it != end; ++it)
+        if (N > 0)
         {
-            stream.next(*it);
+            FixedArray<T>::write(stream, v.data(), N);
         }
     }
 
     template <typename Stream>
     inline static void read(Stream& stream, ArrayType& v)
     {
-        IteratorType it = v.begin();
-        IteratorType end = v.end();
-        for (; it != end; ++it)
+        if (N > 0)
         {
-            stream.next(*it);
+            FixedArray<T>::template read<Stream>(stream.advance(FixedArray<T>::byteLength(N)), v.data(), N);
         }
     }
 
@@ -742,11 +880,13 @@ private:
 };
 
 /**
- * \brief Input stream
+ * \brief Input stream, reading numbers in the byte order Endian
  */
+template <typename Endian = LittleEndian>
 struct IStream : public Stream
 {
     static const StreamType stream_type = stream_types::Input;
+    typedef Endian endian_type;
 
     IStream(uint8_t* data, uint32_t count) : Stream(data, count) {}
 
@@ -768,11 +908,13 @@ struct IStream : public Stream
 };
 
 /**
- * \brief Output stream
+ * \brief Output stream, writing numbers in the byte order Endian
  */
+template <typename Endian = LittleEndian>
 struct OStream : public Stream
 {
     static const StreamType stream_type = stream_types::Output;
+    typedef Endian endian_type;
 
     OStream(uint8_t* data, uint32_t count) : Stream(data, count) {}
 
@@ -833,6 +975,421 @@ private:
     uint32_t count_;
 };
 
+/**
+ * \brief Serialized length of a fixed-size type, computed at compile time
+ *
+ * allInOne walks a value-initialized T with FixedLengthStream.  Strings and vectors stop the compilation, a type
+ * holding one must not be marked IsFixedSize.
+ */
+struct FixedLengthStream;
+
+template <typename T>
+constexpr typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, uint32_t>::type
+fixedLength(const T&)
+{
+    return sizeof(T);
+}
+
+constexpr uint32_t fixedLength(const ros::Time&)
+{
+    return 8;
+}
+
+constexpr uint32_t fixedLength(const ros::Duration&)
+{
+    return 8;
+}
+
+template <typename T>
+constexpr typename std::enable_if<std::is_class<T>::value, uint32_t>::type fixedLength(const T& t);
+
+template <typename T, size_t N>
+constexpr uint32_t fixedLength(const std::array<T, N>& t)
+{
+    return N == 0 ? 0 : static_cast<uint32_t>(N) * fixedLength(t[0]);
+}
+
+template <class ContainerAllocator>
+constexpr uint32_t fixedLength(const std::basic_string<char, std::char_traits<char>, ContainerAllocator>&)
+{
+    static_assert(sizeof(ContainerAllocator) == 0, "a type marked IsFixedSize holds a std::string");
+    return 0;
+}
+
+template <typename T, class ContainerAllocator>
+constexpr uint32_t fixedLength(const std::vector<T, ContainerAllocator>&)
+{
+    static_assert(sizeof(T) == 0, "a type marked IsFixedSize holds a std::vector");
+    return 0;
+}
+
+struct FixedLengthStream
+{
+    static const StreamType stream_type = stream_types::Length;
+
+    constexpr FixedLengthStream() : count_(0) {}
+
+    template <typename T>
+    constexpr void next(const T& t)
+    {
+        count_ += fixedLength(t);
+    }
+
+    constexpr uint32_t getLength() const { return count_; }
+
+private:
+    uint32_t count_;
+};
+
+template <typename T>
+constexpr typename std::enable_if<std::is_class<T>::value, uint32_t>::type fixedLength(const T& t)
+{
+    FixedLengthStream stream;
+    Serializer<T>::template allInOne<FixedLengthStream, const T&>(stream, t);
+    return stream.getLength();
+}
+
+template <typename T>
+struct FixedLength
+{
+    static_assert(mt::IsFixedSize<T>::value, "only fixed-size types have a compile time length");
+    // instantiates the walk first, so a wrongly marked type fails with the message from fixedLength
+    static constexpr uint32_t (*walk)(const T&) = &fixedLength<T>;
+    static constexpr uint32_t value = walk(T{});
+};
+
+/**
+ * \brief Size of the words a fixed-size type is made of: sizeof for numbers and enums, 4 for Time and Duration, 0
+ * if they differ in size
+ *
+ * A simple type of one word size is swapped as a whole when a stream's byte order is not the host's.
+ */
+struct WordSizeStream;
+
+template <typename T>
+constexpr typename std::enable_if<std::is_arithmetic<T>::value || std::is_enum<T>::value, uint32_t>::type
+wordSize(const T&)
+{
+    return sizeof(T);
+}
+
+constexpr uint32_t wordSize(const ros::Time&)
+{
+    return 4;
+}
+
+constexpr uint32_t wordSize(const ros::Duration&)
+{
+    return 4;
+}
+
+template <typename T>
+constexpr typename std::enable_if<std::is_class<T>::value, uint32_t>::type wordSize(const T& t);
+
+template <typename T, size_t N>
+constexpr uint32_t wordSize(const std::array<T, N>& t)
+{
+    return N == 0 ? 0 : wordSize(t[0]);
+}
+
+struct WordSizeStream
+{
+    static const StreamType stream_type = stream_types::Length;
+
+    constexpr WordSizeStream() : size_(0), mixed_(false) {}
+
+    template <typename T>
+    constexpr void next(const T& t)
+    {
+        uint32_t size = wordSize(t);
+        mixed_ = mixed_ || size == 0 || (size_ != 0 && size != size_);
+        size_ = size;
+    }
+
+    constexpr uint32_t getWordSize() const { return mixed_ ? 0 : size_; }
+
+private:
+    uint32_t size_;
+    bool mixed_;
+};
+
+template <typename T>
+constexpr typename std::enable_if<std::is_class<T>::value, uint32_t>::type wordSize(const T& t)
+{
+    WordSizeStream stream;
+    Serializer<T>::template allInOne<WordSizeStream, const T&>(stream, t);
+    return stream.getWordSize();
+}
+
+template <typename T, bool Simple = mt::IsSimple<T>::value>
+struct SimpleWords : public std::integral_constant<uint32_t, 0>
+{
+};
+
+template <typename T>
+struct SimpleWords<T, true> : public std::integral_constant<uint32_t, wordSize(T{})>
+{
+};
+
+/**
+ * \brief Word size of a type that is memcpy'd as a whole (numbers, enums, IsSimple types), 0 for the others
+ */
+template <typename T>
+struct WireWords : public std::conditional<std::is_class<T>::value, SimpleWords<T>,
+                                           std::integral_constant<uint32_t, sizeof(T)>>::type
+{
+};
+
+/**
+ * \brief Copies bytes that hold words of wordBytes each from or to the wire, reversing every word when Stream's byte
+ * order is not the host's
+ */
+template <typename Stream>
+ROS_FORCE_INLINE void copyWords(void* dst, const void* src, uint32_t bytes, uint32_t wordBytes)
+{
+    if (SwapsBytes<Stream>::value)
+        byteSwapCopy(dst, src, bytes / wordBytes, wordBytes);
+    else
+        memcpy(dst, src, bytes);
+}
+
+/**
+ * \brief Stream over memory that was bounds checked already, advance is a plain pointer increment
+ */
+struct RawStream
+{
+    explicit RawStream(uint8_t* data) : data_(data) {}
+
+    ROS_FORCE_INLINE uint8_t* advance(uint32_t len)
+    {
+        uint8_t* old_data = data_;
+        data_ += len;
+        return old_data;
+    }
+
+private:
+    uint8_t* data_;
+};
+
+template <typename Endian = LittleEndian>
+struct RawIStream : public RawStream
+{
+    static const StreamType stream_type = stream_types::Input;
+    typedef Endian endian_type;
+
+    explicit RawIStream(uint8_t* data) : RawStream(data) {}
+
+    template <typename T>
+    ROS_FORCE_INLINE void next(T& t)
+    {
+        deserialize(*this, t);
+    }
+};
+
+template <typename Endian = LittleEndian>
+struct RawOStream : public RawStream
+{
+    static const StreamType stream_type = stream_types::Output;
+    typedef Endian endian_type;
+
+    explicit RawOStream(uint8_t* data) : RawStream(data) {}
+
+    template <typename T>
+    ROS_FORCE_INLINE void next(const T& t)
+    {
+        serialize(*this, t);
+    }
+};
+
+/**
+ * \brief True if T goes to or from Stream as one block: it lies in memory as it is serialized, and the stream keeps
+ * the host's byte order or T is made of words of one size, which are swapped in bulk
+ */
+template <typename T, typename Stream, bool Simple>
+struct BulkCopy
+    : public std::integral_constant<bool, Simple && (!SwapsBytes<Stream>::value || WireWords<T>::value != 0)>
+{
+};
+
+/**
+ * \brief Arrays of fixed-size types: one bounds check for all elements, then one memcpy or word swap for simple types
+ * or unchecked loads and stores per element for the others
+ */
+template <typename T, bool Pod = std::is_pod<T>::value>
+struct PodMatchesWire : public std::false_type
+{
+};
+
+/**
+ * \brief True for a std::is_pod type that lies in memory as it is serialized; a padded struct is longer in memory
+ */
+template <typename T>
+struct PodMatchesWire<T, true> : public std::integral_constant<bool, sizeof(T) == fixedLength(T{})>
+{
+};
+
+template <typename T>
+struct FixedArray
+{
+    // IsSimple promises the layout, std::is_pod types are checked here. Every other type goes element by element, so
+    // all paths agree with elementLength()
+    static const bool Simple = mt::IsSimple<T>::value || PodMatchesWire<T>::value;
+
+    inline static uint32_t elementLength() { return serializationLength(T()); }
+
+    /**
+     * \brief Serialized length of count elements
+     * \throws StreamOverrunException if it does not fit 32 bits, which only a corrupt length read from a stream does
+     */
+    inline static uint32_t byteLength(uint32_t count)
+    {
+        uint64_t len = static_cast<uint64_t>(count) * elementLength();
+        if (len > UINT32_MAX)
+            throwStreamOverrun();
+        return static_cast<uint32_t>(len);
+    }
+
+    template <typename Stream>
+    ROS_FORCE_INLINE static void write(Stream& stream, const T* t, uint32_t count)
+    {
+        write(stream, t, count, BulkCopy<T, Stream, Simple>());
+    }
+
+    /**
+     * \brief Fills t from data, which holds byteLength(count) bounds checked bytes in the byte order of Stream
+     */
+    template <typename Stream>
+    ROS_FORCE_INLINE static void read(uint8_t* data, T* t, uint32_t count)
+    {
+        read<Stream>(data, t, count, BulkCopy<T, Stream, Simple>());
+    }
+
+private:
+    template <typename Stream>
+    ROS_FORCE_INLINE static void write(Stream& stream, const T* t, uint32_t count, std::true_type)
+    {
+        uint32_t len = count * static_cast<uint32_t>(sizeof(T));
+        // writeBytes lets a GatherStream reference the block, swapped words have to be copied
+        if (SwapsBytes<Stream>::value)
+            copyWords<Stream>(stream.advance(len), t, len, WireWords<T>::value);
+        else
+            writeBytes(stream, t, len);
+    }
+
+    template <typename Stream>
+    ROS_FORCE_INLINE static void write(Stream& stream, const T* t, uint32_t count, std::false_type)
+    {
+        RawOStream<typename StreamEndian<Stream>::type> raw(stream.advance(byteLength(count)));
+        for (uint32_t i = 0; i < count; i++)
+            raw.next(t[i]);
+    }
+
+    template <typename Stream>
+    ROS_FORCE_INLINE static void read(uint8_t* data, T* t, uint32_t count, std::true_type)
+    {
+        copyWords<Stream>(static_cast<void*>(t), data, count * static_cast<uint32_t>(sizeof(T)), WireWords<T>::value);
+    }
+
+    template <typename Stream>
+    ROS_FORCE_INLINE static void read(uint8_t* data, T* t, uint32_t count, std::false_type)
+    {
+        RawIStream<typename StreamEndian<Stream>::type> raw(data);
+        for (uint32_t i = 0; i < count; i++)
+            raw.next(t[i]);
+    }
+};
+
+/**
+ * \brief What ROS_DECLARE_ALLINONE_SERIALIZER expands to: every field through the stream for variable-size types
+ */
+template <typename T, bool Fixed = mt::IsFixedSize<T>::value>
+struct AllInOne
+{
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void write(Stream& stream, const T& t)
+    {
+        S::template allInOne<Stream, const T&>(stream, t);
+    }
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void read(Stream& stream, T& t)
+    {
+        S::template allInOne<Stream, T&>(stream, t);
+    }
+
+    template <typename S>
+    ROS_FORCE_INLINE static uint32_t serializedLength(const T& t)
+    {
+        LStream stream;
+        S::template allInOne<LStream, const T&>(stream, t);
+        return stream.getLength();
+    }
+};
+
+/**
+ * \brief Fixed-size types: one bounds check for the whole message, then one memcpy for simple types or unchecked
+ * loads and stores for the others.  Simple types take the loads and stores too when the stream swaps bytes: an
+ * inlined bswap per field is cheaper than a call to the bulk swap for one message.
+ */
+template <typename T>
+struct AllInOne<T, true>
+{
+    template <typename Stream>
+    struct Copy : public std::integral_constant<bool, mt::IsSimple<T>::value && !SwapsBytes<Stream>::value>
+    {
+    };
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void write(Stream& stream, const T& t)
+    {
+        write<S, Stream>(stream.advance(FixedLength<T>::value), t, Copy<Stream>());
+    }
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void read(Stream& stream, T& t)
+    {
+        read<S, Stream>(stream.advance(FixedLength<T>::value), t, Copy<Stream>());
+    }
+
+    template <typename S>
+    ROS_FORCE_INLINE static constexpr uint32_t serializedLength(const T&)
+    {
+        return FixedLength<T>::value;
+    }
+
+private:
+    static_assert(!mt::IsSimple<T>::value || (sizeof(T) == FixedLength<T>::value && std::is_trivially_copyable<T>::value),
+                  "a type marked IsSimple has padding or can not be memcpy'd");
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void write(uint8_t* data, const T& t, std::true_type)
+    {
+        memcpy(data, &t, sizeof(T));
+    }
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void write(uint8_t* data, const T& t, std::false_type)
+    {
+        typedef RawOStream<typename StreamEndian<Stream>::type> Raw;
+        Raw raw(data);
+        S::template allInOne<Raw, const T&>(raw, t);
+    }
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void read(uint8_t* data, T& t, std::true_type)
+    {
+        memcpy(&t, data, sizeof(T));
+    }
+
+    template <typename S, typename Stream>
+    ROS_FORCE_INLINE static void read(uint8_t* data, T& t, std::false_type)
+    {
+        typedef RawIStream<typename StreamEndian<Stream>::type> Raw;
+        Raw raw(data);
+        S::template allInOne<Raw, T&>(raw, t);
+    }
+};
+
 } // namespace serialization
 
 } // namespace ros
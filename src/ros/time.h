@@ -39,6 +39,7 @@
 #include <string>
 #include <cmath>
 #include <stdexcept>
+#include <ctime>
 #include <sys/time.h>
 
 namespace ros
@@ -65,8 +66,8 @@ public:
     uint32_t sec;
     uint32_t nsec;
 
-    Time() : sec(0), nsec(0) {}
-    Time(uint32_t _sec, uint32_t _nsec) : sec(_sec), nsec(_nsec) {}
+    constexpr Time() : sec(0), nsec(0) {}
+    constexpr Time(uint32_t _sec, uint32_t _nsec) : sec(_sec), nsec(_nsec) {}
     explicit Time(double t) { fromSec(t); }
 
     Time& fromSec(double t)
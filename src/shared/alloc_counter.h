@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+/// Number of heap allocations (global operator new, aligned or not) the process has made so far.
+/// alloc_counter.cpp replaces operator new/delete and is only linked into the tests and the benchmarks, which read
+/// the counter before and after a loop:
+///     size_t before = allocationCount();
+///     ...
+///     printf("%zu allocations\n", allocationCount() - before);
+size_t allocationCount();
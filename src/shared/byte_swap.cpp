@@ -0,0 +1,222 @@
+#include "byte_swap.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define BYTE_SWAP_HAS_X86 1
+#    include <immintrin.h>
+#else
+#    define BYTE_SWAP_HAS_X86 0
+#endif
+
+namespace
+{
+template <typename Word, Word (*Swap)(Word)>
+void swapScalar(void* dst, const void* src, size_t count)
+{
+    uint8_t* d = (uint8_t*)dst;
+    const uint8_t* s = (const uint8_t*)src;
+    for (size_t i = 0; i < count; i++)
+    {
+        Word w;
+        memcpy(&w, s + i * sizeof(Word), sizeof(Word));
+        w = Swap(w);
+        memcpy(d + i * sizeof(Word), &w, sizeof(Word));
+    }
+}
+
+uint16_t bswap16(uint16_t w)
+{
+    return __builtin_bswap16(w);
+}
+
+uint32_t bswap32(uint32_t w)
+{
+    return __builtin_bswap32(w);
+}
+
+uint64_t bswap64(uint64_t w)
+{
+    return __builtin_bswap64(w);
+}
+
+const ByteSwapFuncs g_scalar = {swapScalar<uint16_t, bswap16>, swapScalar<uint32_t, bswap32>,
+                                swapScalar<uint64_t, bswap64>};
+
+#if BYTE_SWAP_HAS_X86
+// pshufb masks reversing each word of a 16 byte lane
+#    define BYTE_SWAP_MASK16 1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14
+#    define BYTE_SWAP_MASK32 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12
+#    define BYTE_SWAP_MASK64 7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8
+
+// the whole lanes, the tail of fewer than 16 / 32 bytes is left to the scalar loop. No vector types in the
+// signatures: a function passing one in a ymm register is left without the vzeroupper that keeps the sse code
+// after it from stalling
+__attribute__((target("ssse3"))) size_t swapSsse3Lanes(uint8_t* d, const uint8_t* s, size_t bytes, size_t wordSize)
+{
+    __m128i mask = wordSize == 2   ? _mm_setr_epi8(BYTE_SWAP_MASK16)
+                   : wordSize == 4 ? _mm_setr_epi8(BYTE_SWAP_MASK32)
+                                   : _mm_setr_epi8(BYTE_SWAP_MASK64);
+    size_t i = 0;
+    for (; i + 64 <= bytes; i += 64)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(s + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(s + i + 16));
+        __m128i c = _mm_loadu_si128((const __m128i*)(s + i + 32));
+        __m128i e = _mm_loadu_si128((const __m128i*)(s + i + 48));
+        _mm_storeu_si128((__m128i*)(d + i), _mm_shuffle_epi8(a, mask));
+        _mm_storeu_si128((__m128i*)(d + i + 16), _mm_shuffle_epi8(b, mask));
+        _mm_storeu_si128((__m128i*)(d + i + 32), _mm_shuffle_epi8(c, mask));
+        _mm_storeu_si128((__m128i*)(d + i + 48), _mm_shuffle_epi8(e, mask));
+    }
+    for (; i + 16 <= bytes; i += 16)
+        _mm_storeu_si128((__m128i*)(d + i), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + i)), mask));
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t swapAvx2Lanes(uint8_t* d, const uint8_t* s, size_t bytes, size_t wordSize)
+{
+    // vpshufb shuffles within each 128 bit half, both halves take the same mask
+    __m256i mask = wordSize == 2   ? _mm256_setr_epi8(BYTE_SWAP_MASK16, BYTE_SWAP_MASK16)
+                   : wordSize == 4 ? _mm256_setr_epi8(BYTE_SWAP_MASK32, BYTE_SWAP_MASK32)
+                                   : _mm256_setr_epi8(BYTE_SWAP_MASK64, BYTE_SWAP_MASK64);
+    size_t i = 0;
+    for (; i + 128 <= bytes; i += 128)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(s + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(s + i + 32));
+        __m256i c = _mm256_loadu_si256((const __m256i*)(s + i + 64));
+        __m256i e = _mm256_loadu_si256((const __m256i*)(s + i + 96));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_shuffle_epi8(a, mask));
+        _mm256_storeu_si256((__m256i*)(d + i + 32), _mm256_shuffle_epi8(b, mask));
+        _mm256_storeu_si256((__m256i*)(d + i + 64), _mm256_shuffle_epi8(c, mask));
+        _mm256_storeu_si256((__m256i*)(d + i + 96), _mm256_shuffle_epi8(e, mask));
+    }
+    for (; i + 32 <= bytes; i += 32)
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)(s + i)), mask));
+    return i;
+}
+
+template <typename Word, Word (*Swap)(Word)>
+__attribute__((target("ssse3"))) void swapSsse3(void* dst, const void* src, size_t count)
+{
+    size_t done = swapSsse3Lanes((uint8_t*)dst, (const uint8_t*)src, count * sizeof(Word), sizeof(Word));
+    swapScalar<Word, Swap>((uint8_t*)dst + done, (const uint8_t*)src + done, count - done / sizeof(Word));
+}
+
+template <typename Word, Word (*Swap)(Word)>
+__attribute__((target("avx2"))) void swapAvx2(void* dst, const void* src, size_t count)
+{
+    size_t done = swapAvx2Lanes((uint8_t*)dst, (const uint8_t*)src, count * sizeof(Word), sizeof(Word));
+    swapScalar<Word, Swap>((uint8_t*)dst + done, (const uint8_t*)src + done, count - done / sizeof(Word));
+}
+
+const ByteSwapFuncs g_ssse3 = {swapSsse3<uint16_t, bswap16>, swapSsse3<uint32_t, bswap32>,
+                               swapSsse3<uint64_t, bswap64>};
+const ByteSwapFuncs g_avx2 = {swapAvx2<uint16_t, bswap16>, swapAvx2<uint32_t, bswap32>, swapAvx2<uint64_t, bswap64>};
+#endif
+} // namespace
+
+const char* byteSwapEngineName(ByteSwapEngine engine)
+{
+    switch (engine)
+    {
+    case ByteSwapEngine_scalar:
+        return "scalar";
+    case ByteSwapEngine_ssse3:
+        return "ssse3";
+    case ByteSwapEngine_avx2:
+        return "avx2";
+    default:
+        return "unknown";
+    }
+}
+
+bool byteSwapEngineSupported(ByteSwapEngine engine)
+{
+    switch (engine)
+    {
+    case ByteSwapEngine_scalar:
+        return true;
+#if BYTE_SWAP_HAS_X86
+    case ByteSwapEngine_ssse3:
+        return __builtin_cpu_supports("ssse3");
+    case ByteSwapEngine_avx2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+const ByteSwapFuncs* byteSwapEngineFuncs(ByteSwapEngine engine)
+{
+    switch (engine)
+    {
+    case ByteSwapEngine_scalar:
+        return &g_scalar;
+#if BYTE_SWAP_HAS_X86
+    case ByteSwapEngine_ssse3:
+        return &g_ssse3;
+    case ByteSwapEngine_avx2:
+        return &g_avx2;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+namespace
+{
+// avx2 is not the default: raw_tcp_client_bench measured it at about half the ssse3 throughput on 64 KB arrays,
+// and whether its 32 byte accesses win depends on how source and destination lie relative to each other, so a
+// timing at startup would not pick reliably either
+ByteSwapEngine bestEngine()
+{
+    if (byteSwapEngineSupported(ByteSwapEngine_ssse3))
+        return ByteSwapEngine_ssse3;
+    return ByteSwapEngine_scalar;
+}
+
+std::atomic<int> g_engine{-1};
+
+void resolve16(void* dst, const void* src, size_t count)
+{
+    byteSwapSelectEngine(bestEngine());
+    byte_swap_detail::g_funcs.load(std::memory_order_relaxed)->swap16(dst, src, count);
+}
+
+void resolve32(void* dst, const void* src, size_t count)
+{
+    byteSwapSelectEngine(bestEngine());
+    byte_swap_detail::g_funcs.load(std::memory_order_relaxed)->swap32(dst, src, count);
+}
+
+void resolve64(void* dst, const void* src, size_t count)
+{
+    byteSwapSelectEngine(bestEngine());
+    byte_swap_detail::g_funcs.load(std::memory_order_relaxed)->swap64(dst, src, count);
+}
+
+const ByteSwapFuncs g_resolve = {resolve16, resolve32, resolve64};
+} // namespace
+
+namespace byte_swap_detail
+{
+std::atomic<const ByteSwapFuncs*> g_funcs{&g_resolve};
+}
+
+ByteSwapEngine byteSwapCurrentEngine()
+{
+    int engine = g_engine.load(std::memory_order_relaxed);
+    return engine < 0 ? bestEngine() : (ByteSwapEngine)engine;
+}
+
+bool byteSwapSelectEngine(ByteSwapEngine engine)
+{
+    if (!byteSwapEngineSupported(engine))
+        return false;
+
+    g_engine.store(engine, std::memory_order_relaxed);
+    byte_swap_detail::g_funcs.store(byteSwapEngineFuncs(engine), std::memory_order_relaxed);
+    return true;
+}
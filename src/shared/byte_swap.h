@@ -0,0 +1,64 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/// Copies arrays of 2, 4 or 8 byte words with the byte order of every word reversed, for data whose wire order is
+/// not the host's. dst may be src (in place) but must not overlap it otherwise. Any alignment.
+///
+/// Several engines do the same, byteSwapCopy() goes through ssse3 where the cpu has it (see byteSwapCurrentEngine):
+///     byteSwapCopy(dst, src, count, sizeof(float));
+
+enum ByteSwapEngine
+{
+    ByteSwapEngine_scalar = 0, // bswap per word
+    ByteSwapEngine_ssse3 = 1,  // pshufb, 16 bytes per step, x86 only
+    ByteSwapEngine_avx2 = 2,   // vpshufb, 32 bytes per step, x86 only
+    ByteSwapEngine_count
+};
+
+typedef void (*ByteSwapFunc)(void* dst, const void* src, size_t count);
+
+/// one function per word size
+struct ByteSwapFuncs
+{
+    ByteSwapFunc swap16;
+    ByteSwapFunc swap32;
+    ByteSwapFunc swap64;
+};
+
+const char* byteSwapEngineName(ByteSwapEngine engine);
+bool byteSwapEngineSupported(ByteSwapEngine engine);
+const ByteSwapFuncs* byteSwapEngineFuncs(ByteSwapEngine engine);
+
+/// engine used by byteSwapCopy, ssse3 if supported and scalar otherwise unless another one was selected
+ByteSwapEngine byteSwapCurrentEngine();
+/// returns false if the engine is not supported on this cpu
+bool byteSwapSelectEngine(ByteSwapEngine engine);
+
+namespace byte_swap_detail
+{
+extern std::atomic<const ByteSwapFuncs*> g_funcs;
+}
+
+/// count words of wordSize bytes; wordSize 1 is a plain copy
+inline void byteSwapCopy(void* dst, const void* src, size_t count, size_t wordSize)
+{
+    const ByteSwapFuncs* funcs = byte_swap_detail::g_funcs.load(std::memory_order_relaxed);
+    switch (wordSize)
+    {
+    case 2:
+        funcs->swap16(dst, src, count);
+        break;
+    case 4:
+        funcs->swap32(dst, src, count);
+        break;
+    case 8:
+        funcs->swap64(dst, src, count);
+        break;
+    default:
+        if (dst != src)
+            __builtin_memmove(dst, src, count * wordSize);
+        break;
+    }
+}
@@ -0,0 +1,77 @@
+#include "clock.h"
+
+namespace clock_detail
+{
+std::atomic<int> g_source(-1);
+std::atomic<int64_t> g_wallOffsetNs(0);
+std::atomic<uint64_t> g_tscBase(0);
+std::atomic<int64_t> g_tscBaseNs(0);
+std::atomic<double> g_nanosPerTick(1.0);
+} // namespace clock_detail
+
+using namespace clock_detail;
+
+namespace
+{
+// takes the wall clock offset of the default source before main()
+struct DefaultSource
+{
+    DefaultSource()
+    {
+        if (g_source.load(std::memory_order_relaxed) == -1)
+            clockSelectSource(ClockSource_monotonic);
+    }
+} g_defaultSource;
+} // namespace
+
+const char* clockSourceName(ClockSource source)
+{
+    switch (source)
+    {
+    case ClockSource_realtime:
+        return "realtime";
+    case ClockSource_monotonic:
+        return "monotonic";
+    case ClockSource_monotonicRaw:
+        return "monotonic_raw";
+    case ClockSource_tsc:
+        return "tsc";
+    default:
+        return "?";
+    }
+}
+
+bool clockSelectSource(ClockSource source)
+{
+    struct timespec ts;
+    switch (source)
+    {
+    case ClockSource_realtime:
+        g_wallOffsetNs.store(0, std::memory_order_relaxed);
+        break;
+    case ClockSource_monotonic:
+        g_wallOffsetNs.store(readNs(CLOCK_REALTIME) - readNs(CLOCK_MONOTONIC), std::memory_order_relaxed);
+        break;
+    case ClockSource_monotonicRaw:
+        if (clock_gettime(CLOCK_MONOTONIC_RAW, &ts) != 0)
+            return false;
+        g_wallOffsetNs.store(readNs(CLOCK_REALTIME) - readNs(CLOCK_MONOTONIC_RAW), std::memory_order_relaxed);
+        break;
+    case ClockSource_tsc:
+        // ticks count from here, the base is the monotonic clock so tsc stamps line up with monotonic ones
+        g_nanosPerTick.store(tscNanosPerTick(), std::memory_order_relaxed);
+        g_tscBaseNs.store(readNs(CLOCK_MONOTONIC), std::memory_order_relaxed);
+        g_tscBase.store(tscRead(), std::memory_order_relaxed);
+        g_wallOffsetNs.store(readNs(CLOCK_REALTIME) - readNs(CLOCK_MONOTONIC), std::memory_order_relaxed);
+        break;
+    default:
+        return false;
+    }
+    g_source.store(source, std::memory_order_release);
+    return true;
+}
+
+ClockSource clockCurrentSource()
+{
+    return (ClockSource)g_source.load(std::memory_order_acquire);
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+#include <atomic>
+#include "ros/time.h"
+#include "shared/tsc.h"
+
+/// Clock for receive timestamps. Stamps are int64 nanoseconds on the selected source and only become ros::Time at
+/// the API boundary, through clockToRosTime():
+///     int64_t stamp = clockNowNs();
+///     ...
+///     delegate->ParserManager_packetFound(header, clockToRosTime(stamp), pack, bytes);
+/// The ros::Time is the wall clock time taken when the source was selected plus the time elapsed on the source, so
+/// latency math does not jump when NTP steps the wall clock (ClockSource_realtime excepted).
+
+enum ClockSource
+{
+    ClockSource_realtime = 0,     // CLOCK_REALTIME, what ros::Time::now() reads, steps with NTP
+    ClockSource_monotonic = 1,    // CLOCK_MONOTONIC, slewed by NTP but never stepped, the default
+    ClockSource_monotonicRaw = 2, // CLOCK_MONOTONIC_RAW, the hardware rate without NTP corrections
+    ClockSource_tsc = 3,          // tscRead() scaled by its calibrated rate, no vDSO call at all
+    ClockSource_count
+};
+
+const char* clockSourceName(ClockSource source);
+/// returns false if the source does not work on this machine
+bool clockSelectSource(ClockSource source);
+ClockSource clockCurrentSource();
+
+namespace clock_detail
+{
+extern std::atomic<int> g_source;
+extern std::atomic<int64_t> g_wallOffsetNs; // wall clock minus source, at selection
+extern std::atomic<uint64_t> g_tscBase;
+extern std::atomic<int64_t> g_tscBaseNs;
+extern std::atomic<double> g_nanosPerTick;
+
+inline int64_t readNs(clockid_t id)
+{
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+} // namespace clock_detail
+
+/// nanoseconds on the selected source, only differences and clockToRosTime() mean something
+inline int64_t clockNowNs()
+{
+    using namespace clock_detail;
+    switch (g_source.load(std::memory_order_acquire))
+    {
+    case ClockSource_realtime:
+        return readNs(CLOCK_REALTIME);
+    case ClockSource_monotonicRaw:
+        return readNs(CLOCK_MONOTONIC_RAW);
+    case ClockSource_tsc:
+        return g_tscBaseNs.load(std::memory_order_relaxed)
+               + (int64_t)((double)(tscRead() - g_tscBase.load(std::memory_order_relaxed))
+                           * g_nanosPerTick.load(std::memory_order_relaxed));
+    default:
+        return readNs(CLOCK_MONOTONIC);
+    }
+}
+
+inline ros::Time clockToRosTime(int64_t ns)
+{
+    int64_t wall = ns + clock_detail::g_wallOffsetNs.load(std::memory_order_relaxed);
+    if (wall < 0)
+        return ros::Time();
+    return ros::Time((uint32_t)(wall / 1000000000), (uint32_t)(wall % 1000000000));
+}
@@ -0,0 +1,297 @@
+#include "crc.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    define CRC16_HAS_CLMUL 1
+#    include <immintrin.h>
+#else
+#    define CRC16_HAS_CLMUL 0
+#endif
+
+namespace
+{
+const uint16_t CRC_MASK = 0xA001; /// high and low bit flipping of '0x8005'
+
+/// tables[k][b]: crc contribution of byte b followed by k zero bytes
+struct Crc16Tables
+{
+    uint16_t t[16][256];
+
+    constexpr Crc16Tables() : t{}
+    {
+        for (int b = 0; b < 256; b++)
+        {
+            uint16_t crc = (uint16_t)b;
+            for (int i = 0; i < 8; i++)
+                crc = (crc & 0x0001) ? (uint16_t)((crc >> 1) ^ CRC_MASK) : (uint16_t)(crc >> 1);
+            t[0][b] = crc;
+        }
+        for (int k = 1; k < 16; k++)
+        {
+            for (int b = 0; b < 256; b++)
+                t[k][b] = (uint16_t)((t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xff]);
+        }
+    }
+};
+
+constexpr Crc16Tables kTables;
+
+inline uint16_t crc16TableStep(uint16_t crc, uint8_t byte)
+{
+    return (uint16_t)((crc >> 8) ^ kTables.t[0][(crc ^ byte) & 0xff]);
+}
+} // namespace
+
+uint16_t crc16Bitwise(uint16_t crc, const uint8_t* p, size_t len)
+{
+    for (size_t j = 0; j < len; j++)
+    {
+        crc ^= p[j];
+        for (int i = 0; i < 8; i++)
+        {
+            if ((crc & 0x0001) > 0)
+            {
+                crc = (crc >> 1) ^ CRC_MASK;
+            }
+            else
+            {
+                crc >>= 1;
+            }
+        }
+    }
+    return crc;
+}
+
+uint16_t crc16Table(uint16_t crc, const uint8_t* p, size_t len)
+{
+    for (size_t j = 0; j < len; j++)
+        crc = crc16TableStep(crc, p[j]);
+    return crc;
+}
+
+uint16_t crc16Slicing8(uint16_t crc, const uint8_t* p, size_t len)
+{
+    const uint16_t(*t)[256] = kTables.t;
+    while (len >= 8)
+    {
+        crc = t[7][(p[0] ^ crc) & 0xff] ^ t[6][p[1] ^ (crc >> 8)] ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]]
+              ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+        p += 8;
+        len -= 8;
+    }
+    return crc16Table(crc, p, len);
+}
+
+uint16_t crc16Slicing16(uint16_t crc, const uint8_t* p, size_t len)
+{
+    const uint16_t(*t)[256] = kTables.t;
+    while (len >= 16)
+    {
+        crc = t[15][(p[0] ^ crc) & 0xff] ^ t[14][p[1] ^ (crc >> 8)] ^ t[13][p[2]] ^ t[12][p[3]] ^ t[11][p[4]]
+              ^ t[10][p[5]] ^ t[9][p[6]] ^ t[8][p[7]] ^ t[7][p[8]] ^ t[6][p[9]] ^ t[5][p[10]] ^ t[4][p[11]]
+              ^ t[3][p[12]] ^ t[2][p[13]] ^ t[1][p[14]] ^ t[0][p[15]];
+        p += 16;
+        len -= 16;
+    }
+    return crc16Slicing8(crc, p, len);
+}
+
+#if CRC16_HAS_CLMUL
+namespace
+{
+/// below this the folding setup costs more than it saves
+const size_t CLMUL_MIN_LEN = 128;
+
+/// x^n mod P, P = x^16 + 0x8005 in normal (non reflected) bit order
+constexpr uint64_t xPowModP(int n)
+{
+    uint32_t r = 1;
+    for (int i = 0; i < n; i++)
+    {
+        r <<= 1;
+        if (r & 0x10000)
+            r ^= 0x18005;
+    }
+    return r;
+}
+
+constexpr uint64_t reflect64(uint64_t v)
+{
+    uint64_t r = 0;
+    for (int i = 0; i < 64; i++)
+        r |= ((v >> i) & 1) << (63 - i);
+    return r;
+}
+
+/// Folding a 128 bit lane forward by `bits`:
+///   lane = H * x^64 + L  (in reflected order the low qword holds H)
+///   lane * x^bits == H * (x^(bits+64) mod P) + L * (x^bits mod P)
+/// pclmul of two reflected operands yields the product shifted by one bit, so the constants use one power less.
+struct FoldConstants
+{
+    uint64_t lo;
+    uint64_t hi;
+};
+
+constexpr FoldConstants foldConstants(int bits)
+{
+    return FoldConstants{reflect64(xPowModP(bits + 63)), reflect64(xPowModP(bits - 1))};
+}
+
+constexpr FoldConstants kFold128 = foldConstants(128);
+constexpr FoldConstants kFold512 = foldConstants(512);
+
+__attribute__((target("pclmul,sse2"))) inline __m128i fold(__m128i lane, __m128i k, __m128i next)
+{
+    __m128i h = _mm_clmulepi64_si128(lane, k, 0x00);
+    __m128i l = _mm_clmulepi64_si128(lane, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(h, l), next);
+}
+
+__attribute__((target("pclmul,sse2"))) uint16_t crc16ClmulImpl(uint16_t crc, const uint8_t* p, size_t len)
+{
+    const __m128i k128 = _mm_set_epi64x((long long)kFold128.hi, (long long)kFold128.lo);
+    const __m128i k512 = _mm_set_epi64x((long long)kFold512.hi, (long long)kFold512.lo);
+
+    // the crc register is linear, feeding it as the first two message bytes lets us continue from zero
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), _mm_cvtsi32_si128(crc));
+    __m128i x1 = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i x2 = _mm_loadu_si128((const __m128i*)(p + 32));
+    __m128i x3 = _mm_loadu_si128((const __m128i*)(p + 48));
+    p += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        x0 = fold(x0, k512, _mm_loadu_si128((const __m128i*)p));
+        x1 = fold(x1, k512, _mm_loadu_si128((const __m128i*)(p + 16)));
+        x2 = fold(x2, k512, _mm_loadu_si128((const __m128i*)(p + 32)));
+        x3 = fold(x3, k512, _mm_loadu_si128((const __m128i*)(p + 48)));
+        p += 64;
+        len -= 64;
+    }
+
+    __m128i x = fold(x0, k128, x1);
+    x = fold(x, k128, x2);
+    x = fold(x, k128, x3);
+
+    while (len >= 16)
+    {
+        x = fold(x, k128, _mm_loadu_si128((const __m128i*)p));
+        p += 16;
+        len -= 16;
+    }
+
+    // the remaining lane has the same remainder as everything folded into it
+    uint8_t lane[16];
+    _mm_storeu_si128((__m128i*)lane, x);
+    crc = crc16Slicing16(0, lane, sizeof(lane));
+    return crc16Slicing8(crc, p, len);
+}
+} // namespace
+#endif
+
+uint16_t crc16Clmul(uint16_t crc, const uint8_t* p, size_t len)
+{
+#if CRC16_HAS_CLMUL
+    if (len >= CLMUL_MIN_LEN)
+        return crc16ClmulImpl(crc, p, len);
+#endif
+    return crc16Slicing16(crc, p, len);
+}
+
+const char* crc16EngineName(Crc16Engine engine)
+{
+    switch (engine)
+    {
+    case Crc16Engine_bitwise:
+        return "bitwise";
+    case Crc16Engine_table:
+        return "table";
+    case Crc16Engine_slicing8:
+        return "slicing8";
+    case Crc16Engine_slicing16:
+        return "slicing16";
+    case Crc16Engine_clmul:
+        return "clmul";
+    default:
+        return "unknown";
+    }
+}
+
+bool crc16EngineSupported(Crc16Engine engine)
+{
+    switch (engine)
+    {
+    case Crc16Engine_bitwise:
+    case Crc16Engine_table:
+    case Crc16Engine_slicing8:
+    case Crc16Engine_slicing16:
+        return true;
+    case Crc16Engine_clmul:
+#if CRC16_HAS_CLMUL
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+Crc16Func crc16EngineFunc(Crc16Engine engine)
+{
+    switch (engine)
+    {
+    case Crc16Engine_bitwise:
+        return crc16Bitwise;
+    case Crc16Engine_table:
+        return crc16Table;
+    case Crc16Engine_slicing8:
+        return crc16Slicing8;
+    case Crc16Engine_slicing16:
+        return crc16Slicing16;
+    case Crc16Engine_clmul:
+        return crc16Clmul;
+    default:
+        return NULL;
+    }
+}
+
+namespace
+{
+Crc16Engine bestEngine()
+{
+    if (crc16EngineSupported(Crc16Engine_clmul))
+        return Crc16Engine_clmul;
+    return Crc16Engine_slicing16;
+}
+
+std::atomic<int> g_engine{-1};
+
+uint16_t crc16Resolve(uint16_t crc, const uint8_t* p, size_t len)
+{
+    crc16SelectEngine(bestEngine());
+    return crc_detail::g_crc16.load(std::memory_order_relaxed)(crc, p, len);
+}
+} // namespace
+
+namespace crc_detail
+{
+std::atomic<Crc16Func> g_crc16{crc16Resolve};
+}
+
+Crc16Engine crc16CurrentEngine()
+{
+    int engine = g_engine.load(std::memory_order_relaxed);
+    return engine < 0 ? bestEngine() : (Crc16Engine)engine;
+}
+
+bool crc16SelectEngine(Crc16Engine engine)
+{
+    if (!crc16EngineSupported(engine))
+        return false;
+
+    g_engine.store(engine, std::memory_order_relaxed);
+    crc_detail::g_crc16.store(crc16EngineFunc(engine), std::memory_order_relaxed);
+    return true;
+}
@@ -1,29 +1,60 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
+#include <atomic>
 
-/// todo: improve performance:
+/// CRC-16/MODBUS: x16+x15+x2+1 <==> 0x8005, reflected, init 0xffff
 /// https://github.com/LacobusVentura/MODBUS-CRC16
-/// CRC-16 x16+x15+x2+1  <==> 0x8005
+///
+/// Several engines compute the same checksum, calculateCRC16() goes through the fastest one the cpu supports.
+/// All engines take the running crc so a payload can be checksummed in pieces:
+///     crc = CRC16_INIT;
+///     crc = updateCRC16(crc, part1, n1);
+///     crc = updateCRC16(crc, part2, n2);
+
+#define CRC16_INIT 0xffff
+
+enum Crc16Engine
+{
+    Crc16Engine_bitwise = 0, // reference, 8 branches per byte
+    Crc16Engine_table = 1,   // 256 entry table, one lookup per byte
+    Crc16Engine_slicing8 = 2,
+    Crc16Engine_slicing16 = 3,
+    Crc16Engine_clmul = 4, // PCLMULQDQ folding, x86 only
+    Crc16Engine_count
+};
+
+typedef uint16_t (*Crc16Func)(uint16_t crc, const uint8_t* p, size_t len);
+
+uint16_t crc16Bitwise(uint16_t crc, const uint8_t* p, size_t len);
+uint16_t crc16Table(uint16_t crc, const uint8_t* p, size_t len);
+uint16_t crc16Slicing8(uint16_t crc, const uint8_t* p, size_t len);
+uint16_t crc16Slicing16(uint16_t crc, const uint8_t* p, size_t len);
+uint16_t crc16Clmul(uint16_t crc, const uint8_t* p, size_t len);
+
+const char* crc16EngineName(Crc16Engine engine);
+bool crc16EngineSupported(Crc16Engine engine);
+Crc16Func crc16EngineFunc(Crc16Engine engine);
+
+/// engine used by calculateCRC16, picked by cpu feature detection on first use
+Crc16Engine crc16CurrentEngine();
+/// returns false if the engine is not supported on this cpu
+bool crc16SelectEngine(Crc16Engine engine);
+
+namespace crc_detail
+{
+extern std::atomic<Crc16Func> g_crc16;
+}
+
+inline uint16_t updateCRC16(uint16_t crc, const void* buffer, size_t len)
+{
+    return crc_detail::g_crc16.load(std::memory_order_relaxed)(crc, (const uint8_t*)buffer, len);
+}
+
+/// len <= 0 is an empty buffer, as in the original bytewise loop
 inline uint16_t calculateCRC16(const void* buffer, int len)
 {
-    const uint8_t* p = (const uint8_t*)buffer;
-    uint16_t crc = 0xffff;            /// init value
-    const uint16_t CRC_MASK = 0xA001; /// high and low bit flipping of '0x8005'
-    int i, j;
-    for (j = 0; j < len; j++)
-    {
-        crc ^= p[j];
-        for (i = 0; i < 8; i++)
-        {
-            if ((crc & 0x0001) > 0)
-            {
-                crc = (crc >> 1) ^ CRC_MASK;
-            }
-            else
-            {
-                crc >>= 1;
-            }
-        }
-    }
-    return crc;
-}
\ No newline at end of file
+    if (len <= 0)
+        return CRC16_INIT;
+    return updateCRC16(CRC16_INIT, buffer, (size_t)len);
+}
@@ -0,0 +1,46 @@
+#include "tsc.h"
+#include <atomic>
+
+namespace
+{
+double monotonicNanos()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+double calibrate()
+{
+#if defined(__aarch64__)
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    return 1e9 / (double)frequency;
+#elif defined(__x86_64__) || defined(__i386__)
+    // spin rather than sleep, the rate is the same and the process is not descheduled in between
+    double beginNs = monotonicNanos();
+    uint64_t begin = tscRead();
+    double endNs;
+    do
+        endNs = monotonicNanos();
+    while (endNs - beginNs < 10e6);
+    uint64_t end = tscRead();
+    return (endNs - beginNs) / (double)(end - begin);
+#else
+    return 1.0;
+#endif
+}
+
+std::atomic<double> g_nanosPerTick(0);
+} // namespace
+
+double tscNanosPerTick()
+{
+    double value = g_nanosPerTick.load(std::memory_order_relaxed);
+    if (value == 0)
+    {
+        value = calibrate();
+        g_nanosPerTick.store(value, std::memory_order_relaxed);
+    }
+    return value;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <x86intrin.h>
+#endif
+
+/// Cycle counter for interval timing, a few ns per read instead of a clock_gettime call:
+///     uint64_t begin = tscRead();
+///     ...
+///     double ns = (tscRead() - begin) * tscNanosPerTick();
+/// rdtsc on x86 (constant rate on every cpu of the last decade), the virtual counter on arm64, CLOCK_MONOTONIC in
+/// nanoseconds elsewhere. Ticks only mean something as differences on one machine.
+
+inline uint64_t tscRead()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/// measured against CLOCK_MONOTONIC on the first call (about 10 ms), cached afterwards
+double tscNanosPerTick();
@@ -0,0 +1,279 @@
+#include "sim/robot_simulator.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include "ros/message_wrapper.h"
+#include "port_msgs/DeviceState.h"
+#include "port_msgs/Odom.h"
+#include "port_msgs/TcpRobotControl.h"
+#include "port_msgs/TcpRobotState.h"
+
+#define ROBOT_SIMULATOR_TICK_MS 1
+
+using namespace ax;
+
+namespace
+{
+double monotonicSeconds()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+double diffUs(const ros::Time& from, const ros::Time& to)
+{
+    return ((int64_t)to.sec - (int64_t)from.sec) * 1e6 + ((int64_t)to.nsec - (int64_t)from.nsec) * 1e-3;
+}
+
+double percentile(std::vector<double>& sorted, double p)
+{
+    return sorted.empty() ? 0 : sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * p))];
+}
+} // namespace
+
+struct RobotSimulator::Client : public ParserManagerDelegate
+{
+    void ParserManager_packetFound(const std::vector<uint8_t>&, ros::Time, const uint8_t* pack, size_t bytes) override
+    {
+        sim->received(this, pack, bytes);
+    }
+
+    RobotSimulator* sim = NULL;
+    Connection* connection = NULL; // NULL once closed
+    uint32_t id = 0;
+    double start = 0;
+    size_t odomSent = 0;
+    size_t deviceStateSent = 0;
+    size_t robotStateSent = 0;
+};
+
+RobotSimulator::RobotSimulator(const RobotSimulatorConfig& config)
+    : m_config(config), m_loop(this), m_odomParser({Odom::magic_header[0], Odom::magic_header[1]}),
+      m_controlParser({(uint8_t)TcpRobotControl::magic_header[0], (uint8_t)TcpRobotControl::magic_header[1]})
+{
+}
+
+RobotSimulator::~RobotSimulator()
+{
+    if (m_listenfd != -1)
+        close(m_listenfd);
+    if (m_record != NULL)
+        fclose(m_record);
+}
+
+bool RobotSimulator::start()
+{
+    if (!m_loop.isValid())
+        return false;
+
+    m_listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_listenfd == -1)
+        return false;
+    int one = 1;
+    setsockopt(m_listenfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(m_config.port);
+    socklen_t len = sizeof(addr);
+    if (bind(m_listenfd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(m_listenfd, 1024) != 0
+        || getsockname(m_listenfd, (struct sockaddr*)&addr, &len) != 0)
+    {
+        close(m_listenfd);
+        m_listenfd = -1;
+        return false;
+    }
+    m_port = ntohs(addr.sin_port);
+
+    if (m_config.recordPath != NULL)
+    {
+        m_record = fopen(m_config.recordPath, "w");
+        if (m_record == NULL)
+            return false;
+        fprintf(m_record, "connection,type,direction,stamp,local\n");
+    }
+
+    m_lastStats = monotonicSeconds();
+    m_running.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void RobotSimulator::run()
+{
+    while (m_running.load(std::memory_order_relaxed))
+        runOnce(ROBOT_SIMULATOR_TICK_MS);
+}
+
+void RobotSimulator::runOnce(int timeoutMs)
+{
+    accept();
+    m_loop.runOnce(timeoutMs);
+    publish();
+
+    // clients are only freed here, a close can happen inside their own packet callback
+    m_clients.erase(std::remove_if(m_clients.begin(), m_clients.end(),
+                                   [](const std::unique_ptr<Client>& c) { return c->connection == NULL; }),
+                    m_clients.end());
+
+    if (m_config.statsInterval > 0 && monotonicSeconds() - m_lastStats >= m_config.statsInterval)
+        printStats();
+}
+
+void RobotSimulator::accept()
+{
+    while (true)
+    {
+        int fd = accept4(m_listenfd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd == -1)
+            return;
+
+        // frames go out per tick already batched, Nagle would only hold them back
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        std::shared_ptr<TcpStream> stream = std::make_shared<TcpStream>();
+        stream->attach(fd);
+
+        std::unique_ptr<Client> client(new Client());
+        client->sim = this;
+        client->id = m_nextClientId++;
+        client->start = monotonicSeconds();
+        client->connection = m_loop.add(stream, client.get(), 1024 * 1024);
+        if (client->connection == NULL)
+            continue;
+        client->connection->context = client.get();
+        client->connection->parser().addParser(&m_odomParser);
+        client->connection->parser().addParser(&m_controlParser);
+        m_clients.push_back(std::move(client));
+        m_stats.connections++;
+    }
+}
+
+void RobotSimulator::EventLoop_connectionClosed(Connection* connection)
+{
+    Client* client = (Client*)connection->context;
+    if (client != NULL)
+        client->connection = NULL;
+}
+
+void RobotSimulator::publish()
+{
+    double now = monotonicSeconds();
+    Odom odom{};
+    DeviceState deviceState{};
+    TcpRobotState robotState{};
+    robotState.wheels_enabled = true;
+
+    for (auto& client : m_clients)
+    {
+        if (client->connection == NULL)
+            continue;
+
+        // what the rates say is due since the connection was accepted
+        double elapsed = now - client->start;
+        size_t odomDue = (size_t)(elapsed * m_config.odomHz) - client->odomSent;
+        size_t deviceStateDue = (size_t)(elapsed * m_config.deviceStateHz) - client->deviceStateSent;
+        size_t robotStateDue = (size_t)(elapsed * m_config.robotStateHz) - client->robotStateSent;
+        if (odomDue + deviceStateDue + robotStateDue == 0)
+            continue;
+
+        if (client->connection->pendingBytes() > m_config.maxPendingBytes)
+        {
+            // the client does not keep up, drop this tick instead of queueing without bound
+            m_stats.skipped += odomDue + deviceStateDue + robotStateDue;
+            client->odomSent += odomDue;
+            client->deviceStateSent += deviceStateDue;
+            client->robotStateSent += robotStateDue;
+            continue;
+        }
+
+        m_frames.clear();
+        ros::Time stamp = ros::Time::now();
+        for (size_t i = 0; i < odomDue; i++)
+        {
+            odom.stamp = stamp;
+            odom.twist_linear_x = (float)(client->odomSent++ % 1000);
+            to_stream(odom, m_frames);
+            record(client.get(), "Odom", 't', stamp);
+        }
+        for (size_t i = 0; i < deviceStateDue; i++)
+        {
+            deviceState.left_voltage = deviceState.right_voltage = (uint16_t)(4800 + client->deviceStateSent++ % 100);
+            to_stream(deviceState, m_frames);
+            record(client.get(), "DeviceState", 't', stamp);
+        }
+        for (size_t i = 0; i < robotStateDue; i++)
+        {
+            robotState.battery_percent = (uint8_t)(100 - client->robotStateSent++ % 100);
+            to_stream(robotState, m_frames);
+            record(client.get(), "TcpRobotState", 't', stamp);
+        }
+
+        m_stats.sent += odomDue + deviceStateDue + robotStateDue;
+        m_loop.send(client->connection, m_frames.getData(), m_frames.size());
+    }
+}
+
+void RobotSimulator::received(Client* client, const uint8_t* pack, size_t bytes)
+{
+    ros::Time now = ros::Time::now();
+    m_stats.received++;
+
+    if (pack[0] == (uint8_t)TcpRobotControl::magic_header[0] && pack[1] == (uint8_t)TcpRobotControl::magic_header[1])
+    {
+        record(client, "TcpRobotControl", 'r', now);
+        if (client->connection != NULL && m_loop.send(client->connection, pack, bytes))
+        {
+            m_stats.echoed++;
+            record(client, "TcpRobotControl", 't', now);
+        }
+        return;
+    }
+
+    Odom odom;
+    if (from_buffer(odom, (const char*)pack, bytes))
+    {
+        m_stats.odomLatencyUs.push_back(diffUs(odom.stamp, now));
+        record(client, "Odom", 'r', odom.stamp);
+    }
+}
+
+void RobotSimulator::record(const Client* client, const char* type, char direction, ros::Time stamp)
+{
+    if (m_record == NULL)
+        return;
+    ros::Time now = ros::Time::now();
+    fprintf(m_record, "%u,%s,%s,%u.%09u,%u.%09u\n", client->id, type, direction == 't' ? "tx" : "rx", stamp.sec,
+            stamp.nsec, now.sec, now.nsec);
+}
+
+void RobotSimulator::printStats()
+{
+    double now = monotonicSeconds();
+    double seconds = now - m_lastStats;
+    m_lastStats = now;
+
+    std::vector<double>& latency = m_stats.odomLatencyUs;
+    std::sort(latency.begin(), latency.end());
+    printf("clients %zu, sent %.0f/s, received %.0f/s, echoed %.0f/s, skipped %zu", m_clients.size(),
+           (m_stats.sent - m_lastPrinted.sent) / seconds, (m_stats.received - m_lastPrinted.received) / seconds,
+           (m_stats.echoed - m_lastPrinted.echoed) / seconds, m_stats.skipped - m_lastPrinted.skipped);
+    if (!latency.empty())
+        printf(", odom one-way us p50 %.1f p99 %.1f max %.1f", percentile(latency, 0.5), percentile(latency, 0.99),
+               latency.back());
+    printf("\n");
+    fflush(stdout);
+
+    latency.clear();
+    m_lastPrinted.sent = m_stats.sent;
+    m_lastPrinted.received = m_stats.received;
+    m_lastPrinted.echoed = m_stats.echoed;
+    m_lastPrinted.skipped = m_stats.skipped;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "packet/event_loop.h"
+#include "packet/tcp_pack.h"
+#include "ros/grow_stream.h"
+
+struct RobotSimulatorConfig
+{
+    int port = 8091;
+    /// messages per second and connection, 0 turns a stream off
+    double odomHz = 100;
+    double deviceStateHz = 10;
+    double robotStateHz = 1;
+    /// a connection whose queue is larger skips publishing until it drained, counted in Stats::skipped
+    size_t maxPendingBytes = 4 * 1024 * 1024;
+    /// csv file with one line per message sent or received, NULL for none
+    const char* recordPath = NULL;
+    /// seconds between stats lines, 0 for none
+    double statsInterval = 1;
+};
+
+/**
+Robot side of the protocol for testing the client on one machine: accepts any number of connections on loopback,
+publishes Odom, DeviceState and TcpRobotState to each of them at the configured rates, echoes every TcpRobotControl
+frame back unchanged and takes Odom from clients.
+
+Published Odom is stamped right before it is sent, so a client gets the one-way latency as receive time minus
+stamp. Odom a client sends is measured the same way here, see Stats. TcpRobotControl carries no stamp, a client
+gets the round trip time by matching echoes in send order.
+
+Publishing runs on a 1 ms tick, each tick sends what the rates say is due by now in one write, so rates above
+1 kHz work and the average rate is exact.
+
+demo code:
+```
+RobotSimulatorConfig config;
+config.odomHz = 10000;
+RobotSimulator sim(config);
+if (sim.start())
+    sim.run(); // until stop()
+```
+*/
+class RobotSimulator : public EventLoopDelegate
+{
+public:
+    struct Stats
+    {
+        size_t connections = 0;
+        size_t sent = 0;
+        size_t received = 0;
+        size_t echoed = 0;
+        size_t skipped = 0;
+        /// one-way latency of Odom received from clients, microseconds
+        std::vector<double> odomLatencyUs;
+    };
+
+    explicit RobotSimulator(const RobotSimulatorConfig& config);
+    ~RobotSimulator();
+
+    RobotSimulator(const RobotSimulator&) = delete;
+    RobotSimulator& operator=(const RobotSimulator&) = delete;
+
+    /// listens on 127.0.0.1:port (0 picks a free port, see port()), false if that fails
+    bool start();
+    /// accepts, publishes and echoes until stop()
+    void run();
+    /// one tick, waits at most timeoutMs for traffic
+    void runOnce(int timeoutMs);
+    /// safe from another thread or a signal handler
+    void stop() { m_running.store(false, std::memory_order_relaxed); }
+
+    int port() const { return m_port; }
+    /// totals since start, odomLatencyUs since the last stats line
+    const Stats& stats() const { return m_stats; }
+
+    void EventLoop_connectionClosed(Connection* connection) override;
+
+private:
+    struct Client;
+
+    void accept();
+    void publish();
+    void received(Client* client, const uint8_t* pack, size_t bytes);
+    void record(const Client* client, const char* type, char direction, ros::Time stamp);
+    void printStats();
+
+private:
+    RobotSimulatorConfig m_config;
+    EventLoop m_loop;
+    int m_listenfd = -1;
+    int m_port = 0;
+    std::atomic<bool> m_running{false};
+
+    MsgPackParser m_odomParser;
+    MsgPackParser m_controlParser;
+    std::vector<std::unique_ptr<Client>> m_clients;
+    uint32_t m_nextClientId = 0;
+    ros::serialization::GrowBuffer m_frames;
+
+    FILE* m_record = NULL;
+    Stats m_stats;
+    double m_lastStats = 0;
+    Stats m_lastPrinted;
+};
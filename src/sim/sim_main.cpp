@@ -0,0 +1,73 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sim/robot_simulator.h"
+
+namespace
+{
+RobotSimulator* g_simulator = NULL;
+
+void onSignal(int)
+{
+    if (g_simulator != NULL)
+        g_simulator->stop();
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+            "usage: %s [--port=<n>] [--odom-hz=<rate>] [--device-state-hz=<rate>] [--robot-state-hz=<rate>]\n"
+            "          [--max-pending=<bytes>] [--record=<csv file>] [--stats=<seconds>]\n"
+            "defaults: port 8091, odom 100 Hz, device state 10 Hz, robot state 1 Hz, stats every second\n",
+            name);
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    RobotSimulatorConfig config;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--port=", 7) == 0)
+            config.port = atoi(arg + 7);
+        else if (strncmp(arg, "--odom-hz=", 10) == 0)
+            config.odomHz = atof(arg + 10);
+        else if (strncmp(arg, "--device-state-hz=", 18) == 0)
+            config.deviceStateHz = atof(arg + 18);
+        else if (strncmp(arg, "--robot-state-hz=", 17) == 0)
+            config.robotStateHz = atof(arg + 17);
+        else if (strncmp(arg, "--max-pending=", 14) == 0)
+            config.maxPendingBytes = strtoull(arg + 14, NULL, 10);
+        else if (strncmp(arg, "--record=", 9) == 0)
+            config.recordPath = arg + 9;
+        else if (strncmp(arg, "--stats=", 8) == 0)
+            config.statsInterval = atof(arg + 8);
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    RobotSimulator simulator(config);
+    if (!simulator.start())
+    {
+        fprintf(stderr, "can not listen on 127.0.0.1:%d\n", config.port);
+        return 1;
+    }
+    printf("listening on 127.0.0.1:%d\n", simulator.port());
+    fflush(stdout);
+
+    g_simulator = &simulator;
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    simulator.run();
+    g_simulator = NULL;
+
+    const RobotSimulator::Stats& stats = simulator.stats();
+    printf("connections %zu, sent %zu, received %zu, echoed %zu, skipped %zu\n", stats.connections, stats.sent,
+           stats.received, stats.echoed, stats.skipped);
+    return 0;
+}